@@ -0,0 +1,302 @@
+/*
+ *   File name: BulkStat.cpp
+ *   Summary:   Filesystem-specific bulk inode status lookups for QDirStat
+ *   License:   GPL V2 - See file LICENSE for details.
+ *
+ *   Authors:   Stefan Hundhammer <Stefan.Hundhammer@gmx.de>
+ *              Ian Nartowicz
+ */
+
+#include <cstdint>     // UINT32_MAX, UINT64_MAX
+#include <cstring>     // memcpy()
+#include <endian.h>    // le32toh(), le64toh()
+#include <sys/ioctl.h> // ioctl()
+#include <sys/vfs.h>   // fstatfs()
+#include <unistd.h>    // geteuid()
+
+#include <linux/magic.h> // BTRFS_SUPER_MAGIC, XFS_SUPER_MAGIC
+
+#if defined( __has_include )
+#  if __has_include( <xfs/xfs.h> )
+#    include <xfs/xfs.h> // XFS_IOC_FSBULKSTAT
+#    define HAVE_XFS_BULKSTAT  1
+#  endif
+#  if __has_include( <linux/btrfs.h> ) && __has_include( <linux/btrfs_tree.h> )
+#    include <linux/btrfs.h>      // BTRFS_IOC_TREE_SEARCH_V2
+#    include <linux/btrfs_tree.h> // struct btrfs_inode_item
+#    define HAVE_BTRFS_SEARCH  1
+#  endif
+#endif
+
+#include "BulkStat.h"
+#include "Logger.h"
+
+
+// Most inodes looked at for each inode wanted, on top of MIN_INODES_VISITED,
+// before giving up on a directory whose inodes are widely scattered
+#define INODES_VISITED_PER_INODE     8
+#define MIN_INODES_VISITED        1024
+
+// Number of inodes read from XFS with each ioctl()
+#define XFS_BATCH_SIZE             256
+
+// Size of the buffer for the items read from btrfs with each ioctl()
+#define BTRFS_SEARCH_BUF_BYTES  ( 64 * 1024 )
+
+
+using namespace QDirStat;
+
+
+namespace
+{
+#if HAVE_XFS_BULKSTAT
+
+    /**
+     * Bulk lookups with the XFS_IOC_FSBULKSTAT ioctl, which returns the
+     * status of the inodes in use after a given inode number, in batches.
+     **/
+    class XfsBulkStat final : public BulkStat
+    {
+    protected:
+
+	bool readInodes( int                  dirFd,
+	                 long,
+	                 ino_t                first,
+	                 ino_t                last,
+	                 const InodeVisitor & visit ) const override
+	{
+	    QVector<struct xfs_bstat> batch( XFS_BATCH_SIZE );
+	    __u64 lastInode = first - 1; // the batch starts after this one
+	    __s32 count = 0;
+
+	    struct xfs_fsop_bulkreq request;
+	    request.lastip  = &lastInode;
+	    request.icount  = batch.size();
+	    request.ubuffer = batch.data();
+	    request.ocount  = &count;
+
+	    while ( true )
+	    {
+		if ( ioctl( dirFd, XFS_IOC_FSBULKSTAT, &request ) < 0 )
+		    return false;
+
+		if ( count == 0 )
+		    return true;
+
+		for ( int i = 0; i < count; ++i )
+		{
+		    const struct xfs_bstat & inode = batch.at( i );
+		    if ( inode.bs_ino > last )
+			return true;
+
+		    // XFS counts blocks of the filesystem block size
+		    struct stat statInfo{};
+		    statInfo.st_ino    = inode.bs_ino;
+		    statInfo.st_mode   = inode.bs_mode;
+		    statInfo.st_nlink  = inode.bs_nlink;
+		    statInfo.st_uid    = inode.bs_uid;
+		    statInfo.st_gid    = inode.bs_gid;
+		    statInfo.st_rdev   = inode.bs_rdev;
+		    statInfo.st_size   = inode.bs_size;
+		    statInfo.st_blocks = inode.bs_blocks * ( inode.bs_blksize / 512 );
+		    statInfo.st_mtime  = inode.bs_mtime.tv_sec;
+
+		    if ( !visit( statInfo ) )
+			return true;
+		}
+	    }
+	}
+
+	const char * name() const override { return "XFS"; }
+
+    };	// class XfsBulkStat
+
+#endif
+
+
+#if HAVE_BTRFS_SEARCH
+
+    /**
+     * Bulk lookups with the BTRFS_IOC_TREE_SEARCH_V2 ioctl, which returns
+     * the items of the subvolume tree between two keys.  Only the inode
+     * items are used.  All the items for an inode come after its inode
+     * item, so each search can skip straight to the next inode.
+     **/
+    class BtrfsBulkStat final : public BulkStat
+    {
+    protected:
+
+	bool readInodes( int                  dirFd,
+	                 long                 blockSize,
+	                 ino_t                first,
+	                 ino_t                last,
+	                 const InodeVisitor & visit ) const override
+	{
+	    QVector<quint64> buffer( ( sizeof( btrfs_ioctl_search_args_v2 ) + BTRFS_SEARCH_BUF_BYTES ) / sizeof( quint64 ) );
+	    btrfs_ioctl_search_args_v2 * args = reinterpret_cast<btrfs_ioctl_search_args_v2 *>( buffer.data() );
+	    btrfs_ioctl_search_key & key = args->key;
+
+	    key.tree_id      = 0; // the subvolume of 'dirFd'
+	    key.min_objectid = first;
+	    key.max_objectid = last;
+	    key.min_type     = BTRFS_INODE_ITEM_KEY;
+	    key.max_type     = BTRFS_INODE_ITEM_KEY;
+	    key.min_offset   = 0;
+	    key.max_offset   = UINT64_MAX;
+	    key.min_transid  = 0;
+	    key.max_transid  = UINT64_MAX;
+
+	    while ( key.min_objectid <= last )
+	    {
+		key.nr_items  = UINT32_MAX;
+		args->buf_size = BTRFS_SEARCH_BUF_BYTES;
+
+		if ( ioctl( dirFd, BTRFS_IOC_TREE_SEARCH_V2, args ) < 0 )
+		    return false;
+
+		if ( key.nr_items == 0 )
+		    return true;
+
+		// The items are packed one after the other, each after its header
+		const char * items = reinterpret_cast<const char *>( args->buf );
+		size_t offset = 0;
+		__u64 lastObjectId = 0;
+		for ( __u32 i = 0; i < key.nr_items; ++i )
+		{
+		    btrfs_ioctl_search_header header;
+		    memcpy( &header, items + offset, sizeof( header ) );
+		    offset += sizeof( header );
+		    lastObjectId = header.objectid;
+
+		    if ( header.type == BTRFS_INODE_ITEM_KEY && header.len >= sizeof( btrfs_inode_item ) )
+		    {
+			btrfs_inode_item inode;
+			memcpy( &inode, items + offset, sizeof( inode ) );
+
+			// Like stat(), count the allocated bytes in whole filesystem blocks
+			const quint64 bytes = le64toh( inode.nbytes );
+			const quint64 allocated = blockSize > 0 ? ( bytes + blockSize - 1 ) / blockSize * blockSize : bytes;
+
+			struct stat statInfo{};
+			statInfo.st_ino    = header.objectid;
+			statInfo.st_mode   = le32toh( inode.mode );
+			statInfo.st_nlink  = le32toh( inode.nlink );
+			statInfo.st_uid    = le32toh( inode.uid );
+			statInfo.st_gid    = le32toh( inode.gid );
+			statInfo.st_rdev   = le64toh( inode.rdev );
+			statInfo.st_size   = le64toh( inode.size );
+			statInfo.st_blocks = allocated / 512;
+			statInfo.st_mtime  = le64toh( inode.mtime.sec );
+
+			if ( !visit( statInfo ) )
+			    return true;
+		    }
+
+		    offset += header.len;
+		}
+
+		// Carry on from the inode item of the next inode
+		key.min_objectid = lastObjectId + 1;
+		key.min_type     = BTRFS_INODE_ITEM_KEY;
+		key.min_offset   = 0;
+	    }
+
+	    return true;
+	}
+
+	const char * name() const override { return "btrfs"; }
+
+    };	// class BtrfsBulkStat
+
+#endif
+
+} // namespace
+
+
+const BulkStat * BulkStat::forDirectory( int dirFd )
+{
+    // The bulk interfaces are only available to root
+    if ( geteuid() != 0 )
+	return nullptr;
+
+    struct statfs fsInfo;
+    if ( fstatfs( dirFd, &fsInfo ) != 0 )
+	return nullptr;
+
+    const BulkStat * bulkStat = [ &fsInfo ]() -> const BulkStat *
+    {
+	switch ( fsInfo.f_type )
+	{
+#if HAVE_XFS_BULKSTAT
+	    case XFS_SUPER_MAGIC:
+	    {
+		static const XfsBulkStat xfsBulkStat;
+		return &xfsBulkStat;
+	    }
+#endif
+
+#if HAVE_BTRFS_SEARCH
+	    case BTRFS_SUPER_MAGIC:
+	    {
+		static const BtrfsBulkStat btrfsBulkStat;
+		return &btrfsBulkStat;
+	    }
+#endif
+
+	    default:
+		return nullptr;
+	}
+    }();
+
+    return bulkStat && !bulkStat->isDisabled() ? bulkStat : nullptr;
+}
+
+
+QHash<ino_t, struct stat> BulkStat::statInodes( int dirFd, const QVector<ino_t> & inodes ) const
+{
+    QHash<ino_t, struct stat> results;
+    if ( inodes.isEmpty() )
+	return results;
+
+    // All the inodes are on the same device as the directory
+    struct stat dirStat;
+    struct statfs fsInfo;
+    if ( fstat( dirFd, &dirStat ) != 0 || fstatfs( dirFd, &fsInfo ) != 0 )
+	return results;
+
+    results.reserve( inodes.size() );
+
+    int next = 0;
+    int visited = 0;
+    const int maxVisited = inodes.size() * INODES_VISITED_PER_INODE + MIN_INODES_VISITED;
+    const auto visit = [ &inodes, &results, &dirStat, &next, &visited, maxVisited ]( struct stat & statInfo ) -> bool
+    {
+	// Skip any wanted inodes that aren't in use any more
+	while ( next < inodes.size() && inodes.at( next ) < statInfo.st_ino )
+	    ++next;
+
+	if ( next == inodes.size() )
+	    return false;
+
+	if ( inodes.at( next ) == statInfo.st_ino )
+	{
+	    statInfo.st_dev     = dirStat.st_dev;
+	    statInfo.st_blksize = dirStat.st_blksize;
+	    results.insert( statInfo.st_ino, statInfo );
+	}
+
+	return ++visited < maxVisited;
+    };
+
+    if ( !readInodes( dirFd, fsInfo.f_bsize, inodes.first(), inodes.last(), visit ) )
+    {
+	// Don't keep trying if the filesystem doesn't allow it, the results so far are still good
+	if ( errno == EPERM || errno == EACCES || errno == ENOTTY || errno == EINVAL || errno == EOPNOTSUPP )
+	{
+	    if ( !_disabled.exchange( true ) )
+		logWarning() << "Bulk inode lookups not available on " << name() << ": " << formatErrno() << Qt::endl;
+	}
+    }
+
+    return results;
+}
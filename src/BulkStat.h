@@ -0,0 +1,110 @@
+/*
+ *   File name: BulkStat.h
+ *   Summary:   Filesystem-specific bulk inode status lookups for QDirStat
+ *   License:   GPL V2 - See file LICENSE for details.
+ *
+ *   Authors:   Stefan Hundhammer <Stefan.Hundhammer@gmx.de>
+ *              Ian Nartowicz
+ */
+
+#ifndef BulkStat_h
+#define BulkStat_h
+
+#include <atomic>
+#include <functional>
+
+#include <sys/stat.h> // struct stat
+
+#include <QHash>
+#include <QVector>
+
+
+namespace QDirStat
+{
+    /**
+     * Abstract base class for looking up the status of many inodes of a
+     * filesystem at once, rather than calling fstatat() for each
+     * directory entry.  Derived classes use the bulk interfaces of a
+     * particular filesystem, which read the inodes in i-number order in
+     * large batches.
+     *
+     * The lookups are used by LocalDirReadJob for the entries of a
+     * directory that are known not to be directories themselves: files,
+     * symlinks, and special files.  Anything that isn't found is looked
+     * up with fstatat() as usual.  Directories are always looked up with
+     * fstatat(), because they may be mount points or subvolumes whose
+     * inode numbers belong to another filesystem.
+     *
+     * The bulk interfaces need root permissions.  A backend disables
+     * itself for the rest of the session if the filesystem refuses them.
+     *
+     * The lookups are called from worker threads at the same time, so
+     * backends have no state except for being disabled.
+     **/
+    class BulkStat
+    {
+    public:
+
+	virtual ~BulkStat() = default;
+
+	/**
+	 * Return the backend for the filesystem of the open directory
+	 * 'dirFd', or 0 if there is none or it can't be used.
+	 **/
+	static const BulkStat * forDirectory( int dirFd );
+
+	/**
+	 * Look up the status of 'inodes', which must be sorted in
+	 * ascending order, on the filesystem of the open directory
+	 * 'dirFd'.  Returns the inodes that were found, which may be
+	 * none of them.
+	 **/
+	QHash<ino_t, struct stat> statInodes( int dirFd, const QVector<ino_t> & inodes ) const;
+
+	/**
+	 * Return 'true' if the filesystem refused the bulk interface and
+	 * this backend isn't used any more.
+	 **/
+	bool isDisabled() const { return _disabled; }
+
+
+    protected:
+
+	/**
+	 * Function to receive the status of one inode.  It returns 'false'
+	 * if no more inodes are needed.
+	 **/
+	typedef std::function<bool( struct stat & statInfo )> InodeVisitor;
+
+	/**
+	 * Call 'visit' with the status of the inodes in use from 'first' to
+	 * 'last' in ascending order, until it returns 'false'.  The status
+	 * doesn't need the device number or the preferred I/O size.
+	 * 'blockSize' is the block size of the filesystem.  Returns 'false'
+	 * with errno set if there was an error.
+	 *
+	 * Derived classes are required to implement this.
+	 **/
+	virtual bool readInodes( int                  dirFd,
+	                         long                 blockSize,
+	                         ino_t                first,
+	                         ino_t                last,
+	                         const InodeVisitor & visit ) const = 0;
+
+	/**
+	 * Return the name of the filesystem for log messages.
+	 *
+	 * Derived classes are required to implement this.
+	 **/
+	virtual const char * name() const = 0;
+
+
+    private:
+
+	mutable std::atomic<bool> _disabled{ false };
+
+    };	// class BulkStat
+
+}	// namespace QDirStat
+
+#endif	// ifndef BulkStat_h
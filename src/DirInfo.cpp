@@ -7,13 +7,18 @@
  *              Ian Nartowicz
  */
 
+#include <algorithm> // upper_bound()
+#include <memory>    // unique_ptr
+
 #include "DirInfo.h"
 #include "Attic.h"
 #include "DirTree.h"
 #include "Exception.h"
+#include "FileAgeStats.h"
 #include "FileInfoIterator.h"
 #include "FileInfoSorter.h"
 #include "FormatUtil.h"
+#include "MimeCategorizer.h"
 
 
 // How many times the standard deviation from the average is considered dominant
@@ -24,6 +29,23 @@
 #define VERBOSE_DOMINANCE_CHECK                  0
 #define DIRECT_CHILDREN_COUNT_SANITY_CHECK       0
 
+// Number of files in each list of a DirTopFiles summary
+#define TOP_FILES_COUNT                         16
+
+// Only subtrees with at least this many items carry a DirTopFiles summary
+#define TOP_FILES_MIN_ITEMS                   1000
+
+// Only subtrees with at least this many items carry a DirSizeSketch,
+// few enough for the full precision sketches to be a small part of the tree
+#define SIZE_SKETCH_MIN_ITEMS               100000
+
+// Size sketch buckets are 2^-bits of their values wide, ie. at most 0.8%,
+// the same as the size statistics collected without the cached sketches
+#define SIZE_SKETCH_PRECISION_BITS               7
+
+// Only subtrees with at least this many items carry FileAgeStats
+#define AGE_STATS_MIN_ITEMS                  10000
+
 
 using namespace QDirStat;
 
@@ -39,9 +61,203 @@ namespace
 	    logDebug() << "    #" << i << ": " << children.at(i) << Qt::endl;
     }
 
+
+    /**
+     * Insert 'file' into 'list', which is sorted with the highest ranked
+     * files first according to 'higherRank', if it ranks high enough to
+     * be kept.
+     **/
+    template<typename Compare>
+    void addRanked( FileInfoList & list, FileInfo * file, Compare higherRank )
+    {
+	if ( list.size() == TOP_FILES_COUNT && !higherRank( file, list.last() ) )
+	    return;
+
+	list.insert( std::upper_bound( list.begin(), list.end(), file, higherRank ), file );
+
+	if ( list.size() > TOP_FILES_COUNT )
+	    list.removeLast();
+    }
+
+
+    bool largerFile( const FileInfo * file1, const FileInfo * file2 )
+	{ return file1->size() > file2->size(); }
+
+    bool newerFile( const FileInfo * file1, const FileInfo * file2 )
+	{ return file1->mtime() > file2->mtime(); }
+
+    bool olderFile( const FileInfo * file1, const FileInfo * file2 )
+	{ return file1->mtime() < file2->mtime(); }
+
+
+    /**
+     * Recursively add the files in 'dir' to 'topFiles', merging the
+     * summaries of any subdirectories that have one.
+     **/
+    void addTopFiles( DirTopFiles * topFiles, FileInfo * dir )
+    {
+	for ( DotEntryIterator it{ dir }; *it; ++it )
+	{
+	    if ( it->isDirInfo() )
+	    {
+		const DirTopFiles * subTopFiles = static_cast<DirInfo *>( *it )->topFiles();
+		if ( subTopFiles )
+		    topFiles->merge( subTopFiles );
+		else
+		    addTopFiles( topFiles, *it );
+	    }
+	    else
+	    {
+		topFiles->add( *it );
+	    }
+	}
+    }
+
+
+    /**
+     * Recursively add the files and symlinks in 'dir' to 'sizeSketch',
+     * merging the sketches of any subdirectories that have one.
+     **/
+    void addSizes( DirSizeSketch * sizeSketch, FileInfo * dir )
+    {
+	for ( DotEntryIterator it{ dir }; *it; ++it )
+	{
+	    if ( it->isDirInfo() )
+	    {
+		const DirSizeSketch * subSizeSketch = static_cast<DirInfo *>( *it )->sizeSketch();
+		if ( subSizeSketch )
+		    sizeSketch->merge( subSizeSketch );
+		else
+		    addSizes( sizeSketch, *it );
+	    }
+	    else
+	    {
+		sizeSketch->add( *it );
+	    }
+	}
+    }
+
+
+    /**
+     * The item threshold, builder, and merge for each kind of summary
+     * kept on large subtrees.
+     **/
+    template<typename Summary> struct SummaryTraits;
+
+    template<> struct SummaryTraits<DirTopFiles>
+    {
+	static FileCount minItems() { return TOP_FILES_MIN_ITEMS; }
+
+	static DirTopFiles * build( DirInfo * dir )
+	{
+	    DirTopFiles * topFiles = new DirTopFiles;
+	    addTopFiles( topFiles, dir );
+	    return topFiles;
+	}
+
+	static void merge( DirTopFiles * topFiles, const DirTopFiles * other ) { topFiles->merge( other ); }
+    };
+
+    template<> struct SummaryTraits<DirSizeSketch>
+    {
+	static FileCount minItems() { return SIZE_SKETCH_MIN_ITEMS; }
+
+	static DirSizeSketch * build( DirInfo * dir )
+	{
+	    DirSizeSketch * sizeSketch = new DirSizeSketch;
+	    addSizes( sizeSketch, dir );
+	    return sizeSketch;
+	}
+
+	static void merge( DirSizeSketch * sizeSketch, const DirSizeSketch * other ) { sizeSketch->merge( other ); }
+    };
+
+    template<> struct SummaryTraits<FileAgeStats>
+    {
+	static FileCount minItems() { return AGE_STATS_MIN_ITEMS; }
+
+	// Collecting merges the statistics of any large subdirectories
+	static FileAgeStats * build( DirInfo * dir ) { return new FileAgeStats{ dir }; }
+
+	static void merge( FileAgeStats * ageStats, const FileAgeStats * other ) { ageStats->merge( *other ); }
+    };
+
+
+    /**
+     * The summary of just the new items of a batch in 'dir', for merging
+     * into the summaries of its ancestors.  This is the directory's own
+     * summary if it has one, or else it is built the first time it is
+     * needed.
+     **/
+    template<typename Summary>
+    class BatchSummary
+    {
+    public:
+
+	BatchSummary( DirInfo * dir, const Summary * dirSummary ):
+	    _dir{ dir },
+	    _dirSummary{ dirSummary }
+	{}
+
+	const Summary * get()
+	{
+	    if ( _dirSummary )
+		return _dirSummary;
+
+	    if ( !_newSummary )
+		_newSummary.reset( SummaryTraits<Summary>::build( _dir ) );
+
+	    return _newSummary.get();
+	}
+
+    private:
+
+	DirInfo                  * _dir;
+	const Summary            * _dirSummary;
+	std::unique_ptr<Summary>   _newSummary;
+    };
+
 } // namespace
 
 
+template<typename Summary>
+void DirInfo::addToSummary( Summary * & summary, FileInfo * item )
+{
+    if ( summary )
+	summary->add( item );
+    else if ( _totalItems >= SummaryTraits<Summary>::minItems() )
+	summary = SummaryTraits<Summary>::build( this );
+}
+
+
+template<typename Summary, typename Batch>
+void DirInfo::mergeIntoSummary( Summary * & summary, Batch & batch )
+{
+    if ( summary )
+	SummaryTraits<Summary>::merge( summary, batch.get() );
+    else if ( _totalItems >= SummaryTraits<Summary>::minItems() )
+	summary = SummaryTraits<Summary>::build( this );
+}
+
+
+template<typename Summary>
+void DirInfo::rebuildSummary( Summary * & summary )
+{
+    dropSummary( summary );
+
+    if ( _totalItems >= SummaryTraits<Summary>::minItems() )
+	summary = SummaryTraits<Summary>::build( this );
+}
+
+
+template<typename Summary>
+void DirInfo::dropSummary( Summary * & summary )
+{
+    delete summary;
+    summary = nullptr;
+}
+
+
 DirInfo::DirInfo( DirInfo       * parent,
                   DirTree       * tree,
                   const QString & name ):
@@ -52,6 +268,7 @@ DirInfo::DirInfo( DirInfo       * parent,
     _locked{ false },
     _touched{ false },
     _fromCache{ false },
+    _batching{ false },
     _readState{ DirFinished }
 {
     initCounts();
@@ -69,6 +286,7 @@ DirInfo::DirInfo( DirInfo           * parent,
     _locked{ false },
     _touched{ false },
     _fromCache{ false },
+    _batching{ false },
     _readState{ DirQueued }
 {
     initCounts();
@@ -103,6 +321,7 @@ DirInfo::DirInfo( DirInfo       * parent,
     _locked{ false },
     _touched{ false },
     _fromCache{ fromCache },
+    _batching{ false },
     _readState{ DirQueued }
 {
     initCounts();
@@ -113,6 +332,9 @@ DirInfo::DirInfo( DirInfo       * parent,
 DirInfo::~DirInfo()
 {
     clear();
+    dropSummary( _topFiles );
+    dropSummary( _sizeSketch );
+    dropSummary( _ageStats );
 }
 
 
@@ -320,6 +542,11 @@ void DirInfo::recalc()
     if ( parent() && parent() == tree()->root() )
 	logDebug() << _attic << " " << _totalIgnoredItems << " " << _totalUnignoredItems << " " << _totalItems << " " << _totalSubDirs << Qt::endl;
 #endif
+
+    // Any existing summary may refer to deleted items
+    rebuildSummary( _topFiles );
+    rebuildSummary( _sizeSketch );
+    rebuildSummary( _ageStats );
 }
 
 
@@ -536,6 +763,11 @@ void DirInfo::childAdded( FileInfo * newChild )
 			_oldestFileMTime = childOldestFileMTime;
 		}
 	    }
+
+	    // Keep the summaries up to date, or start them once this subtree is big enough
+	    addToSummary( _topFiles,   newChild );
+	    addToSummary( _sizeSketch, newChild );
+	    addToSummary( _ageStats,   newChild );
 	}
     }
 
@@ -543,8 +775,8 @@ void DirInfo::childAdded( FileInfo * newChild )
 //    if ( _sortInfo && _sortInfo->_sortedCol != ReadJobsCol )
 	dropSortCache();
 
-    // Propagate the new child totals up the tree
-    if ( parent() )
+    // Propagate the new child totals up the tree, or leave them for endBatch()
+    if ( parent() && !_batching )
 	parent()->childAdded( newChild );
 #if 0
     if ( parent() && parent() == tree()->root() )
@@ -648,6 +880,90 @@ void DirInfo::readJobAborted()
 }
 
 
+void DirInfo::beginBatch()
+{
+    // The batch totals are the totals of a directory that had no children
+    if ( _summaryDirty || _firstChild || _attic || _totalItems > 0 || _totalIgnoredItems > 0 )
+	return;
+
+    if ( _dotEntry && ( _dotEntry->firstChild() || _dotEntry->attic() ) )
+	return;
+
+    // Ignored items are counted differently in ignored directories and attics
+    for ( const FileInfo * item = this; item; item = item->parent() )
+    {
+	if ( item->isIgnored() || item->isAttic() )
+	    return;
+    }
+
+    _batching = true;
+}
+
+
+void DirInfo::endBatch()
+{
+    if ( !_batching )
+	return;
+
+    _batching = false;
+
+    // If the directory has been cleared, its ancestors will be recalculated anyway
+    if ( _summaryDirty )
+	return;
+
+    // Everything beyond the directory's own size came from the new children
+    const FileSize batchSize          = _totalSize - size();
+    const FileSize batchAllocatedSize = _totalAllocatedSize - allocatedSize();
+
+    // Summaries of just the new files, only made when an ancestor has a summary to merge them into
+    BatchSummary<DirTopFiles>   batchTopFiles  { this, _topFiles   };
+    BatchSummary<DirSizeSketch> batchSizeSketch{ this, _sizeSketch };
+    BatchSummary<FileAgeStats>  batchAgeStats  { this, _ageStats   };
+
+    for ( DirInfo * ancestor = parent(); ancestor; ancestor = ancestor->parent() )
+    {
+	ancestor->dropSortCache();
+
+	// Dirty ancestors will be recalculated from scratch
+	if ( ancestor->_summaryDirty )
+	    continue;
+
+	// The same overflow checks as childAdded(), for the whole batch
+	if ( ancestor->parent() && ancestor->parent() == tree()->root() )
+	{
+	    if ( ancestor->_totalItems > FileCountMax - _totalItems )
+		THROW( TooManyFilesException{} );
+
+	    if ( ancestor->_totalSize > FileSizeMax - batchSize ||
+	         ancestor->_totalAllocatedSize > FileSizeMax - batchAllocatedSize )
+		THROW( FilesystemTooBigException{} );
+	}
+
+	ancestor->_totalSize           += batchSize;
+	ancestor->_totalAllocatedSize  += batchAllocatedSize;
+	ancestor->_totalItems          += _totalItems;
+	ancestor->_totalSubDirs        += _totalSubDirs;
+	ancestor->_totalFiles          += _totalFiles;
+	ancestor->_totalIgnoredItems   += _totalIgnoredItems;
+	ancestor->_totalUnignoredItems += _totalUnignoredItems;
+
+	if ( _latestMTime > ancestor->_latestMTime )
+	    ancestor->_latestMTime = _latestMTime;
+
+	if ( _oldestFileMTime > 0 )
+	{
+	    if ( ancestor->_oldestFileMTime == 0 || _oldestFileMTime < ancestor->_oldestFileMTime )
+		ancestor->_oldestFileMTime = _oldestFileMTime;
+	}
+
+	// Keep the ancestor's summaries up to date, or start them once its subtree is big enough
+	ancestor->mergeIntoSummary( ancestor->_topFiles,   batchTopFiles   );
+	ancestor->mergeIntoSummary( ancestor->_sizeSketch, batchSizeSketch );
+	ancestor->mergeIntoSummary( ancestor->_ageStats,   batchAgeStats   );
+    }
+}
+
+
 QLatin1String DirInfo::sizePrefix() const
 {
     switch ( _readState )
@@ -680,6 +996,27 @@ void DirInfo::finalizeLocal()
     cleanupDotEntries();
     cleanupAttics();
     checkIgnored();
+    categorizeFiles();
+}
+
+
+void DirInfo::categorizeFiles( bool recategorize )
+{
+    MimeCategorizer * categorizer = MimeCategorizer::instance();
+
+    // Plain files are either direct children (after dot entry cleanup) or in the dot entry
+    const auto categorize = [ categorizer, recategorize ]( FileInfo * parent )
+    {
+	for ( FileInfoIterator it{ parent }; *it; ++it )
+	{
+	    if ( !it->isDirInfo() && ( recategorize || it->categoryIndex() == UncategorisedIndex ) )
+		it->setCategoryIndex( categorizer->categoryIndex( *it ) );
+	}
+    };
+
+    categorize( this );
+    if ( _dotEntry )
+	categorize( _dotEntry );
 }
 
 
@@ -854,6 +1191,7 @@ void DirInfo::takeAllChildren( DirInfo * oldParent )
 
 void DirInfo::finishReading( DirReadState readState )
 {
+    endBatch();
     setReadState( readState );
     finalizeLocal();
     tree()->sendReadJobFinished( this );
@@ -862,6 +1200,63 @@ void DirInfo::finishReading( DirReadState readState )
 
 
 
+void DirTopFiles::add( FileInfo * file )
+{
+    if ( !file->isFileOrSymlink() )
+	return;
+
+    addRanked( _largest, file, largerFile );
+    addRanked( _newest,  file, newerFile  );
+    addRanked( _oldest,  file, olderFile  );
+}
+
+
+void DirTopFiles::merge( const DirTopFiles * other )
+{
+    for ( FileInfo * file : other->_largest )
+	addRanked( _largest, file, largerFile );
+
+    for ( FileInfo * file : other->_newest )
+	addRanked( _newest, file, newerFile );
+
+    for ( FileInfo * file : other->_oldest )
+	addRanked( _oldest, file, olderFile );
+}
+
+
+
+
+DirSizeSketch::DirSizeSketch():
+    _files{ precisionBits() },
+    _symlinks{ precisionBits() }
+{
+}
+
+
+int DirSizeSketch::precisionBits()
+{
+    return SIZE_SKETCH_PRECISION_BITS;
+}
+
+
+void DirSizeSketch::add( const FileInfo * item )
+{
+    if ( item->isFile() )
+	_files.add( item->size() );
+    else if ( item->isSymlink() )
+	_symlinks.add( item->size() );
+}
+
+
+void DirSizeSketch::merge( const DirSizeSketch * other )
+{
+    _files.merge( other->_files );
+    _symlinks.merge( other->_symlinks );
+}
+
+
+
+
 DirSortInfo::DirSortInfo( DirInfo       * parent,
                           DataColumn      sortCol,
                           Qt::SortOrder   sortOrder ):
@@ -12,15 +12,19 @@
 
 #include "FileInfo.h"
 #include "DataColumns.h"
+#include "QuantileSketch.h"
 
 
 namespace QDirStat
 {
     using FileInfoList = QVector<FileInfo *>;
 
+    class DirSizeSketch;
     class DirSortInfo;
+    class DirTopFiles;
     class DirTree;
     class DotEntry;
+    class FileAgeStats;
 
     /**
      * Small class to contain information about sorted children of a
@@ -69,6 +73,115 @@ namespace QDirStat
     };	// class DirSortInfo
 
 
+    /**
+     * Small class to hold the largest, newest, and oldest files and
+     * symlinks in the subtree of a DirInfo object.  Each list is sorted
+     * with the highest ranked file first and is limited to a few entries.
+     *
+     * Only directories with large subtrees carry one of these; see
+     * DirInfo::topFiles().  They are kept up to date as children are
+     * added and rebuilt when the directory totals are recalculated, so
+     * code searching for files in a large tree can skip whole subtrees
+     * which have nothing to contribute.
+     **/
+    class DirTopFiles final
+    {
+    public:
+
+	/**
+	 * Add 'file' to any of the lists where it ranks high enough.
+	 * Items other than files and symlinks are ignored.
+	 **/
+	void add( FileInfo * file );
+
+	/**
+	 * Add the files from 'other', normally the summary of a
+	 * subdirectory.
+	 **/
+	void merge( const DirTopFiles * other );
+
+	/**
+	 * Return the largest files, the largest first.
+	 **/
+	const FileInfoList & largest() const { return _largest; }
+
+	/**
+	 * Return the newest files, the newest first.
+	 **/
+	const FileInfoList & newest() const { return _newest; }
+
+	/**
+	 * Return the oldest files, the oldest first.
+	 **/
+	const FileInfoList & oldest() const { return _oldest; }
+
+
+    private:
+
+	FileInfoList _largest;
+	FileInfoList _newest;
+	FileInfoList _oldest;
+
+    };	// class DirTopFiles
+
+
+    /**
+     * Small class to hold the distribution of the sizes of the files
+     * and of the symlinks in the subtree of a DirInfo object, as a pair
+     * of QuantileSketch histograms with the full precision of the size
+     * statistics (see FileSizeStats), so they can be merged into them.
+     *
+     * Like DirTopFiles, only directories with large subtrees carry one of
+     * these; see DirInfo::sizeSketch().  The sketches of subdirectories
+     * can be merged, so the size statistics for any large subtree can be
+     * put together from a few sketches instead of from every file.
+     **/
+    class DirSizeSketch final
+    {
+    public:
+
+	/**
+	 * Constructor: empty sketches with precisionBits() bits of
+	 * precision.
+	 **/
+	DirSizeSketch();
+
+	/**
+	 * Return the precision of the sketches in bits.
+	 **/
+	static int precisionBits();
+
+	/**
+	 * Add the size of 'item' if it is a file or a symlink.  Other
+	 * items are ignored.
+	 **/
+	void add( const FileInfo * item );
+
+	/**
+	 * Add the sizes from 'other', normally the sketch of a
+	 * subdirectory.
+	 **/
+	void merge( const DirSizeSketch * other );
+
+	/**
+	 * Return the sketch of the sizes of the regular files.
+	 **/
+	const QuantileSketch & files() const { return _files; }
+
+	/**
+	 * Return the sketch of the sizes of the symlinks.
+	 **/
+	const QuantileSketch & symlinks() const { return _symlinks; }
+
+
+    private:
+
+	QuantileSketch _files;
+	QuantileSketch _symlinks;
+
+    };	// class DirSizeSketch
+
+
     /**
      * A more specialized version of FileInfo: This class can manage
      * children. The base class (FileInfo) has only stubs for the respective
@@ -254,6 +367,26 @@ namespace QDirStat
 	 **/
 	time_t oldestFileMTime() override;
 
+	/**
+	 * Returns the summary of the largest, newest, and oldest files in
+	 * this subtree, or 0 if the subtree is too small to carry one.  Small
+	 * subtrees are quicker to walk than to summarise.
+	 **/
+	const DirTopFiles * topFiles() { ensureClean(); return _topFiles; }
+
+	/**
+	 * Returns the sketch of the file and symlink sizes in this
+	 * subtree, or 0 if the subtree is too small to carry one.
+	 **/
+	const DirSizeSketch * sizeSketch() { ensureClean(); return _sizeSketch; }
+
+	/**
+	 * Returns the modification year and month statistics for the
+	 * files and symlinks in this subtree, or 0 if the subtree is too
+	 * small to carry them.
+	 **/
+	const FileAgeStats * ageStats() { ensureClean(); return _ageStats; }
+
 	/**
 	 * Returns 'true' if this had been excluded while reading.
 	 **/
@@ -395,6 +528,24 @@ namespace QDirStat
 	 **/
 	void readJobAborted();
 
+	/**
+	 * Start adding a batch of children to this directory: until
+	 * endBatch(), the totals of the new children are only added to this
+	 * directory and not to its ancestors.  This is only done for a new
+	 * directory with no children yet and no ignored ancestors, and is
+	 * ignored otherwise.
+	 *
+	 * This saves walking up the whole tree for every new child while a
+	 * directory is being read.
+	 **/
+	void beginBatch();
+
+	/**
+	 * Finish a batch of new children: add their totals to all the
+	 * ancestors at once.
+	 **/
+	void endBatch();
+
 	/**
 	 * Finalize this directory level after reading it is completed. This
 	 * does _not_ mean that reading all subdirectories is completed as
@@ -404,6 +555,14 @@ namespace QDirStat
 	 **/
 	void finalizeLocal();
 
+	/**
+	 * Store the MimeCategorizer category index in each file of this
+	 * directory and its dot entry, so that the treemap doesn't have to
+	 * look up the category of every tile it renders.  Files which already
+	 * have an index are skipped unless 'recategorize' is true.
+	 **/
+	void categorizeFiles( bool recategorize = false );
+
 	/**
 	 * Finalize all directories from here on - calls finalizeLocal()
 	 * recursively.
@@ -550,8 +709,9 @@ namespace QDirStat
 	    { return _sortInfo ? child->rowNumber() < _sortInfo->firstNonDominantChild() : false; }
 
 	/**
-	 * Finish reading the directory: Set the specified read state, send
-	 * signals and finalize the directory (clean up dot entries etc.).
+	 * Finish reading the directory: Pass the totals of a batch of new
+	 * children up the tree, set the specified read state, send signals
+	 * and finalize the directory (clean up dot entries etc.).
 	 **/
 	void finishReading( DirReadState readState );
 
@@ -677,6 +837,38 @@ namespace QDirStat
 	 **/
 	void dropSortCache() { delete _sortInfo; _sortInfo = nullptr; }
 
+	/**
+	 * Add 'item' to a subtree summary if there is one, or else build
+	 * the summary from scratch once this subtree has enough items to
+	 * carry that kind of summary.  The thresholds and the builders for
+	 * each kind of summary are in SummaryTraits in DirInfo.cpp.
+	 **/
+	template<typename Summary>
+	void addToSummary( Summary * & summary, FileInfo * item );
+
+	/**
+	 * Merge the summary of a batch of new items, which 'batch' builds
+	 * when it is first needed, into a subtree summary if there is one,
+	 * or else build the summary from scratch once this subtree has
+	 * enough items.
+	 **/
+	template<typename Summary, typename Batch>
+	void mergeIntoSummary( Summary * & summary, Batch & batch );
+
+	/**
+	 * Build a subtree summary again from scratch if this subtree has
+	 * enough items, or else delete it.  Subdirectories with their own
+	 * summary are merged, the others are walked.
+	 **/
+	template<typename Summary>
+	void rebuildSummary( Summary * & summary );
+
+	/**
+	 * Delete a subtree summary.
+	 **/
+	template<typename Summary>
+	static void dropSummary( Summary * & summary );
+
 	/**
 	 * Check the 'ignored' state of this item and set the '_isIgnored' flag
 	 * accordingly.
@@ -712,12 +904,16 @@ namespace QDirStat
 	bool           _locked:1;		// app lock
 	bool           _touched:1;		// app 'touch' flag
 	bool           _fromCache:1;		// is this the root of a cache file read
+	bool           _batching:1;		// new children totals not passed to the ancestors yet
 
 	// Children management
 	FileInfo     * _firstChild{ nullptr };	// pointer to the first child
 	DotEntry     * _dotEntry{ nullptr };	// pseudo entry to hold non-dir children
 	Attic        * _attic{ nullptr };	// pseudo entry to hold ignored children
 	DirSortInfo  * _sortInfo{ nullptr };	// sorted children lists
+	DirTopFiles  * _topFiles{ nullptr };	// largest, newest, and oldest files in large subtrees
+	DirSizeSketch * _sizeSketch{ nullptr };	// file size distribution in large subtrees
+	FileAgeStats * _ageStats{ nullptr };	// file years and months in large subtrees
 
 	// Summary data, not always current as indicated by the _summaryDirty flag
 	DirReadState   _readState;
@@ -7,12 +7,19 @@
  *              Ian Nartowicz
  */
 
-#include <dirent.h> // opendir(), etc
+#include <algorithm> // std::any_of(), std::sort()
+#include <dirent.h>  // fdopendir(), etc
+#include <fcntl.h>   // openat(), fcntl()
+#include <unistd.h>  // close()
+
+#include <QtConcurrent/QtConcurrent>
 
 #include "DirReadJob.h"
+#include "BulkStat.h"
 #include "DirTree.h"
 #include "DirTreeCache.h"
 #include "DirInfo.h"
+#include "HardLinkTable.h"
 #include "Logger.h"
 #include "MountPoints.h"
 #include "SysUtil.h"
@@ -20,6 +27,12 @@
 
 #define VERBOSE_NTFS_HARD_LINKS 0
 
+// Most directories kept open at a time for their subdirectories to be opened relative to
+#define MAX_KEPT_DIR_FDS 256
+
+// Fewest files in a directory for their status to be looked up in bulk
+#define MIN_BULK_STAT_FILES 16
+
 
 using namespace QDirStat;
 
@@ -89,7 +102,7 @@ namespace
 		dir->parent()->setReadState( DirReading );
 
 		// Clean up partially read directory content
-		queue->killSubtree( dir, cacheReadJob ); // will delete the parent job as well!
+		queue->killSubtree( dir, cacheReadJob ); // will cancel or delete the parent job as well!
 
 		tree->deleteSubtree( dir );
 	    }
@@ -125,12 +138,12 @@ namespace
      * the driver reports more than 1.  This function is only called if the
      * config setting is to not trust NTFS hard links.
      *
-     * The NTFS check is expensive (finding the nearest ancestor that is a
-     * mount point is expensive), so the result of this check is cached for
-     * all files in this job/directory.
+     * The filesystem is normally found from the device number of the
+     * directory, but otherwise from its path, so the result of this check
+     * is cached for all files in this job/directory.
      **/
     IsNtfs handleNtfsHardLinks( IsNtfs             isNtfs,
-                                const QString    & dir,
+                                const DirInfo    * dir,
 #if VERBOSE_NTFS_HARD_LINKS
                                 const QByteArray & name,
 #else
@@ -144,9 +157,12 @@ namespace
 	    {
 		isNtfs = NotNtfs;
 	    }
-	    else if ( !dir.isEmpty() )
+	    else
 	    {
-		const MountPoint * mountPoint = MountPoints::findNearestMountPoint( dir );
+		const MountPoint * mountPoint = MountPoints::findByDevice( dir->device() );
+		if ( !mountPoint )
+		    mountPoint = MountPoints::findNearestMountPoint( dir->url() );
+
 		isNtfs = mountPoint && mountPoint->isNtfs() ? Ntfs : NotNtfs;
 	    }
 	}
@@ -154,7 +170,7 @@ namespace
 	if ( isNtfs == Ntfs )
 	{
 #if VERBOSE_NTFS_HARD_LINKS
-	    logWarning() << "Not trusting NTFS hard links for \"" << dir << '/' << name
+	    logWarning() << "Not trusting NTFS hard links for \"" << dir->url() << '/' << name
 	                 << "\" links: " << statInfo.st_nlink << " -> resetting to 1"
 	                 << Qt::endl;
 #endif
@@ -195,15 +211,16 @@ namespace
 
     /**
      * Process the directory 'entryName'.  This does late exclude (match any
-     * child) checking, adds a new LocalDirReadJob if not crossing to a
+     * child) checking, adds the directory to be read if not crossing to a
      * different filesystem or if crossing is configured, and finishes this
      * job.
      **/
-    void processSubDir( DirTree       * tree,
-                        DirInfo       * dir,
-                        const QString & entryName,
-                        const QString & fullName,
-                        struct stat   & statInfo )
+    void processSubDir( DirTree        * tree,
+                        DirInfo        * dir,
+                        const QString  & entryName,
+                        const QString  & fullName,
+                        struct stat    & statInfo,
+                        const DirFdPtr & dirFd )
     {
 	DirInfo * subDir = new DirInfo{ dir, tree, entryName, statInfo };
 	dir->insertChild( subDir );
@@ -217,14 +234,14 @@ namespace
 	}
 	else if ( !DirTree::crossingFilesystems( dir, subDir ) ) // normal case
 	{
-	    tree->addJob( new LocalDirReadJob{ tree, subDir, true } );
+	    tree->addDirToRead( subDir, true, dirFd );
 	}
 	else // The subdirectory we just found is a mount point.
 	{
 	    subDir->setMountPoint();
 
 	    if ( tree->crossFilesystems() && shouldCrossIntoFilesystem( subDir ) )
-		tree->addJob( new LocalDirReadJob{ tree, subDir, true } );
+		tree->addDirToRead( subDir, true );
 	    else
 		subDir->finishReading( DirOnRequestOnly );
 	}
@@ -287,6 +304,16 @@ DirReadJob::~DirReadJob()
 }
 
 
+void DirReadJob::cancel()
+{
+    if ( _dir && _dir->checkMagicNumber() )
+	_dir->readJobFinished( _dir );
+
+    _dir       = nullptr;
+    _cancelled = true;
+}
+
+
 void DirReadJob::read()
 {
     if ( !_started )
@@ -311,46 +338,124 @@ void DirReadJob::finished()
 
 
 
-LocalDirReadJob::LocalDirReadJob( DirTree * tree,
-                                  DirInfo * dir,
-                                  bool      applyFileChildExcludeRules ):
+std::atomic<int> DirFd::_openCount{ 0 };
+
+
+DirFdPtr DirFd::keep( int fd )
+{
+    if ( ++_openCount > MAX_KEPT_DIR_FDS )
+    {
+	--_openCount;
+	return DirFdPtr{};
+    }
+
+    const int keptFd = fcntl( fd, F_DUPFD_CLOEXEC, 0 );
+    if ( keptFd < 0 )
+    {
+	--_openCount;
+	return DirFdPtr{};
+    }
+
+    return DirFdPtr{ new DirFd{ keptFd } };
+}
+
+
+DirFd::~DirFd()
+{
+    close( _fd );
+    --_openCount;
+}
+
+
+
+
+LocalDirReadJob::LocalDirReadJob( DirTree         * tree,
+                                  DirInfo         * dir,
+                                  bool              applyFileChildExcludeRules,
+                                  const DirFdPtr  & parentFd ):
     DirReadJob{ tree, dir },
-    _applyFileChildExcludeRules{ applyFileChildExcludeRules }
+    _applyFileChildExcludeRules{ applyFileChildExcludeRules },
+    _parentFd{ parentFd }
 {
-    if ( dir )
-	_dirName = dir->url();
+    // The path is only built when the job is started, so queued jobs stay small
 }
 
 
-void LocalDirReadJob::startReading()
+LocalDirReadJob::~LocalDirReadJob()
 {
-    // logDebug() << dir() << Qt::endl;
+    // Don't wait for a worker thread, which keeps its own reference to the result
+    if ( _diskRead )
+	_diskRead->cancelled = true;
+}
 
-    // Directories without 'x' permission can be opened here, but stat will fail on the contents
-    DIR * diskDir = opendir( _dirName.toUtf8() );
-    if ( !diskDir )
+
+void LocalDirReadJob::prefetch( QThreadPool * pool, const std::function<void()> & done )
+{
+    prepareOpen();
+
+    // The thread keeps the result alive if this job is deleted first
+    const std::shared_ptr<DiskRead> diskRead = _diskRead;
+    const auto runRead = [ diskRead, done ]()
     {
-	switch ( errno )
-	{
-	    case EACCES:
-		//logWarning() << "No permission to read directory " << _dirName << Qt::endl;
-		dir()->finishReading( DirPermissionDenied );
-		break;
+	readEntries( *diskRead );
+	done();
+    };
 
-	    default:
-		const QString msg{ "Unable to read directory %1: %2" };
-		logWarning() << msg.arg( _dirName, formatErrno() ) << Qt::endl;
-		dir()->finishReading( DirError );
-		break;
-	}
+#if QT_VERSION < QT_VERSION_CHECK( 6, 0, 0 )
+    QtConcurrent::run( pool, runRead );
+#else
+    std::ignore = QtConcurrent::run( pool, runRead );
+#endif
+}
 
-	finished();
-	// Don't add anything after finished() since this deletes this job!
+
+void LocalDirReadJob::prepareOpen()
+{
+    _diskRead = std::make_shared<DiskRead>();
+
+    // The name has to be taken from the tree in the main thread
+    _diskRead->openName = _parentFd ? dir()->name().toUtf8() : dirName().toUtf8();
+    _diskRead->parentFd.swap( _parentFd );
+    _diskRead->useBulkStat = tree()->useBulkStat();
+}
+
+
+const QString & LocalDirReadJob::dirName()
+{
+    if ( _dirName.isEmpty() )
+	_dirName = dir()->url();
+
+    return _dirName;
+}
+
+
+void LocalDirReadJob::readEntries( DiskRead & diskRead )
+{
+    // The job may have been deleted before the thread got to it
+    if ( diskRead.cancelled )
+    {
+	diskRead.finished = true;
 	return;
     }
-    int dirFd = dirfd( diskDir );
 
-    dir()->setReadState( DirReading );
+    // Directories without 'x' permission can be opened here, but stat will fail on the contents
+    const int openFlags = O_RDONLY | O_DIRECTORY | O_CLOEXEC;
+    const int fd = diskRead.parentFd ? openat( diskRead.parentFd->fd(), diskRead.openName, openFlags | O_NOFOLLOW ) :
+                                       open( diskRead.openName, openFlags );
+
+    // The parent directory isn't needed any more, let it be closed as soon as possible
+    diskRead.parentFd.reset();
+
+    DIR * diskDir = fd < 0 ? nullptr : fdopendir( fd );
+    if ( !diskDir )
+    {
+	diskRead.readErrno = errno;
+	diskRead.finished  = true;
+	if ( fd >= 0 )
+	    close( fd );
+	return;
+    }
+    const int dirFd = dirfd( diskDir );
 
     // QMultiMap (just like QMap) guarantees sort order by keys, so we are
     // now iterating over the directory entries by i-number order. Most
@@ -362,24 +467,113 @@ void LocalDirReadJob::startReading()
     // in the same directory, a QMap would store only one of them, all others
     // would go missing in the DirTree.
     QMultiMap<ino_t, QByteArray> entryMap;
+    QVector<ino_t> fileInodes;
     struct dirent * entry;
     while ( ( entry = readdir( diskDir ) ) )
     {
 	const QByteArray entryName = entry->d_name;
 	if ( entryName != "." && entryName != ".." )
+	{
 	    entryMap.insert( entry->d_ino, entryName );
+
+	    // Directories may be mount points with inodes on another filesystem
+	    if ( entry->d_type != DT_DIR && entry->d_type != DT_UNKNOWN )
+		fileInodes << entry->d_ino;
+	}
+    }
+
+    // Look up the files in one go if the filesystem allows it
+    QHash<ino_t, struct stat> bulkStatInfo;
+    if ( diskRead.useBulkStat && fileInodes.size() >= MIN_BULK_STAT_FILES && !diskRead.cancelled )
+    {
+	const BulkStat * bulkStat = BulkStat::forDirectory( dirFd );
+	if ( bulkStat )
+	{
+	    std::sort( fileInodes.begin(), fileInodes.end() );
+	    bulkStatInfo = bulkStat->statInodes( dirFd, fileInodes );
+	}
     }
 
-    for ( const QByteArray & entryName : asConst( entryMap ) )
+    QVector<Entry> & entries = diskRead.entries;
+    entries.reserve( entryMap.size() );
+    for ( auto it = entryMap.cbegin(); it != entryMap.cend() && !diskRead.cancelled; ++it )
     {
-	const QString fullEntryName = fullName( _dirName, entryName );
+	Entry dirEntry{ it.value(), {}, 0 };
+
+	const auto bulkIt = bulkStatInfo.constFind( it.key() );
+	if ( bulkIt != bulkStatInfo.cend() )
+	    dirEntry.statInfo = bulkIt.value();
+	else if ( SysUtil::stat( dirFd, dirEntry.name, dirEntry.statInfo ) != 0 )
+	    dirEntry.statErrno = errno;
+
+	entries << dirEntry;
+    }
+
+    // Keep the directory open for the subdirectories to be opened relative to it
+    const auto isDir = []( const Entry & entry ) { return entry.statErrno == 0 && S_ISDIR( entry.statInfo.st_mode ); };
+    if ( !diskRead.cancelled && std::any_of( entries.cbegin(), entries.cend(), isDir ) )
+	diskRead.dirFd = DirFd::keep( dirFd );
+
+    closedir( diskDir );
+
+    diskRead.finished = true;
+}
+
+
+void LocalDirReadJob::startReading()
+{
+    // logDebug() << dir() << Qt::endl;
+
+    // Read the directory now unless a worker thread has already done it
+    if ( !_diskRead )
+    {
+	prepareOpen();
+	readEntries( *_diskRead );
+    }
 
-	struct stat statInfo;
-	if ( SysUtil::stat( dirFd, entryName, statInfo ) == 0 ) // OK
+    const int readErrno = _diskRead->readErrno;
+
+    if ( readErrno != 0 )
+    {
+	switch ( readErrno )
+	{
+	    case EACCES:
+		//logWarning() << "No permission to read directory " << _dirName << Qt::endl;
+		dir()->finishReading( DirPermissionDenied );
+		break;
+
+	    default:
+		const QString msg{ "Unable to read directory %1: %2" };
+		errno = readErrno;
+		logWarning() << msg.arg( dirName(), formatErrno() ) << Qt::endl;
+		dir()->finishReading( DirError );
+		break;
+	}
+
+	finished();
+	// Don't add anything after finished() since this deletes this job!
+	return;
+    }
+
+    dir()->setReadState( DirReading );
+
+    // Pass the totals of all the entries up the tree at once when the directory is finished
+    dir()->beginBatch();
+
+    // Only build the full path of every entry if the exclude rules or filters need it
+    const bool needFullPath = tree()->matchNeedsFullPath();
+
+    for ( Entry & entry : _diskRead->entries )
+    {
+	const QByteArray & entryName = entry.name;
+	const QString fullEntryName = needFullPath ? fullName( dirName(), entryName ) : QString{};
+	struct stat & statInfo = entry.statInfo;
+
+	if ( entry.statErrno == 0 ) // OK
 	{
 	    if ( S_ISDIR( statInfo.st_mode ) ) // directory child
 	    {
-		processSubDir( tree(), dir(), entryName, fullEntryName, statInfo );
+		processSubDir( tree(), dir(), entryName, fullEntryName, statInfo, _diskRead->dirFd );
 	    }
 	    else  // non-directory child
 	    {
@@ -390,32 +584,47 @@ void LocalDirReadJob::startReading()
 		    // Try to read the cache file. If that was successful and the toplevel
 		    // path in that cache file matches the path of the directory we are
 		    // reading right now, the directory is finished reading, the read job
-		    // (this object) was just deleted, and we may no longer access any
+		    // (this object) was cancelled or deleted, and we may no longer access any
 		    // member variables; just return.
-		    if ( readCacheFile( tree(), queue(), dir(), _dirName, fullEntryName ) )
+		    if ( readCacheFile( tree(), queue(), dir(), dirName(), fullName( dirName(), entryName ) ) )
 			return;
 		}
 
 		if ( statInfo.st_nlink > 1 && !tree()->trustNtfsHardLinks() )
-		    _isNtfs = handleNtfsHardLinks( _isNtfs, _dirName, entryName, statInfo );
+		    _isNtfs = handleNtfsHardLinks( _isNtfs, dir(), entryName, statInfo );
 
 		FileInfo * child = new FileInfo{ dir(), tree(), entryName, statInfo };
 
 		if ( tree()->checkIgnoreFilters( fullEntryName ) )
+		{
+		    // Ignored files aren't counted, so leave them out of the table
+		    if ( tree()->hardLinks() && child->isFile() && child->links() > 1 )
+			tree()->hardLinks()->markIncomplete();
+
 		    dir()->addToAttic( child );
+		}
 		else
+		{
+		    // Count each hard-linked inode only once if there is a table
+		    if ( tree()->hardLinks() && child->isFile() && child->links() > 1 )
+			tree()->hardLinks()->add( child, statInfo.st_dev, statInfo.st_ino );
+
 		    dir()->insertChild( child );
+		}
 
 		tree()->childAddedNotify( child );
 	    }
 	}
 	else // fstatat() error
 	{
-	    handleStatError( entryName, fullEntryName, dir(), tree() );
+	    // The error may have come from a worker thread
+	    errno = entry.statErrno;
+	    handleStatError( entryName, fullName( dirName(), entryName ), dir(), tree() );
 	}
     }
 
-    closedir( diskDir );
+    // The entries aren't needed any more, and neither is the directory
+    _diskRead.reset();
 
     // Check all entries against exclude rules that match against any
     // direct non-directory entry.  Don't do this check for the top-level
@@ -10,10 +10,18 @@
 #ifndef DirReadJob_h
 #define DirReadJob_h
 
+#include <atomic>
+#include <functional>
 #include <memory>
 
+#include <sys/stat.h> // struct stat
+
 #include <QString>
 #include <QTextStream>
+#include <QVector>
+
+
+class QThreadPool;
 
 
 namespace QDirStat
@@ -74,6 +82,42 @@ namespace QDirStat
 	 **/
 	virtual void read();
 
+	/**
+	 * Return 'true' if the slow part of this job can be done in a worker
+	 * thread with prefetch() before read() is called.
+	 *
+	 * This default implementation returns 'false'.
+	 **/
+	virtual bool canPrefetch() const { return false; }
+
+	/**
+	 * Start the slow part of this job in a worker thread from 'pool'
+	 * and call 'done' from that thread when it is finished.  This is
+	 * only called for jobs that can prefetch.
+	 *
+	 * The worker thread doesn't touch the tree, so the job still has to
+	 * be read in the main thread with read() afterwards.
+	 **/
+	virtual void prefetch( QThreadPool *, const std::function<void()> & ) {}
+
+	/**
+	 * Return 'true' if this job has been started with prefetch() and
+	 * the worker thread isn't finished yet.
+	 **/
+	virtual bool isPrefetching() const { return false; }
+
+	/**
+	 * Cancel this job before its directory is deleted: stop counting it
+	 * as a pending job of the directory and forget the directory.  The
+	 * queue deletes the job later without reading it.
+	 **/
+	void cancel();
+
+	/**
+	 * Return 'true' if this job has been cancelled.
+	 **/
+	bool isCancelled() const { return _cancelled; }
+
 	/**
 	 * Returns the corresponding DirInfo item.
 	 * Caution: this may be 0.
@@ -135,10 +179,60 @@ namespace QDirStat
 	DirInfo         * _dir;
 	DirReadJobQueue * _queue{ nullptr };
 	bool              _started{ false };
+	bool              _cancelled{ false };
 
     };	// class DirReadJob
 
 
+    /**
+     * An open directory that the read jobs for its subdirectories share,
+     * so that they can be opened with openat() relative to it instead of
+     * by walking their whole path again.  The descriptor is closed when
+     * the last job using it lets go of it.
+     *
+     * Only a limited number of these are open at the same time; when
+     * there are too many, directories are opened by their path instead.
+     **/
+    class DirFd final
+    {
+    public:
+
+	/**
+	 * Return a new DirFd with a duplicate of 'fd', or null if too many are
+	 * open already.  This is safe to call from any thread.
+	 **/
+	static std::shared_ptr<const DirFd> keep( int fd );
+
+	/**
+	 * Destructor.  Closes the descriptor.
+	 **/
+	~DirFd();
+
+	/**
+	 * Suppress copy and assignment constructors.
+	 **/
+	DirFd( const DirFd & ) = delete;
+	DirFd & operator=( const DirFd & ) = delete;
+
+	/**
+	 * Return the file descriptor.
+	 **/
+	int fd() const { return _fd; }
+
+
+    private:
+
+	DirFd( int fd ): _fd{ fd } {}
+
+	int _fd;
+
+	static std::atomic<int> _openCount;
+
+    };	// class DirFd
+
+    typedef std::shared_ptr<const DirFd> DirFdPtr;
+
+
     /**
      * Enum for caching whether this job/directory is on an NTFS mount.
      **/
@@ -159,9 +253,19 @@ namespace QDirStat
     public:
 
 	/**
-	 * Constructor.
+	 * Constructor.  If 'parentFd' is set, the directory is opened
+	 * relative to it.
 	 **/
-	LocalDirReadJob( DirTree * tree, DirInfo * dir, bool applyFileChildExcludeRules );
+	LocalDirReadJob( DirTree         * tree,
+	                 DirInfo         * dir,
+	                 bool              applyFileChildExcludeRules,
+	                 const DirFdPtr  & parentFd = DirFdPtr{} );
+
+	/**
+	 * Destructor.  Any worker thread still reading the directory is
+	 * told to stop, but not waited for: it frees the result itself.
+	 **/
+	~LocalDirReadJob() override;
 
 	/**
 	 * Return 'true' if any exclude rules matching against any direct file
@@ -172,26 +276,108 @@ namespace QDirStat
 	 **/
 	bool applyFileChildExcludeRules() const { return _applyFileChildExcludeRules; }
 
+	/**
+	 * Local directories can be read from disk in a worker thread.
+	 *
+	 * Reimplemented from DirReadJob.
+	 **/
+	bool canPrefetch() const override { return true; }
+
+	/**
+	 * Read the directory entries and their status from disk in a worker
+	 * thread.
+	 *
+	 * Reimplemented from DirReadJob.
+	 **/
+	void prefetch( QThreadPool * pool, const std::function<void()> & done ) override;
+
+	/**
+	 * Return 'true' while the directory is being read in a worker
+	 * thread.
+	 *
+	 * Reimplemented from DirReadJob.
+	 **/
+	bool isPrefetching() const override { return _diskRead && !_diskRead->finished; }
+
 
     protected:
 
 	/**
-	 * Read the directory. Prior to this nothing happens.
+	 * Create the children of the directory from its entries, reading
+	 * them first if they haven't been prefetched.
 	 *
 	 * Inherited and reimplemented from DirReadJob.
 	 **/
 	void startReading() override;
 
+	/**
+	 * Get ready to open the directory: start the result of reading it,
+	 * with the name to open it by, relative to the parent directory if
+	 * that is still open or else the full path, and the settings for
+	 * reading it from the tree.  This accesses the tree, so it must be
+	 * called in the main thread.
+	 **/
+	void prepareOpen();
+
+	/**
+	 * Return the full path of the directory, building it the first time
+	 * it is needed.  Only call this in the main thread.
+	 **/
+	const QString & dirName();
+
 
     private:
 
+	/**
+	 * One entry of the directory and the result of fstatat() or a bulk
+	 * lookup for it.
+	 **/
+	struct Entry
+	{
+	    QByteArray  name;
+	    struct stat statInfo;
+	    int         statErrno;
+	};
+
+	/**
+	 * Reading the directory from disk, which may be done in a worker
+	 * thread.  This is shared with the thread, so a job can be deleted
+	 * without waiting for the thread to finish.
+	 **/
+	struct DiskRead
+	{
+	    QByteArray        openName;   // relative to parentFd, or the full path
+	    DirFdPtr          parentFd;   // released once the directory is open
+	    bool              useBulkStat{ false };
+
+	    QVector<Entry>    entries;
+	    int               readErrno{ 0 };
+	    DirFdPtr          dirFd;      // for the subdirectories to be opened relative to
+
+	    std::atomic<bool> cancelled{ false };
+	    std::atomic<bool> finished{ false };
+	};
+
+	/**
+	 * Read the names of the directory entries in i-number order and the
+	 * status of each one, in bulk where possible (see BulkStat).  This
+	 * only uses 'diskRead', so it can be called in a worker thread.
+	 * It stops early if the read is cancelled.
+	 **/
+	static void readEntries( DiskRead & diskRead );
+
 	//
 	// Data members
 	//
 
-	QString _dirName;
-	bool    _applyFileChildExcludeRules;
-	IsNtfs  _isNtfs{ NotChecked };
+	QString           _dirName;
+	bool              _applyFileChildExcludeRules;
+	IsNtfs            _isNtfs{ NotChecked };
+	bool              _useBulkStat{ false };
+
+	DirFdPtr          _parentFd;   // moved to _diskRead when it is started
+
+	std::shared_ptr<DiskRead> _diskRead;
 
     };	// LocalDirReadJob
 
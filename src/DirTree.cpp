@@ -7,28 +7,52 @@
  *              Ian Nartowicz
  */
 
+#include <algorithm> // std::reverse()
+#include <cstdio>    // rename()
+
 #include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
 #include <QFileInfo>
 #include <QMultiHash>
+#include <QSet>
+#include <QtConcurrent/QtConcurrent>
 
 #include "DirTree.h"
 #include "Attic.h"
 #include "DirTreeCache.h"
 #include "DirTreeFilter.h"
+#include "DotEntry.h"
 #include "Exception.h"
 #include "ExcludeRules.h"
 #include "FileInfoIterator.h"
 #include "FileInfoSet.h"
+#include "FileNameIndex.h"
 #include "FormatUtil.h"
+#include "HardLinkTable.h"
+#include "MimeCategorizer.h"
 #include "MountPoints.h"
 #include "PkgFilter.h"
 #include "PkgQuery.h"
 #include "PkgReader.h"
+#include "Settings.h"
 #include "SysUtil.h"
 
 
 #define VERBOSE_EXCLUDE_RULES 0
 
+// Most directories that are read in worker threads at the same time
+#define MAX_READ_THREADS        32
+
+// Most directories that are read ahead of the main thread, read or not
+#define MAX_PREFETCHED_JOBS     64
+
+// Name of the checkpoint file, in the same directory as the settings
+#define CHECKPOINT_NAME         "scan-checkpoint.cache.gz"
+
+// How long the current item has to stay the same before its jobs are moved to the front
+#define PRIORITIZE_DELAY_MILLISEC  300
+
 
 using namespace QDirStat;
 
@@ -72,6 +96,8 @@ namespace
 	if ( !S_ISDIR( statInfo.st_mode ) ) // not directory
 	{
 	    FileInfo * file = new FileInfo{ parent, tree, name, statInfo };
+	    if ( tree->hardLinks() && file->isFile() && file->links() > 1 )
+		tree->hardLinks()->add( file, statInfo.st_dev, statInfo.st_ino );
 	    parent->insertChild( file );
 
 	    return file;
@@ -240,6 +266,48 @@ namespace
 	tree->addJob( new LocalDirReadJob{ tree, item->toDirInfo(), false } );
     }
 
+
+    /**
+     * Recurse through the tree from 'dir' on and look up the category of
+     * every file again.
+     **/
+    void recategorizeAll( DirInfo * dir )
+    {
+	dir->categorizeFiles( true );
+
+	for ( DirInfoIterator it{ dir }; *it; ++it )
+	    recategorizeAll( *it );
+    }
+
+
+    /**
+     * Write 'snapshot' to a new file first and then replace 'fileName'
+     * with it, so there is always a complete checkpoint.  This runs in a
+     * worker thread, so nothing is logged; the return value is an error
+     * message, or empty if the checkpoint was written or cancelled.
+     **/
+    QString writeCheckpointFile( const CacheSnapshot       & snapshot,
+                                 const QString             & fileName,
+                                 const std::atomic<bool>   * cancelled )
+    {
+	const QString newFileName = fileName + ".new";
+
+	const char * failedCall = snapshot.write( newFileName, cancelled );
+	if ( failedCall )
+	    return QString{ failedCall } % "() failed for " % newFileName;
+
+	if ( *cancelled )
+	{
+	    QFile::remove( newFileName );
+	    return QString{};
+	}
+
+	if ( std::rename( newFileName.toUtf8().constData(), fileName.toUtf8().constData() ) != 0 )
+	    return "Can't rename " % newFileName % ": " % formatErrno();
+
+	return QString{};
+    }
+
 } // namespace
 
 
@@ -254,11 +322,33 @@ DirTree::DirTree( QObject * parent ):
 
     connect( this,       &DirTree::deletingChild,
              &_jobQueue, &DirReadJobQueue::deletingChildNotify );
+
+    connect( MimeCategorizer::instance(), &MimeCategorizer::categoriesChanging,
+             this,                        &DirTree::recategorizing );
+
+    connect( MimeCategorizer::instance(), &MimeCategorizer::categoriesChanged,
+             this,                        &DirTree::categoriesChanged );
+
+    // One checkpoint at a time, later ticks are left out while it is written
+    _checkpointPool.setMaxThreadCount( 1 );
+
+    connect( &_checkpointTimer, &QTimer::timeout,
+             this,              &DirTree::writeCheckpoint );
+
+    connect( &_checkpointWatcher, &QFutureWatcher<QString>::finished,
+             this,                &DirTree::checkpointWritten );
+
+    _prioritizeTimer.setSingleShot( true );
+    connect( &_prioritizeTimer, &QTimer::timeout,
+             this,              &DirTree::prioritizeLastItem );
 }
 
 
 DirTree::~DirTree()
 {
+    // Keep the last complete checkpoint if the program is closed while reading
+    cancelCheckpoint();
+
     clearFilters();
 }
 
@@ -296,9 +386,14 @@ void DirTree::prepare()
 
 void DirTree::clear()
 {
+    stopCheckpoints( false );
     _jobQueue.clear();
+    _prioritizeTimer.stop();
+    _prioritizeDir = nullptr;
 
     _url.clear();
+    _nameIndex.reset();
+    _hardLinks.reset();
     if ( _root )
     {
 	emit clearing();
@@ -339,6 +434,11 @@ void DirTree::startReading( const QString & rawUrl )
 
     sendStartingReading();
 
+    // Start a new table of hard links for the whole tree
+    _hardLinks.reset( _exactHardLinks ? new HardLinkTable{} : nullptr );
+
+    startCheckpoints();
+
     FileInfo * item = createItem( _url, this, root() );
     if ( item ) // should always be an item, will throw if there is an error
     {
@@ -455,6 +555,11 @@ void DirTree::abortReading()
     if ( _jobQueue.isEmpty() )
 	return;
 
+    // Keep the queued directories for resuming, before they are marked as aborted
+    if ( _checkpointing )
+	writeCheckpoint();
+    stopCheckpoints( false );
+
     _jobQueue.abort();
 
     _isBusy = false;
@@ -464,6 +569,8 @@ void DirTree::abortReading()
 
 void DirTree::finalizeTree()
 {
+    _nameIndex.reset();
+
     if ( _root && hasFilters() )
     {
 	ignoreEmptyDirs( root() );
@@ -499,6 +606,8 @@ void DirTree::deleteChild( FileInfo * child )
 
     // Send notification to anybody interested (e.g. SelectionModel)
     emit deletingChild( child );
+    _nameIndex.reset();
+    forgetPrioritized( child );
 
     DirInfo * parent = child->parent();
 
@@ -514,6 +623,8 @@ void DirTree::deleteChild( FileInfo * child )
 void DirTree::deleteSubtree( DirInfo * subtree )
 {
     emit deletingChildren( subtree->parent(), FileInfoSet{ subtree } );
+    if ( _hardLinks )
+	_hardLinks->removeSubtrees( FileInfoSet{ subtree } );
     deleteChild( subtree );
     emit childrenDeleted();
 }
@@ -553,6 +664,8 @@ void DirTree::deleteSubtrees( const FileInfoSet & subtrees )
 	}();
 
 	emit deletingChildren( parent, childrenOfOneParent );
+	if ( _hardLinks )
+	    _hardLinks->removeSubtrees( childrenOfOneParent );
 	for ( FileInfo * child : childrenOfOneParent )
 	    deleteChild( child );
 	emit childrenDeleted();
@@ -572,6 +685,10 @@ void DirTree::clearSubtree( DirInfo * subtree )
     if ( subtree->hasChildren() )
     {
 	emit clearingSubtree( subtree );
+	_nameIndex.reset();
+	forgetPrioritized( subtree );
+	if ( _hardLinks )
+	    _hardLinks->removeSubtrees( FileInfoSet{ subtree } );
 	subtree->clear();
 	emit subtreeCleared();
     }
@@ -581,17 +698,40 @@ void DirTree::clearSubtree( DirInfo * subtree )
 void DirTree::sendStartingReading()
 {
     _isBusy = true;
+    _nameIndex.reset();
     emit startingReading();
 }
 
 
 void DirTree::sendFinished()
 {
+    stopCheckpoints( true );
     finalizeTree();
+
+    if ( _hardLinks )
+    {
+	logInfo() << "Hard links: " << _hardLinks->linkCount() << " links to "
+	          << _hardLinks->inodeCount() << " inodes using "
+	          << formatSize( _hardLinks->memoryUsed() ) << Qt::endl;
+
+	if ( _hardLinks->isFull() )
+	    logWarning() << "Hard link table full, some hard links are divided instead" << Qt::endl;
+    }
+
     _isBusy = false;
     emit finished();
 }
 
+
+void DirTree::categoriesChanged()
+{
+    // The render threads were stopped by recategorizing(), and mustn't restart with the old indexes
+    if ( _root )
+	recategorizeAll( _root.get() );
+
+    emit recategorized();
+}
+
 /*
 void DirTree::sendAborted()
 {
@@ -613,6 +753,26 @@ void DirTree::sendReadJobFinished( DirInfo * dir )
 }
 
 
+const FileNameIndex * DirTree::nameIndex()
+{
+    if ( _isBusy || !_root )
+	return nullptr;
+
+    if ( !_nameIndex )
+    {
+	QElapsedTimer timer;
+	timer.start();
+
+	_nameIndex.reset( new FileNameIndex{ _root.get() } );
+
+	logInfo() << "Indexed " << _nameIndex->nameCount() << " names of "
+	          << _nameIndex->itemCount() << " items in " << timer.elapsed() << " ms" << Qt::endl;
+    }
+
+    return _nameIndex.get();
+}
+
+
 FileInfo * DirTree::locate( const QString & url ) const
 {
     // Search from the top of the tree
@@ -647,6 +807,100 @@ bool DirTree::readCache( const QString & cacheFileName )
 }
 
 
+bool DirTree::resumeReading()
+{
+    if ( !readCache( checkpointFileName() ) )
+	return false;
+
+    // The checkpoint belongs to this read now, even if no more are written
+    startCheckpoints();
+    _checkpointing  = true;
+    _ownsCheckpoint = true;
+
+    return true;
+}
+
+
+QString DirTree::checkpointFileName()
+{
+    return QFileInfo{ Settings::primaryFileName() }.absolutePath() + "/" CHECKPOINT_NAME;
+}
+
+
+void DirTree::writeCheckpoint()
+{
+    // Wait until the top level has been read, for example when resuming from a checkpoint
+    const FileInfo * toplevel = firstToplevel();
+    if ( !_isBusy || !toplevel || toplevel->readState() == DirQueued || toplevel->readState() == DirReading )
+	return;
+
+    // Leave this one out rather than queueing up snapshots behind a slow write
+    if ( _checkpointWatcher.isRunning() )
+	return;
+
+    _checkpointWriteTime.start();
+    const CacheSnapshot snapshot{ this };
+    logInfo() << "Checkpoint snapshot taken in " << _checkpointWriteTime.elapsed() << " ms" << Qt::endl;
+
+    // There is only one checkpoint, so an interrupted scan of another tree is lost now
+    const QString fileName = checkpointFileName();
+    if ( !_ownsCheckpoint && QFile::exists( fileName ) )
+	logWarning() << "Replacing the checkpoint of an earlier scan in " << fileName << Qt::endl;
+
+    _ownsCheckpoint = true;
+    _checkpointCancelled = false;
+
+    const std::atomic<bool> * cancelled = &_checkpointCancelled;
+    _checkpointWatcher.setFuture( QtConcurrent::run( &_checkpointPool, [ snapshot, fileName, cancelled ]()
+    {
+	return writeCheckpointFile( snapshot, fileName, cancelled );
+    } ) );
+}
+
+
+void DirTree::checkpointWritten()
+{
+    const QString error = _checkpointWatcher.result();
+    if ( !error.isEmpty() )
+	logError() << error << Qt::endl;
+    else if ( !_checkpointCancelled )
+	logInfo() << "Checkpoint written to " << checkpointFileName()
+	          << " in " << _checkpointWriteTime.elapsed() << " ms" << Qt::endl;
+}
+
+
+void DirTree::startCheckpoints()
+{
+    _checkpointing = _checkpointInterval > 0;
+    if ( _checkpointing )
+	_checkpointTimer.start( _checkpointInterval * 1000 );
+}
+
+
+void DirTree::stopCheckpoints( bool finished )
+{
+    _checkpointTimer.stop();
+
+    // Only remove a checkpoint written by this read or resumed from, not one left by another scan
+    if ( _ownsCheckpoint && finished )
+    {
+	// The tree is complete, so a checkpoint still being written is no use
+	cancelCheckpoint();
+	QFile::remove( checkpointFileName() );
+    }
+
+    _checkpointing  = false;
+    _ownsCheckpoint = false;
+}
+
+
+void DirTree::cancelCheckpoint()
+{
+    _checkpointCancelled = true;
+    _checkpointWatcher.waitForFinished();
+}
+
+
 void DirTree::readPkg( const PkgFilter & pkgFilter )
 {
     _url = pkgFilter.url();
@@ -696,6 +950,21 @@ bool DirTree::matchesExcludeRule( const QString & fullName, const QString & entr
 }
 
 
+bool DirTree::matchNeedsFullPath() const
+{
+    if ( !_filters.isEmpty() )
+	return true;
+
+    if ( _excludeRules && _excludeRules->useFullPath() )
+	return true;
+
+    if ( _tmpExcludeRules && _tmpExcludeRules->useFullPath() )
+	return true;
+
+    return false;
+}
+
+
 bool DirTree::matchesDirectChildren( const DirInfo * dir ) const
 {
     if ( _excludeRules && _excludeRules->matchDirectChildren( dir ) )
@@ -733,6 +1002,40 @@ void DirTree::setIgnoreHardLinks( bool ignore )
 }
 
 
+void DirTree::prioritize( FileInfo * item )
+{
+    if ( !item || !item->isDirInfo() || item->pendingReadJobs() == 0 )
+	return;
+
+    // Anything that deletes the directory before the timer fires also forgets it
+    _prioritizeDir = item->toDirInfo();
+    _prioritizeTimer.start( PRIORITIZE_DELAY_MILLISEC );
+}
+
+
+void DirTree::prioritizeLastItem()
+{
+    DirInfo * dir = _prioritizeDir;
+    _prioritizeDir = nullptr;
+
+    if ( !dir || dir->pendingReadJobs() == 0 )
+	return;
+
+    // logDebug() << "Reading " << dir << " first" << Qt::endl;
+    _jobQueue.prioritize( dir );
+}
+
+
+void DirTree::forgetPrioritized( const FileInfo * subtree )
+{
+    if ( _prioritizeDir && _prioritizeDir->isInSubtree( subtree ) )
+    {
+	_prioritizeTimer.stop();
+	_prioritizeDir = nullptr;
+    }
+}
+
+
 bool DirTree::crossingFilesystems( const DirInfo * parent, const DirInfo * child )
 {
     // If the device numbers match then we're definitely not crossing
@@ -740,9 +1043,15 @@ bool DirTree::crossingFilesystems( const DirInfo * parent, const DirInfo * child
 	return false;
 
     /**
-     * Return the device name that 'dir' is on if it's a mount point.
+     * Return the device name that 'dir' is on if it's a mount point.  This
+     * is looked up by device number if possible, and only by path if the
+     * device number isn't known.
      **/
-    const auto device = []( const DirInfo * dir ) { return MountPoints::device( dir->url() ); };
+    const auto device = []( const DirInfo * dir )
+    {
+	const MountPoint * mountPoint = MountPoints::findByDevice( dir->device() );
+	return mountPoint ? mountPoint->device() : MountPoints::device( dir->url() );
+    };
 
     // See if child is a mountpoint
     const QString childDevice  = device( child );
@@ -750,7 +1059,8 @@ bool DirTree::crossingFilesystems( const DirInfo * parent, const DirInfo * child
 	return false;
 
     // Compare to the parent device name to eliminate mountpoints on the same device (eg. Btrfs sub-volumes)
-    const QString parentDevice = device( parent->findNearestMountPoint() );
+    const MountPoint * parentMountPoint = MountPoints::findByDevice( parent->device() );
+    const QString parentDevice = parentMountPoint ? parentMountPoint->device() : device( parent->findNearestMountPoint() );
     const bool crossing = !parentDevice.isEmpty() && parentDevice != childDevice;
     if ( crossing )
 	logInfo() << "Filesystem boundary at mount point " << child << " on device " << childDevice << Qt::endl;
@@ -763,13 +1073,36 @@ bool DirTree::crossingFilesystems( const DirInfo * parent, const DirInfo * child
 
 
 
+DirReadJobQueue::DirReadJobQueue():
+    QObject {}
+{
+    // The number of threads for each device is limited by startPrefetching()
+    _pool.setMaxThreadCount( MAX_READ_THREADS );
+
+    connect( &_timer, &QTimer::timeout,
+             this,    &DirReadJobQueue::timeSlicedRead );
+}
+
+
 void DirReadJobQueue::enqueue( DirReadJob * job )
 {
     if ( job )
     {
-	_queue.append( job );
 	job->setQueue( this );
 
+	if ( job->dir() )
+	    _dirJobs.insert( job->dir(), job );
+
+	if ( _threadsPerDevice > 0 && job->canPrefetch() && job->dir() )
+	{
+	    // The timer is started once the job has been prefetched
+	    _pending[ job->dir()->device() ] << job;
+	    startPrefetching();
+	    return;
+	}
+
+	_queue.append( job );
+
 	if ( !_timer.isActive() )
 	{
 	    // logDebug() << "First job queued" << Qt::endl;
@@ -779,31 +1112,112 @@ void DirReadJobQueue::enqueue( DirReadJob * job )
 }
 
 
+void DirReadJobQueue::enqueueDir( DirInfo * dir, bool applyFileChildExcludeRules, const DirFdPtr & parentFd )
+{
+    if ( !_depthFirst )
+    {
+	enqueue( new LocalDirReadJob{ dir->tree(), dir, applyFileChildExcludeRules, parentFd } );
+	return;
+    }
+
+    // The directory counts as having a pending job from now on, as if the job had been made
+    dir->readJobAdded();
+    _frontier.append( PendingDir{ dir, parentFd, applyFileChildExcludeRules } );
+
+    if ( !_timer.isActive() )
+	_timer.start( 0 );
+}
+
+
+FileCount DirReadJobQueue::count() const
+{
+    FileCount count = _queue.count() + _blocked.count() + _prefetching.count() + _prefetched.count() + _frontier.count();
+    for ( const DirReadJobList & pending : _pending )
+	count += pending.count();
+
+    return count - _cancelledJobs;
+}
+
+
+bool DirReadJobQueue::isEmpty() const
+{
+    return count() == 0;
+}
+
+
+void DirReadJobQueue::addBlocked( DirReadJob * job )
+{
+    if ( job->dir() )
+	_dirJobs.insert( job->dir(), job );
+
+    _blocked.append( job );
+}
+
+
+void DirReadJobQueue::setThreadsPerDevice( int threads )
+{
+    _threadsPerDevice = qMax( 0, threads );
+
+    if ( _threadsPerDevice == 0 )
+    {
+	// Nothing will be prefetched any more, so read the pending jobs in the main thread
+	for ( const DirReadJobList & pending : asConst( _pending ) )
+	    _queue << pending;
+	_pending.clear();
+
+	if ( !_queue.isEmpty() && !_timer.isActive() )
+	    _timer.start( 0 );
+    }
+    else
+    {
+	startPrefetching();
+    }
+}
+
+
+DirReadJobList DirReadJobQueue::allJobs() const
+{
+    DirReadJobList jobs = _queue + _blocked + _prefetching + _prefetched;
+    for ( const DirReadJobList & pending : _pending )
+	jobs << pending;
+
+    return jobs;
+}
+
+
 void DirReadJobQueue::clear()
 {
-    qDeleteAll( _queue );
-    _queue.clear();
-    _queue.squeeze();
+    // The directories in the frontier stop counting as having a pending job, like deleted jobs
+    for ( const PendingDir & pending : asConst( _frontier ) )
+    {
+	if ( pending.dir->checkMagicNumber() )
+	    pending.dir->readJobFinished( pending.dir );
+    }
+    _frontier.clear();
+
+    // Jobs being prefetched stop their worker thread when they are deleted, without waiting
+    qDeleteAll( allJobs() );
 
-    qDeleteAll( _blocked );
+    _queue.clear();
     _blocked.clear();
-    _blocked.squeeze();
+    _pending.clear();
+    _prefetching.clear();
+    _prefetched.clear();
+    _dirJobs.clear();
+    _cancelledJobs = 0;
 }
 
 
 void DirReadJobQueue::abort()
 {
-    for ( const DirReadJob * job : asConst( _queue ) )
+    for ( const DirReadJob * job : allJobs() )
     {
 	if ( job->dir() )
 	    job->dir()->readJobAborted();
     }
 
-    for ( const DirReadJob * job : asConst( _blocked ) )
-    {
-	if ( job->dir() )
-	    job->dir()->readJobAborted();
-    }
+    for ( const PendingDir & pending : asConst( _frontier ) )
+	pending.dir->readJobAborted();
 
     clear();
 }
@@ -811,10 +1225,110 @@ void DirReadJobQueue::abort()
 
 void DirReadJobQueue::timeSlicedRead()
 {
-    if ( _queue.isEmpty() )
+    // Cancelled jobs are dropped first, so they don't hold up making jobs from the frontier
+    DirReadJob * job = firstJob( _queue );
+    if ( !job )
+    {
+	takeFromFrontier();
+	job = firstJob( _queue );
+    }
+
+    if ( !job && !_prefetched.isEmpty() )
+	job = _prefetched.first();
+
+    if ( !job )
+    {
+	// Restarted when a job has been prefetched
 	_timer.stop();
-    else
-	_queue.first()->read();
+	return;
+    }
+
+    const int frontierSize = _frontier.size();
+
+    job->read();
+
+    // Put the subdirectories found by the job on top of the frontier, the first one found last
+    if ( _frontier.size() > frontierSize )
+	std::reverse( _frontier.begin() + frontierSize, _frontier.end() );
+
+    takeFromFrontier();
+}
+
+
+void DirReadJobQueue::takeFromFrontier()
+{
+    int jobs = _queue.size() + _prefetching.size() + _prefetched.size();
+    for ( const DirReadJobList & pending : asConst( _pending ) )
+	jobs += pending.size();
+
+    // Keep enough jobs for the worker threads to read ahead, or just the next one to read
+    const int maxJobs = _threadsPerDevice > 0 ? MAX_PREFETCHED_JOBS : 1;
+    for ( ; jobs < maxJobs && !_frontier.isEmpty(); ++jobs )
+    {
+	const PendingDir pending = _frontier.takeLast();
+	DirInfo * dir = pending.dir;
+	enqueue( new LocalDirReadJob{ dir->tree(), dir, pending.applyFileChildExcludeRules, pending.parentFd } );
+
+	// The job counts itself as pending now
+	dir->readJobFinished( dir );
+    }
+}
+
+
+void DirReadJobQueue::startPrefetching()
+{
+    for ( auto it = _pending.begin(); it != _pending.end(); )
+    {
+	const dev_t device = it.key();
+	DirReadJobList & pending = it.value();
+
+	int threads = 0;
+	for ( const DirReadJob * job : asConst( _prefetching ) )
+	{
+	    if ( job->dir() && job->dir()->device() == device )
+		++threads;
+	}
+
+	// Limit the threads for each device and the directories read ahead of the main thread
+	while ( !pending.isEmpty() && threads < _threadsPerDevice &&
+	        _prefetching.size() + _prefetched.size() < MAX_PREFETCHED_JOBS )
+	{
+	    DirReadJob * job = pending.takeFirst();
+	    if ( job->isCancelled() )
+	    {
+		deleteCancelled( job );
+		continue;
+	    }
+
+	    _prefetching << job;
+	    ++threads;
+
+	    job->prefetch( &_pool, [ this ]()
+		{ QMetaObject::invokeMethod( this, [ this ]() { prefetchFinished(); }, Qt::QueuedConnection ); } );
+	}
+
+	it = pending.isEmpty() ? _pending.erase( it ) : it + 1;
+    }
+}
+
+
+void DirReadJobQueue::prefetchFinished()
+{
+    // Move the jobs that are finished, in the order they were started
+    DirReadJobList stillPrefetching;
+    for ( DirReadJob * job : asConst( _prefetching ) )
+    {
+	if ( job->isPrefetching() )
+	    stillPrefetching << job;
+	else
+	    _prefetched << job;
+    }
+    _prefetching.swap( stillPrefetching );
+
+    startPrefetching();
+
+    if ( !_prefetched.isEmpty() && !_timer.isActive() )
+	_timer.start( 0 );
 }
 
 
@@ -823,11 +1337,16 @@ void DirReadJobQueue::jobFinishedNotify( DirReadJob * job )
     if ( job )
     {
 	// Get rid of the old (finished) job.
-	_queue.removeOne( job );
+	if ( !_prefetched.removeOne( job ) )
+	    _queue.removeOne( job );
+	_dirJobs.remove( job->dir(), job );
 	delete job;
+
+	// There may be room to read ahead again
+	startPrefetching();
     }
 
-    if ( _queue.isEmpty() && _blocked.isEmpty() )
+    if ( isEmpty() )
     {
 	// The timer will fire again and then stop itself
 	logInfo() << "No more jobs - finishing" << Qt::endl;
@@ -848,33 +1367,144 @@ void DirReadJobQueue::deletingChildNotify( FileInfo * child )
 
 void DirReadJobQueue::killSubtree( DirInfo * subtree, const DirReadJob * exceptJob )
 {
-    if ( !subtree )
+    if ( !subtree || subtree->pendingReadJobs() == 0 )
+	return;
+
+    // Directories in the frontier have no job yet, so they are just forgotten
+    if ( !_frontier.isEmpty() )
+    {
+	QVector<PendingDir> frontier;
+	for ( const PendingDir & pending : asConst( _frontier ) )
+	{
+	    if ( pending.dir->isInSubtree( subtree ) )
+		pending.dir->readJobFinished( pending.dir );
+	    else
+		frontier << pending;
+	}
+	_frontier.swap( frontier );
+    }
+
+    DirReadJobList jobs;
+    addSubtreeJobs( subtree, jobs );
+
+    for ( DirReadJob * job : asConst( jobs ) )
+    {
+	if ( job == exceptJob )
+	    continue;
+
+	_dirJobs.remove( job->dir(), job );
+
+	// Jobs being prefetched stop their worker thread when they are deleted, without waiting
+	if ( _blocked.removeOne( job ) || _prefetching.removeOne( job ) || _prefetched.removeOne( job ) )
+	{
+	    delete job;
+	}
+	else
+	{
+	    // Don't search the long queues, leave the job there until it is reached
+	    job->cancel();
+	    ++_cancelledJobs;
+	}
+    }
+}
+
+
+void DirReadJobQueue::addSubtreeJobs( DirInfo * dir, DirReadJobList & jobs ) const
+{
+    jobs << _dirJobs.values( dir );
+
+    // Only descend into directories with pending jobs somewhere below them
+    const auto addChildJobs = [ this, &jobs ]( FileInfo * child )
+    {
+	if ( child && child->isDirInfo() && child->pendingReadJobs() > 0 )
+	    addSubtreeJobs( child->toDirInfo(), jobs );
+    };
+
+    for ( FileInfo * child = dir->firstChild(); child; child = child->next() )
+	addChildJobs( child );
+
+    addChildJobs( dir->dotEntry() );
+    addChildJobs( dir->attic() );
+}
+
+
+DirReadJob * DirReadJobQueue::firstJob( DirReadJobList & jobs )
+{
+    while ( !jobs.isEmpty() && jobs.first()->isCancelled() )
+	deleteCancelled( jobs.takeFirst() );
+
+    return jobs.isEmpty() ? nullptr : jobs.first();
+}
+
+
+void DirReadJobQueue::deleteCancelled( DirReadJob * job )
+{
+    delete job;
+    --_cancelledJobs;
+}
+
+
+void DirReadJobQueue::prioritize( DirInfo * subtree )
+{
+    if ( !subtree || subtree->pendingReadJobs() == 0 )
 	return;
 
+    // Find the jobs from the directories with pending jobs, rather than checking every job in the queues
+    DirReadJobList subtreeJobList;
+    addSubtreeJobs( subtree, subtreeJobList );
+
+    QSet<const DirReadJob *> subtreeJobs;
+    subtreeJobs.reserve( subtreeJobList.size() );
+    for ( const DirReadJob * job : asConst( subtreeJobList ) )
+	subtreeJobs.insert( job );
+
     /**
-     * Delete all jobs within 'subtree' from the given queue, except 'exceptJob'.
+     * Move all jobs within 'subtree' to the front of the given queue,
+     * keeping the order of the jobs otherwise.
      **/
-    const auto killQueue = [ subtree, exceptJob ]( DirReadJobList & queue )
+    const auto prioritizeQueue = [ &subtreeJobs ]( DirReadJobList & queue )
     {
 	DirReadJobList newQueue;
+	DirReadJobList otherJobs;
 	for ( DirReadJob * job : asConst( queue ) )
 	{
-	    if ( job->dir() && job->dir()->isInSubtree( subtree ) && ( !exceptJob || job != exceptJob ) )
-		delete job;
-	    else
+	    if ( subtreeJobs.contains( job ) )
 		newQueue << job;
+	    else
+		otherJobs << job;
 	}
+	newQueue << otherJobs;
 	newQueue.swap( queue );
     };
 
-    killQueue( _queue );
-    killQueue( _blocked );
+    // The prefetched jobs have been read already and are next anyway
+    prioritizeQueue( _queue );
+    for ( DirReadJobList & pending : _pending )
+	prioritizeQueue( pending );
+
+    // Move the directories in the subtree to the top of the frontier, keeping their order
+    QVector<PendingDir> frontier;
+    QVector<PendingDir> subtreeDirs;
+    for ( const PendingDir & pending : asConst( _frontier ) )
+    {
+	if ( pending.dir->isInSubtree( subtree ) )
+	    subtreeDirs << pending;
+	else
+	    frontier << pending;
+    }
+    frontier << subtreeDirs;
+    _frontier.swap( frontier );
 }
 
 
 void DirReadJobQueue::unblock( DirReadJob * job )
 {
     _blocked.removeAll( job );
+
+    // Added back by enqueue()
+    if ( job->dir() )
+	_dirJobs.remove( job->dir(), job );
+
     enqueue( job );
 
 //    if ( _blocked.isEmpty() )
@@ -10,8 +10,16 @@
 #ifndef DirTree_h
 #define DirTree_h
 
+#include <atomic>
 #include <memory>
 
+#include <sys/types.h> // dev_t
+
+#include <QElapsedTimer>
+#include <QFutureWatcher>
+#include <QHash>
+#include <QList>
+#include <QThreadPool>
 #include <QTimer>
 #include <QVector>
 
@@ -23,21 +31,38 @@
 
 namespace QDirStat
 {
+    class DirFd;
     class DirInfo;
     class DirReadJob;
     class FileInfo;
     class FileInfoSet;
+    class FileNameIndex;
+    class HardLinkTable;
     class ExcludeRules;
     class DirTreeFilter;
     class PkgFilter;
 
-    typedef QVector<DirReadJob *> DirReadJobList;
+    typedef QList<DirReadJob *> DirReadJobList;
+    typedef std::shared_ptr<const DirFd> DirFdPtr;
 
 
     /**
      * Queue for read jobs
      *
      * Handles time-sliced reading automatically.
+     *
+     * Jobs that can prefetch, i.e. local directories, are grouped by the
+     * device they are on and read from disk in worker threads, with a
+     * limited number of threads for each device.  Independent disks are
+     * then read in parallel while each one still sees a few directories
+     * at a time read in i-number order.  The tree itself is only ever
+     * changed in the main thread, when the jobs are read from the queue
+     * after their worker thread is finished.
+     *
+     * When reading depth-first, local directories wait in a frontier
+     * that only holds the directory and the descriptor of its parent,
+     * and a job is only made for each one when it is taken from there.
+     * Only a few jobs then exist at a time.
      **/
     class DirReadJobQueue final : public QObject
     {
@@ -48,12 +73,7 @@ namespace QDirStat
 	/**
 	 * Constructor.
 	 **/
-	DirReadJobQueue():
-	    QObject {}
-	{
-	    connect( &_timer, &QTimer::timeout,
-	             this,    &DirReadJobQueue::timeSlicedRead );
-	}
+	DirReadJobQueue();
 
 	/**
 	 * Destructor.
@@ -62,32 +82,66 @@ namespace QDirStat
 	    { clear(); }
 
 	/**
-	 * Add a job to the end of the queue. Begin time-sliced reading if not
+	 * Add a job to the end of the queue, or to the end of the queue for
+	 * its device if it can prefetch. Begin time-sliced reading if not
 	 * in progress yet.
 	 **/
 	void enqueue( DirReadJob * job );
 
 	/**
-	 * Get the head of the queue (the next job that is due for processing).
+	 * Add local directory 'dir' to be read, opened relative to
+	 * 'parentFd' if that is set.  When reading breadth-first, this
+	 * enqueues a LocalDirReadJob for it straight away; when reading
+	 * depth-first, the directory waits in the frontier until it is
+	 * next to be read.
 	 **/
-	DirReadJob * head() const { return _queue.first();}
+	void enqueueDir( DirInfo        * dir,
+	                 bool             applyFileChildExcludeRules,
+	                 const DirFdPtr & parentFd = DirFdPtr{} );
 
 	/**
 	 * Count the number of pending jobs in the queue.
 	 **/
-	FileCount count() const { return _queue.count() + _blocked.count(); }
+	FileCount count() const;
 
 	/**
 	 * Check if the queue is empty.
 	 **/
-	bool isEmpty() const { return _queue.isEmpty() && _blocked.isEmpty(); }
+	bool isEmpty() const;
+
+	/**
+	 * Return the number of directories on each device that are read in
+	 * worker threads at the same time.
+	 **/
+	int threadsPerDevice() const { return _threadsPerDevice; }
+
+	/**
+	 * Set the number of worker threads for each device.  0 reads all
+	 * directories in the main thread.
+	 **/
+	void setThreadsPerDevice( int threads );
+
+	/**
+	 * Return 'true' if the subdirectories found by a job are read
+	 * before any other directories.
+	 **/
+	bool depthFirst() const { return _depthFirst; }
+
+	/**
+	 * Set whether to read the tree depth-first rather than
+	 * breadth-first.  Reading depth-first keeps the directories waiting
+	 * to be read down to the subdirectories along the current path,
+	 * rather than a whole level of a wide tree, and they wait without a
+	 * read job each.
+	 **/
+	void setDepthFirst( bool depthFirst ) { _depthFirst = depthFirst; }
 
 	/**
 	 * Add a job to the list of blocked jobs: Jobs that are not yet ready
 	 * yet, e.g. because they are waiting for results from an external
 	 * process.
 	 **/
-	void addBlocked( DirReadJob * job ) { _blocked.append( job ); }
+	void addBlocked( DirReadJob * job );
 
 	/**
 	 * Notification that a job that was blocked is now ready to be
@@ -108,10 +162,22 @@ namespace QDirStat
 	void abort();
 
 	/**
-	 * Delete all jobs for a subtree, except 'exceptJob'.
+	 * Delete all jobs for a subtree, except 'exceptJob'.  The jobs are
+	 * found from the directories in the subtree that have pending jobs,
+	 * so this only takes as long as there are jobs to delete.  Jobs
+	 * waiting in the main queue or a device queue are only cancelled
+	 * here and deleted once they reach the front.
 	 **/
 	void killSubtree( DirInfo * subtree, const DirReadJob * exceptJob = nullptr );
 
+	/**
+	 * Move all the jobs for a subtree to the front of the queue, so that
+	 * it is read before anything else.  The jobs are found from the
+	 * directories in the subtree that have pending jobs, but the queues
+	 * are still rebuilt, so this is best not called too often.
+	 **/
+	void prioritize( DirInfo * subtree );
+
 	/**
 	 * Notification that a job is finished.
 	 * This takes that job out of the queue and deletes it.
@@ -159,12 +225,73 @@ namespace QDirStat
 	 **/
 	void timeSlicedRead();
 
+	/**
+	 * Notification from a worker thread that a job was prefetched.
+	 **/
+	void prefetchFinished();
+
+
+    protected:
+
+	/**
+	 * Start prefetching the pending jobs for each device that has a
+	 * worker thread to spare.
+	 **/
+	void startPrefetching();
+
+	/**
+	 * Make jobs for the directories at the top of the frontier, as long
+	 * as there are fewer jobs than the most that are kept ready to
+	 * read: one, or enough for the worker threads to read ahead.
+	 **/
+	void takeFromFrontier();
+
+	/**
+	 * Return all the jobs in the queue.
+	 **/
+	DirReadJobList allJobs() const;
+
+	/**
+	 * Add the jobs for 'dir' and all the directories below it to 'jobs'.
+	 **/
+	void addSubtreeJobs( DirInfo * dir, DirReadJobList & jobs ) const;
+
+	/**
+	 * Return the first job in 'jobs' that hasn't been cancelled, or 0 if
+	 * there is none.  Cancelled jobs in front of it are deleted.
+	 **/
+	DirReadJob * firstJob( DirReadJobList & jobs );
+
+	/**
+	 * Delete a job that was cancelled.
+	 **/
+	void deleteCancelled( DirReadJob * job );
+
 
     private:
 
-	DirReadJobList _queue;
-	DirReadJobList _blocked;
-	QTimer         _timer;
+	/**
+	 * A directory in the frontier, waiting for a job to read it.
+	 **/
+	struct PendingDir
+	{
+	    DirInfo * dir;
+	    DirFdPtr  parentFd;
+	    bool      applyFileChildExcludeRules;
+	};
+
+	DirReadJobList                 _queue;    // jobs to read in the main thread
+	DirReadJobList                 _blocked;
+	QHash<dev_t, DirReadJobList>   _pending;  // jobs waiting to be prefetched, for each device
+	DirReadJobList                 _prefetching;
+	DirReadJobList                 _prefetched;
+	QThreadPool                    _pool;
+	QTimer                         _timer;
+	int                            _threadsPerDevice{ 0 };
+	bool                           _depthFirst{ false };
+	QVector<PendingDir>            _frontier;  // directories without a job yet, the next one last
+	QMultiHash<const DirInfo *, DirReadJob *> _dirJobs;  // the queued jobs for each directory
+	FileCount                      _cancelledJobs{ 0 };  // still in _queue or _pending
 
     };	// class DirReadJobQueue
 
@@ -332,6 +459,16 @@ namespace QDirStat
 	void addJob( DirReadJob * job )
 	    { _jobQueue.enqueue( job ); }
 
+	/**
+	 * Add a local directory to be read, opened relative to 'parentFd'
+	 * if that is set.  This only makes a read job for it once it is
+	 * next to be read if reading depth-first.
+	 **/
+	void addDirToRead( DirInfo        * dir,
+	                   bool             applyFileChildExcludeRules,
+	                   const DirFdPtr & parentFd = DirFdPtr{} )
+	    { _jobQueue.enqueueDir( dir, applyFileChildExcludeRules, parentFd ); }
+
 	/**
 	 * Add a new directory read job to the list of blocked jobs. A job may
 	 * be blocked because it may be waiting for an external process to
@@ -364,6 +501,38 @@ namespace QDirStat
 	void setCrossFilesystems( bool crossFilesystems )
 	    { _crossFilesystems = crossFilesystems; }
 
+	/**
+	 * Return the number of directories on each device that are read at
+	 * the same time in worker threads.
+	 **/
+	int readThreadsPerDevice() const { return _jobQueue.threadsPerDevice(); }
+
+	/**
+	 * Set the number of worker threads for reading each device.  0, the
+	 * default, reads all directories in the main thread.
+	 *
+	 * This will be read from the config file from the outside
+	 * (DirTreeModel) and set from there using this function.
+	 **/
+	void setReadThreadsPerDevice( int threads )
+	    { _jobQueue.setThreadsPerDevice( threads ); }
+
+	/**
+	 * Return whether directories are read depth-first.
+	 **/
+	bool depthFirstReading() const { return _jobQueue.depthFirst(); }
+
+	/**
+	 * Set whether to read directories depth-first, which keeps far fewer
+	 * directories waiting on wide trees and only a few read jobs at a
+	 * time, or breadth-first.
+	 *
+	 * This will be read from the config file from the outside
+	 * (DirTreeModel) and set from there using this function.
+	 **/
+	void setDepthFirstReading( bool depthFirst )
+	    { _jobQueue.setDepthFirst( depthFirst ); }
+
 	/**
 	 * Notification that a child has been added.
 	 *
@@ -397,6 +566,14 @@ namespace QDirStat
 	 **/
 	bool isBusy() const { return _isBusy; }
 
+	/**
+	 * Return the index of all the names in the tree, building it first
+	 * if necessary.  The index is discarded whenever the tree changes
+	 * and rebuilt by the next call.  Returns 0 while reading is in
+	 * progress.
+	 **/
+	const FileNameIndex * nameIndex();
+
 	/**
 	 * Write the complete tree to a cache file.  This will throw if there is
 	 * a fatal error.
@@ -410,6 +587,40 @@ namespace QDirStat
 	 **/
 	bool readCache( const QString & cacheFileName );
 
+	/**
+	 * Read the checkpoint file written while a previous scan was still
+	 * running, and continue reading the directories that were not read
+	 * yet.  The checkpoint is removed once reading is finished.
+	 *
+	 * Returns true if OK, false if there is no usable checkpoint.
+	 **/
+	bool resumeReading();
+
+	/**
+	 * Return the name of the checkpoint file written while a tree is
+	 * read.  It is kept next to the settings files.
+	 **/
+	static QString checkpointFileName();
+
+	/**
+	 * Return the interval in seconds between checkpoints while a tree
+	 * is read, or 0 if no checkpoints are written.
+	 **/
+	int checkpointInterval() const { return _checkpointInterval; }
+
+	/**
+	 * Set the interval in seconds between checkpoints while a tree is
+	 * read: the partially read tree is written to checkpointFileName()
+	 * as a cache file, with the directories that are still queued
+	 * marked so that resumeReading() can read them.  0 disables
+	 * checkpoints.  There is only one checkpoint file, so the first
+	 * checkpoint of a read replaces any left by an earlier scan.
+	 *
+	 * This will be read from the config file from the outside
+	 * (DirTreeModel) and set from there using this function.
+	 **/
+	void setCheckpointInterval( int seconds ) { _checkpointInterval = seconds; }
+
 	/**
 	 * Read installed packages that match the specified PkgFilter and their
 	 * file lists from the system's package manager(s).
@@ -454,6 +665,13 @@ namespace QDirStat
 	 **/
 	bool matchesExcludeRule( const QString & fullName, const QString & entryName ) const;
 
+	/**
+	 * Return 'true' if checking a directory entry against the exclude
+	 * rules or the ignore filters needs its full path.  If not, the full
+	 * path passed to matchesExcludeRule() may be empty.
+	 **/
+	bool matchNeedsFullPath() const;
+
 	/**
 	 * Return 'true' if any chiuldren of the given directory are matched
 	 * by an exclude rule of that type.
@@ -538,6 +756,52 @@ namespace QDirStat
 	 **/
 	bool ignoreHardLinks() const { return _ignoreHardLinks; }
 
+	/**
+	 * Set whether to count hard links exactly: while a tree is read, a
+	 * table of the inodes of all files with multiple hard links is kept,
+	 * and each inode is counted with its full size at the first link
+	 * found and as zero bytes at every other link.  This is only
+	 * approximated by the default policy of dividing the size between
+	 * the links, which goes wrong when some of the links are outside
+	 * the tree.
+	 *
+	 * This takes effect from the next time a tree is read.  It has no
+	 * effect if hard links are ignored.
+	 *
+	 * This flag will be read from the config file from the outside
+	 * (DirTreeModel) and set from there using this function.
+	 **/
+	void setExactHardLinks( bool exact ) { _exactHardLinks = exact; }
+
+	/**
+	 * Return whether hard links are counted exactly.
+	 **/
+	bool exactHardLinks() const { return _exactHardLinks; }
+
+	/**
+	 * Set whether to look up the status of the files in a directory in
+	 * bulk, straight from the inode tables of the filesystem, rather
+	 * than with one system call for each file.  This is only possible on
+	 * XFS and btrfs, and only for root; anything else and any file that
+	 * isn't found are looked up one by one as usual.
+	 *
+	 * This flag will be read from the config file from the outside
+	 * (DirTreeModel) and set from there using this function.
+	 **/
+	void setUseBulkStat( bool useBulkStat ) { _useBulkStat = useBulkStat; }
+
+	/**
+	 * Return whether file status is looked up in bulk.
+	 **/
+	bool useBulkStat() const { return _useBulkStat; }
+
+	/**
+	 * Return the table of hard links for the tree, or 0 if hard links
+	 * are not being counted exactly.  The table is discarded when the
+	 * tree is cleared.
+	 **/
+	HardLinkTable * hardLinks() const { return _hardLinks.get(); }
+
 	/**
 	 * Set whether to trust the number of hard links reported for an NTFS
 	 * file.  If not, then the hard links count is always set to 1; hard
@@ -642,6 +906,20 @@ namespace QDirStat
 	 **/
 	void readJobFinished( DirInfo * dir );
 
+	/**
+	 * Emitted before the categories change and the category of every
+	 * file in the tree is looked up again.  Anything reading the
+	 * category indexes or the palette in another thread must stop
+	 * before this returns.
+	 **/
+	void recategorizing();
+
+	/**
+	 * Emitted after the category of every file in the tree has been
+	 * looked up again.
+	 **/
+	void recategorized();
+
 
     public slots:
 
@@ -651,9 +929,71 @@ namespace QDirStat
 	 **/
 	void sendFinished();
 
+	/**
+	 * Notification that the MimeCategorizer categories have changed.
+	 * This looks up the category index of every file in the tree again
+	 * before returning to the event loop, then sends recategorized().
+	 **/
+	void categoriesChanged();
+
+	/**
+	 * Read 'item' and everything below it before the rest of the tree,
+	 * for example because the user is looking at it.  This does nothing
+	 * if the subtree has already been read.  The jobs are only moved
+	 * once no other item has been prioritized for a moment, so moving
+	 * through the tree with the keyboard doesn't move them for every
+	 * item on the way.
+	 **/
+	void prioritize( FileInfo * item );
+
+	/**
+	 * Move the jobs for the item last passed to prioritize(), if it is
+	 * still in the tree and not read yet.
+	 **/
+	void prioritizeLastItem();
+
+	/**
+	 * Write the partially read tree to the checkpoint file.  Only a
+	 * snapshot of the tree is taken here; the file is written in a
+	 * worker thread.  Nothing is done while the previous checkpoint is
+	 * still being written.
+	 **/
+	void writeCheckpoint();
+
+	/**
+	 * Notification that the worker thread has finished writing a
+	 * checkpoint.  Errors are logged, but otherwise ignored.
+	 **/
+	void checkpointWritten();
+
 
     protected:
 
+	/**
+	 * Start writing checkpoints periodically for a tree that is being
+	 * read, if they are enabled.
+	 **/
+	void startCheckpoints();
+
+	/**
+	 * Stop writing checkpoints.  If 'finished' is set, the tree is
+	 * complete and the checkpoint is no longer needed, so it is removed
+	 * if this read wrote it or was resumed from it.
+	 **/
+	void stopCheckpoints( bool finished );
+
+	/**
+	 * Stop writing any checkpoint that is still in progress and wait
+	 * for the worker thread.  The last complete checkpoint is kept.
+	 **/
+	void cancelCheckpoint();
+
+	/**
+	 * Forget the directory waiting to be prioritized if it is in
+	 * 'subtree', which is about to be deleted or cleared.
+	 **/
+	void forgetPrioritized( const FileInfo * subtree );
+
 	/**
 	 * Refresh a subtree, i.e. read its contents from disk again.
 	 *
@@ -687,15 +1027,29 @@ namespace QDirStat
 	std::unique_ptr<DirInfo>            _root;
 	std::unique_ptr<const ExcludeRules> _excludeRules;
 	std::unique_ptr<const ExcludeRules> _tmpExcludeRules;
+	std::unique_ptr<FileNameIndex>      _nameIndex;
+	std::unique_ptr<HardLinkTable>      _hardLinks;
 
 	QString                        _url;
 	DirReadJobQueue                _jobQueue;
 	QVector<const DirTreeFilter *> _filters;
+	QTimer                         _checkpointTimer;
+	QThreadPool                    _checkpointPool;
+	QFutureWatcher<QString>        _checkpointWatcher;  // the checkpoint being written, with an error message
+	QElapsedTimer                  _checkpointWriteTime;
+	std::atomic<bool>              _checkpointCancelled{ false };
+	QTimer                         _prioritizeTimer;
+	DirInfo                      * _prioritizeDir{ nullptr };  // the directory waiting for _prioritizeTimer
 
 	bool _crossFilesystems{ false };
 	bool _isBusy{ false };
 	bool _ignoreHardLinks{ false };
+	bool _exactHardLinks{ false };
+	bool _useBulkStat{ false };
 	bool _trustNtfsHardLinks{ true };
+	bool _checkpointing{ false };
+	bool _ownsCheckpoint{ false };  // the checkpoint file was written by this read or resumed from
+	int  _checkpointInterval{ 0 };
 	int  _blocksPerCluster{ -1 };
 
     };	// class DirTree
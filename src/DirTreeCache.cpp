@@ -14,6 +14,7 @@
 #include "DirTree.h"
 #include "Exception.h"
 #include "FileInfoIterator.h"
+#include "HardLinkTable.h"
 #include "MountPoints.h"
 #include "SysUtil.h"
 
@@ -68,96 +69,99 @@ namespace
 
 
     /**
-     * Write 'item' to cache file 'cache' without recursion.
-     * Uses zlib to write gzip-compressed files.
+     * Return 'true' if 'item' is a directory that is still waiting to be
+     * read, or is being read, so its contents are not complete.
      **/
-    void writeItem( gzFile cache, const FileInfo * item )
+    bool isQueued( const FileInfo * item )
     {
-	if ( !item )
-	    return;
-
-	// Write file type
-	gzputs( cache, fileType( item ) );
-
-	// Write name with special characters percent-encoded
-	if ( item->isDirInfo() )
-	    // Store the full absolute path for directories, but don't encode the slashes for readability
-	    gzprintf( cache, " %-40s", QUrl::toPercentEncoding( item->url(), "/" ).constData() );
-	else
-	    // Otherwise store a relative path (just the filename)
-	    gzprintf( cache, "\t%-36s", QUrl::toPercentEncoding( item->name() ).constData() );
-
-	// Write size
-	gzprintf( cache, "\t%s", formatSize( item->rawByteSize() ).toUtf8().constData() );
-
-	// For uid, gid, and permissions (mode also identifies the object type)
-	gzprintf( cache, "\t%4d\t%4d\t%06o", item->uid(), item->gid(), item->mode() );
-
-	// Write mtime
-	gzprintf( cache, "\t0x%lx", (unsigned long)item->mtime() );
-
-	// Write allocated size (and dummy to maintain compatibility with earlier formats)
-	gzprintf( cache, "\t%s\t|", formatSize( item->rawAllocatedSize() ).toUtf8().constData() );
-
-	// Optional fields
-	if ( item->isExcluded() )
-	    gzputs( cache, "\tunread: excluded" );
-	else if ( item->readState() == DirNoAccess )
-	    gzputs( cache, "\tunread: noaccess" );
-	else if ( item->readState() == DirPermissionDenied )
-	    gzputs( cache, "\tunread: permissions" );
-	else if ( item->readState() == DirError )
-	    gzputs( cache, "\tunread: readerror" );
-	else if ( item->isMountPoint() && item->readState() == DirOnRequestOnly )
-	    gzputs( cache, "\tunread: mountpoint" );
-	if ( item->isSparseFile() )
-	    gzprintf( cache, "\tblocks: %lld", item->blocks() );
-	if ( item->isFile() && item->links() > 1 )
-	    gzprintf( cache, "\tlinks: %u", (unsigned)item->links() );
+	if ( !item->isDirInfo() || item->isPseudoDir() )
+	    return false;
 
-	// One item per line
-	gzputc( cache, '\n' );
+	return item->readState() == DirQueued || item->readState() == DirReading;
     }
 
 
     /**
-     * Write 'item' recursively to cache file 'cache'.
-     * Uses zlib to write gzip-compressed files.
+     * Return the reason written to a cache file for a directory that
+     * wasn't read, or nullptr if there is nothing to write.
      **/
-    void writeTree( gzFile cache, const FileInfo * item )
+    const char * unreadReason( const FileInfo * item )
     {
-	if ( !item )
-	    return;
-
-	// Write entry for this item
-	if ( !item->isDotEntry() )
-	    writeItem( cache, item );
-
-	// Write file children immediately following the parent entry
-	if ( item->dotEntry() )
-	    writeTree( cache, item->dotEntry() );
+	if ( item->isExcluded() )
+	    return "excluded";
+	if ( item->readState() == DirNoAccess )
+	    return "noaccess";
+	if ( item->readState() == DirPermissionDenied )
+	    return "permissions";
+	if ( item->readState() == DirError )
+	    return "readerror";
+	if ( item->isMountPoint() && item->readState() == DirOnRequestOnly )
+	    return "mountpoint";
+	if ( isQueued( item ) )
+	    return "queued";
 
-	// Recurse through subdirectories, but not the dot entry
-	for ( FileInfoIterator it{ item }; *it; ++it )
-	    writeTree( cache, *it );
+	return nullptr;
     }
 
 } // namespace
 
 
 
-void CacheReader::writeCache( const QString & fileName, const DirTree * tree )
+CacheSnapshot::CacheSnapshot( const DirTree * tree )
 {
     if ( !tree )
 	return;
 
     const FileInfo * firstToplevel = tree->firstToplevel();
-    if ( !firstToplevel || !firstToplevel->isDirInfo() )
+    if ( firstToplevel && firstToplevel->isDirInfo() )
+	addTree( firstToplevel );
+}
+
+
+void CacheSnapshot::addTree( const FileInfo * item )
+{
+    if ( !item )
 	return;
 
+    // Add an entry for this item
+    if ( !item->isDotEntry() )
+    {
+	Item entry;
+	entry.path          = item->isDirInfo() ? item->url() : item->name();
+	entry.type          = fileType( item );
+	entry.unread        = unreadReason( item );
+	entry.size          = item->rawByteSize();
+	entry.allocatedSize = item->rawAllocatedSize();
+	entry.blocks        = item->blocks();
+	entry.mtime         = item->mtime();
+	entry.uid           = item->uid();
+	entry.gid           = item->gid();
+	entry.mode          = item->mode();
+	entry.links         = item->isFile() ? item->links() : 1;
+	entry.isDirInfo     = item->isDirInfo();
+	entry.isSparseFile  = item->isSparseFile();
+	_items << entry;
+    }
+
+    // Leave out any partial contents, the directory will be read again
+    if ( isQueued( item ) )
+	return;
+
+    // Add file children immediately following the parent entry
+    if ( item->dotEntry() )
+	addTree( item->dotEntry() );
+
+    // Recurse through subdirectories, but not the dot entry
+    for ( FileInfoIterator it{ item }; *it; ++it )
+	addTree( *it );
+}
+
+
+const char * CacheSnapshot::write( const QString & fileName, const std::atomic<bool> * cancelled ) const
+{
     gzFile cache = gzopen( fileName.toUtf8().constData(), "w" );
     if ( cache == Z_NULL )
-	THROW( ( SysCallFailedException{ "gzopen", fileName } ) );
+	return "gzopen";
 
     gzprintf( cache,
              "[qdirstat %s cache file]\n"
@@ -166,10 +170,68 @@ void CacheReader::writeCache( const QString & fileName, const DirTree * tree )
              "# Type\tpath                              \tsize\tuid\tgid\tmode\tmtime\t\talloc\t\t<optional fields>\n"
              "\n",
              CACHE_FORMAT_VERSION );
-    writeTree( cache, firstToplevel );
+
+    for ( int i = 0; i < _items.size(); ++i )
+    {
+	// Checking every item would only slow writing down
+	if ( cancelled && i % 1024 == 0 && *cancelled )
+	    break;
+
+	const Item & item = _items.at( i );
+
+	// Write file type
+	gzputs( cache, item.type );
+
+	// Write name with special characters percent-encoded
+	if ( item.isDirInfo )
+	    // Store the full absolute path for directories, but don't encode the slashes for readability
+	    gzprintf( cache, " %-40s", QUrl::toPercentEncoding( item.path, "/" ).constData() );
+	else
+	    // Otherwise store a relative path (just the filename)
+	    gzprintf( cache, "\t%-36s", QUrl::toPercentEncoding( item.path ).constData() );
+
+	// Write size
+	gzprintf( cache, "\t%s", formatSize( item.size ).toUtf8().constData() );
+
+	// For uid, gid, and permissions (mode also identifies the object type)
+	gzprintf( cache, "\t%4d\t%4d\t%06o", item.uid, item.gid, item.mode );
+
+	// Write mtime
+	gzprintf( cache, "\t0x%lx", (unsigned long)item.mtime );
+
+	// Write allocated size (and dummy to maintain compatibility with earlier formats)
+	gzprintf( cache, "\t%s\t|", formatSize( item.allocatedSize ).toUtf8().constData() );
+
+	// Optional fields
+	if ( item.unread )
+	    gzprintf( cache, "\tunread: %s", item.unread );
+	if ( item.isSparseFile )
+	    gzprintf( cache, "\tblocks: %lld", item.blocks );
+	if ( item.links > 1 )
+	    gzprintf( cache, "\tlinks: %u", (unsigned)item.links );
+
+	// One item per line
+	gzputc( cache, '\n' );
+    }
 
     if ( gzclose( cache ) != Z_OK )
-	THROW( ( SysCallFailedException{ "gzclose", fileName } ) );
+	return "gzclose";
+
+    return nullptr;
+}
+
+
+
+
+void CacheReader::writeCache( const QString & fileName, const DirTree * tree )
+{
+    const CacheSnapshot snapshot{ tree };
+    if ( snapshot.isEmpty() )
+	return;
+
+    const char * failedCall = snapshot.write( fileName );
+    if ( failedCall )
+	THROW( ( SysCallFailedException{ failedCall, fileName } ) );
 }
 
 
@@ -309,6 +371,9 @@ namespace
 	    case 'm':
 		return DirOnRequestOnly;
 
+	    case 'q':
+		return DirQueued;
+
 	    default:
 		return DirError;
 	}
@@ -460,6 +525,8 @@ CacheReader::~CacheReader()
 	    // No way to know what is complete, so remove everything else
 	    _tree->clearSubtree( _toplevel );
 	}
+
+	_queuedDirs.clear();
     }
 
     if ( _cache )
@@ -475,6 +542,18 @@ CacheReader::~CacheReader()
 	DirInfo * toplevel = _parent ? _parent : _toplevel;
 	finalizeRecursive( toplevel, _tree );
 	toplevel->finalizeAll();
+
+	// Carry on reading the directories that were still queued when the cache file was written,
+	// applying the file child exclude rules as the interrupted read did below the top level
+	const FileInfo * treeToplevel = _tree->firstToplevel();
+	for ( DirInfo * dir : asConst( _queuedDirs ) )
+	{
+	    dir->setReadState( DirQueued );
+	    _tree->addDirToRead( dir, dir != treeToplevel );
+	}
+
+	if ( !_queuedDirs.isEmpty() )
+	    logInfo() << "Reading " << _queuedDirs.size() << " queued directories" << Qt::endl;
     }
 }
 
@@ -660,6 +739,11 @@ void CacheReader::addItem()
 	_latestDir = dir;
 	parent->insertChild( dir );
 
+	// Directories that were waiting to be read are read once the cache file is loaded
+	const bool queued = unread_str && tolower( *unread_str ) == 'q';
+	if ( queued )
+	    _queuedDirs << dir;
+
 	if ( !_toplevel )
 	{
 	    _toplevel = dir;
@@ -682,7 +766,7 @@ void CacheReader::addItem()
 
 	    // Don't try to exclude anything ourselves, just mark directories
 	    // that are flagged in the cache file.
-	    if ( unread_str )
+	    if ( unread_str && !queued )
 	    {
 		dir->readJobAdded(); // balances the pending read jobs count
 		dir->setReadState( mapReadState( dir, unread_str ) );
@@ -696,6 +780,11 @@ void CacheReader::addItem()
 	FileInfo * item = new FileInfo{ parent, _tree, name,
 	                                mode, size, alloc, hasUidGidPerm, uid, gid, mtime,
 	                                isSparseFile, blocks, static_cast<nlink_t>( links ) };
+
+	// There are no inode numbers in the cache to add hard links to the table with
+	if ( _tree->hardLinks() && item->isFile() && item->links() > 1 )
+	    _tree->hardLinks()->markIncomplete();
+
 	insertFileInfo( _tree, parent, item );
     }
     else
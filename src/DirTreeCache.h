@@ -10,11 +10,17 @@
 #ifndef DirTreeCache_h
 #define DirTreeCache_h
 
+#include <atomic>
+
+#include <sys/types.h> // uid_t, gid_t, mode_t, nlink_t
 #include <zlib.h>
 
 #include <QRegularExpression>
 #include <QStringBuilder>
 #include <QUrl>
+#include <QVector>
+
+#include "Typedefs.h" // FileSize
 
 
 #define CACHE_FORMAT_VERSION	"2.1"
@@ -80,7 +86,7 @@ namespace QDirStat
 
 	/**
 	 * Write cache file in gzip format.
-	 * Returns 'true' if OK, 'false' upon error.
+	 * Throws SysCallFailedException upon error.
 	 **/
 	static void writeCache( const QString & fileName, const DirTree * tree );
 
@@ -172,10 +178,79 @@ namespace QDirStat
 	DirInfo * _toplevel{ nullptr }; // the parent if there is one, otherwise the top level of the cache file
 	DirInfo * _latestDir{ nullptr }; // the latest drectory read from the cache file, parent to subsequent file children
 
+	QVector<DirInfo *> _queuedDirs; // directories still to be read, from a checkpoint
+
 	QRegularExpression _multiSlash{ "//+" };
 
     };	// CacheReader
 
+
+
+    /**
+     * A copy of the contents of a tree in the order they are written to a
+     * cache file.  Taking a snapshot is much quicker than writing the cache
+     * file, and the snapshot no longer refers to the tree, so it can be
+     * written in another thread while the tree keeps changing.  Copies
+     * share their data.
+     **/
+    class CacheSnapshot final
+    {
+    public:
+
+	/**
+	 * Constructor: copy the contents of 'tree' from its first top level
+	 * item down.  This must be called in the main thread.
+	 **/
+	CacheSnapshot( const DirTree * tree );
+
+	/**
+	 * Return 'true' if there is nothing to write.
+	 **/
+	bool isEmpty() const { return _items.isEmpty(); }
+
+	/**
+	 * Write the snapshot to cache file 'fileName' in gzip format.  This
+	 * doesn't log or throw anything, so it can be called in any thread.
+	 * Writing stops early, leaving an incomplete file, once 'cancelled'
+	 * is set.
+	 *
+	 * Returns the name of the system call that failed, or nullptr if OK.
+	 **/
+	const char * write( const QString & fileName,
+	                    const std::atomic<bool> * cancelled = nullptr ) const;
+
+
+    protected:
+
+	/**
+	 * Add 'item' and everything below it to the snapshot.
+	 **/
+	void addTree( const FileInfo * item );
+
+
+    private:
+
+	struct Item
+	{
+	    QString      path;      // the full URL for directories, otherwise just the name
+	    const char * type;
+	    const char * unread;    // the reason a directory wasn't read, or nullptr
+	    FileSize     size;
+	    FileSize     allocatedSize;
+	    FileSize     blocks;
+	    time_t       mtime;
+	    uid_t        uid;
+	    gid_t        gid;
+	    mode_t       mode;
+	    nlink_t      links;
+	    bool         isDirInfo;
+	    bool         isSparseFile;
+	};
+
+	QVector<Item> _items;
+
+    };	// CacheSnapshot
+
 }	// namespace QDirStat
 
 #endif	// ifndef DirTreeCache_h
@@ -446,6 +446,24 @@ namespace
     }
 
 
+    /**
+     * Return 'true' if 'dir' or any of its ancestors is locked, i.e. still
+     * waiting for its new children to be notified to the view.
+     **/
+    bool anyAncestorLocked( const DirInfo * dir )
+    {
+	while ( dir )
+	{
+	    if ( dir->isLocked() )
+		return true;
+
+	    dir = dir->parent();
+	}
+
+	return false;
+    }
+
+
     /**
      * Percent float value for direct communication with the PercentBarDelegate
      **/
@@ -513,7 +531,12 @@ void DirTreeModel::readSettings()
     _updateTimerMillisec      = settings.value( "UpdateTimerMillisec", 250  ).toInt();
     _slowUpdateMillisec       = settings.value( "SlowUpdateMillisec",  3000 ).toInt();
     const bool ignoreLinks    = settings.value( "IgnoreHardLinks",     _tree->ignoreHardLinks() ).toBool();
+    const bool exactLinks     = settings.value( "ExactHardLinks",      _tree->exactHardLinks() ).toBool();
     const bool trustNtfsLinks = settings.value( "TrustNtfsHardLinks",  _tree->trustNtfsHardLinks() ).toBool();
+    const bool useBulkStat    = settings.value( "UseBulkStat",         _tree->useBulkStat() ).toBool();
+    const int  readThreads    = settings.value( "ReadThreadsPerDevice", _tree->readThreadsPerDevice() ).toInt();
+    const bool depthFirst     = settings.value( "DepthFirstReading",   _tree->depthFirstReading() ).toBool();
+    const int  checkpoint     = settings.value( "CheckpointInterval",  _tree->checkpointInterval() ).toInt();
     _treeItemSize =
 	dirTreeItemSize( settings.value( "TreeIconDir", DirTreeModel::treeIconDir( DTIS_Small ) ).toString() );
     settings.endGroup();
@@ -530,7 +553,12 @@ void DirTreeModel::readSettings()
 
     _tree->setCrossFilesystems( _crossFilesystems );
     _tree->setIgnoreHardLinks( ignoreLinks );
+    _tree->setExactHardLinks( exactLinks );
     _tree->setTrustNtfsHardLinks( trustNtfsLinks );
+    _tree->setUseBulkStat( useBulkStat );
+    _tree->setReadThreadsPerDevice( readThreads );
+    _tree->setDepthFirstReading( depthFirst );
+    _tree->setCheckpointInterval( checkpoint );
 }
 
 
@@ -543,7 +571,12 @@ void DirTreeModel::writeSettings()
     settings.setValue( "CrossFilesystems",    _crossFilesystems           );
     settings.setValue( "UseBoldForDominant",  _useBoldForDominantItems    );
     settings.setValue( "IgnoreHardLinks",     _tree->ignoreHardLinks()    );
+    settings.setValue( "ExactHardLinks",      _tree->exactHardLinks()     );
     settings.setValue( "TrustNtfsHardLinks",  _tree->trustNtfsHardLinks() );
+    settings.setValue( "UseBulkStat",         _tree->useBulkStat()        );
+    settings.setValue( "ReadThreadsPerDevice", _tree->readThreadsPerDevice() );
+    settings.setValue( "DepthFirstReading",   _tree->depthFirstReading()  );
+    settings.setValue( "CheckpointInterval",  _tree->checkpointInterval() );
     settings.setValue( "TreeIconDir",         treeIconDir()               );
     settings.setValue( "UpdateTimerMillisec", _updateTimerMillisec        );
     settings.endGroup();
@@ -935,8 +968,44 @@ void DirTreeModel::readJobFinished( DirInfo * dir )
 {
     // logDebug() << dir << Qt::endl;
 
-    if ( !anyAncestorBusy( dir ) )
+    if ( anyAncestorBusy( dir ) || anyAncestorLocked( dir->parent() ) )
+	return;
+
+    // Outside of a tree read there is no timer tick to wait for
+    if ( !_updateTimer.isActive() )
+    {
 	newChildrenNotify( dir );
+	return;
+    }
+
+    // Keep the new children hidden from the view until the next update
+    // timer tick so that many finished read jobs cost only one notification
+    // each per tick instead of flooding the view with row insertions.
+    dir->lock();
+    _pendingDirs << dir;
+}
+
+
+void DirTreeModel::notifyPendingDirs()
+{
+    const QVector<DirInfo *> pendingDirs = _pendingDirs;
+    _pendingDirs.clear();
+
+    // Dirs inside another pending dir are covered by the recursion for that dir
+    QVector<DirInfo *> notifyDirs;
+    for ( DirInfo * dir : pendingDirs )
+    {
+	if ( anyAncestorLocked( dir->parent() ) )
+	    dir->unlock();
+	else
+	    notifyDirs << dir;
+    }
+
+    for ( DirInfo * dir : asConst( notifyDirs ) )
+    {
+	newChildrenNotify( dir );
+	dir->unlock(); // in case the dir was untouched and silently skipped
+    }
 }
 
 
@@ -980,6 +1049,8 @@ void DirTreeModel::newChildrenNotify( DirInfo * dir )
 
 void DirTreeModel::updateView()
 {
+    notifyPendingDirs();
+
     // logDebug() << "Rows changed" << Qt::endl;
     emit rowsChanged( createIndex( 0, 0, _tree->firstToplevel() ) );
 }
@@ -989,6 +1060,7 @@ void DirTreeModel::readingFinished()
 {
     // Stop updating the viewport
     _updateTimer.stop();
+    notifyPendingDirs();
 
     // Update the view in case it hasn't been fully painted and the sort isn't changing
     if ( _sortCol != ReadJobsCol )
@@ -1028,6 +1100,11 @@ void DirTreeModel::beginResetModel()
 {
     _updateTimer.stop();
 
+    // The view forgets everything anyway, so just drop any pending notifications
+    for ( DirInfo * dir : asConst( _pendingDirs ) )
+	dir->unlock();
+    _pendingDirs.clear();
+
     QAbstractItemModel::beginResetModel();
 }
 
@@ -1057,6 +1134,9 @@ void DirTreeModel::endRemoveRows()
 
 void DirTreeModel::deletingChildren( DirInfo * parent, const FileInfoSet & children )
 {
+    // Let the view catch up first so the removed rows are rows it knows about
+    notifyPendingDirs();
+
     const QModelIndex parentIndex = modelIndex( parent );
     int firstRow = rowCount( parentIndex );
 
@@ -1083,6 +1163,8 @@ void DirTreeModel::clearingSubtree( DirInfo * subtree )
 {
     //logDebug() << "Deleting all children of " << subtree << Qt::endl;
 
+    notifyPendingDirs();
+
     if ( subtree == _tree->root() || subtree->isTouched() )
     {
 	const int count = childCount( subtree );
@@ -17,6 +17,7 @@
 #include <QIcon>
 #include <QPalette>
 #include <QTimer>
+#include <QVector>
 
 #include "DataColumns.h"
 #include "Typedefs.h" // _L1
@@ -280,6 +281,10 @@ namespace QDirStat
 	/**
 	 * Process notification that the read job for 'dir' is finished.
 	 * Other read jobs might still be pending.
+	 *
+	 * While the update timer is running, the view is not notified
+	 * immediately: 'dir' is locked and queued until the next timer tick
+	 * (see notifyPendingDirs()).
 	 **/
 	void readJobFinished( DirInfo * dir );
 
@@ -291,7 +296,8 @@ namespace QDirStat
 
 	/**
 	 * Signal the view to update.  This is called from a timer whenever
-	 * there is an ongoing read.
+	 * there is an ongoing read.  Any dirs finished since the last tick
+	 * are notified to the view first.
 	 **/
 	void updateView();
 
@@ -373,6 +379,14 @@ namespace QDirStat
 	 **/
 	void newChildrenNotify( DirInfo * dir );
 
+	/**
+	 * Notify the view about the new children of all the dirs that
+	 * finished reading since the last call and unlock those dirs.
+	 * Dirs nested inside another pending dir are handled by the
+	 * recursion in newChildrenNotify().
+	 **/
+	void notifyPendingDirs();
+
 	/**
 	 * Update the persistent indexes with current row after sorting etc.
 	 **/
@@ -468,6 +482,8 @@ namespace QDirStat
 	bool            _slowUpdate{ false };
 	bool            _removingRows{ false };
 
+	QVector<DirInfo *> _pendingDirs;
+
 	// Colors and fonts
 	QColor _dirReadErrLightTheme;
 	QColor _subtreeReadErrLightTheme;
@@ -13,6 +13,7 @@
 
 #include "DirTreeView.h"
 #include "ActionManager.h"
+#include "DirTree.h"
 #include "DirTreeModel.h"
 #include "FileInfo.h"
 #include "FormatUtil.h"
@@ -62,6 +63,9 @@ DirTreeView::DirTreeView( QWidget * parent ):
 
     connect( this,                &QTreeView::customContextMenuRequested,
              this,                &DirTreeView::contextMenu );
+
+    connect( this,                &QTreeView::expanded,
+             this,                &DirTreeView::expandedBranch );
 }
 
 
@@ -185,6 +189,14 @@ void DirTreeView::contextMenu( const QPoint & pos )
 }
 
 
+void DirTreeView::expandedBranch( const QModelIndex & index )
+{
+    const DirTreeModel * model = dirTreeModel();
+    if ( model && index.isValid() )
+	model->tree()->prioritize( static_cast<FileInfo *>( index.internalPointer() ) );
+}
+
+
 const DirTreeModel * DirTreeView::dirTreeModel() const
 {
     if ( !model() )
@@ -117,6 +117,12 @@ namespace QDirStat
 	 **/
 	void contextMenu( const QPoint & pos );
 
+	/**
+	 * Notification that the branch 'index' was expanded: read it first
+	 * if it is still being read.
+	 **/
+	void expandedBranch( const QModelIndex & index );
+
 
     protected:
 
@@ -10,11 +10,11 @@
 #include <QString>
 
 #include "DiscoverActions.h"
-#include "BusyPopup.h"
 #include "DirInfo.h"
 #include "DirTree.h"
 #include "FileSearchFilter.h"
 #include "FormatUtil.h"
+#include "HardLinkTable.h"
 #include "LocateFilesWindow.h"
 #include "MainWindow.h"
 #include "QDirStatApp.h"
@@ -81,8 +81,10 @@ void DiscoverActions::discoverOldestFiles()
 
 void DiscoverActions::discoverHardLinkedFiles()
 {
+    // Keep the links to each inode together if they are grouped
+    const DirTree * tree = app()->dirTree();
     discoverFiles( new HardLinkedFilesTreeWalker{},
-                   LL_PathCol,
+                   tree && tree->hardLinks() && !tree->hardLinks()->isIncomplete() ? -1 : LL_PathCol,
                    Qt::AscendingOrder,
                    QObject::tr( "Files with multiple hard links in %1" ) );
 }
@@ -90,7 +92,6 @@ void DiscoverActions::discoverHardLinkedFiles()
 
 void DiscoverActions::discoverBrokenSymlinks()
 {
-    BusyPopup msg{ QObject::tr( "Checking symlinks..." ), app()->mainWindow() };
     discoverFiles( new BrokenSymlinksTreeWalker{},
                    LL_PathCol,
                    Qt::AscendingOrder,
@@ -129,7 +129,8 @@ void ExcludeRules::add( ExcludeRule::PatternSyntax   patternSyntax,
 
 bool ExcludeRules::match( const QString & fullPath, const QString & fileName ) const
 {
-    if ( fullPath.isEmpty() || fileName.isEmpty() )
+    // Rules using the full path don't match if it is empty
+    if ( fileName.isEmpty() )
 	return false;
 
     for ( const ExcludeRule * rule : *this )
@@ -147,6 +148,12 @@ bool ExcludeRules::match( const QString & fullPath, const QString & fileName ) c
 }
 
 
+bool ExcludeRules::useFullPath() const
+{
+    return std::any_of( cbegin(), cend(), []( const ExcludeRule * rule ) { return rule->useFullPath(); } );
+}
+
+
 bool ExcludeRules::matchDirectChildren( const DirInfo * dir ) const
 {
     if ( !dir )
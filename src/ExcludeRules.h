@@ -260,10 +260,18 @@ namespace QDirStat
 	 *
 	 * This will return 'true' if the text matches any rule.
 	 *
+	 * 'fullPath' may be empty if useFullPath() returns 'false'.
+	 *
 	 * Note that this operation will move current().
 	 **/
 	bool match( const QString & fullPath, const QString & fileName ) const;
 
+	/**
+	 * Return 'true' if any rule checks against the full path rather
+	 * than just the file name.
+	 **/
+	bool useFullPath() const;
+
 	/**
 	 * Check the direct non-directory children of 'dir' against any rules
 	 * that have the 'checkAnyFileChild' flag set.
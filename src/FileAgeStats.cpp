@@ -10,7 +10,9 @@
 #include <QDate>
 
 #include "FileAgeStats.h"
+#include "DirInfo.h"
 #include "FileInfoIterator.h"
+#include "StatsRunner.h"
 
 
 using namespace QDirStat;
@@ -19,39 +21,36 @@ using namespace QDirStat;
 namespace
 {
     /**
-     * Recurse through all file elements in the subtree 'dir' and calculate the
-     * stats for that subtree.
+     * Recurse through all file elements in the subtree 'dir' and add them
+     * to 'stats', merging the cached statistics of large subdirectories
+     * instead of visiting their files.
      **/
-    void collectRecursive( FileCount       & totalCount,
-                           FileSize        & totalSize,
-                           YearStatsHash   & yearStats,
-                           MonthStatsHash  & monthStats,
-                           const FileInfo  * dir )
+    void collectRecursive( FileAgeStats & stats, FileInfo * dir, StatsProgress * progress )
     {
+        if ( progress && !progress->visitDir() )
+            return;
+
         for ( DotEntryIterator it{ dir }; *it; ++it )
         {
-            const FileInfo * item = *it;
+            FileInfo * item = *it;
 
-            if ( item->hasChildren() )
+            if ( item->isDirInfo() )
             {
-                collectRecursive( totalCount, totalSize, yearStats, monthStats, item );
+                const FileAgeStats * ageStats = static_cast<DirInfo *>( item )->ageStats();
+                if ( ageStats )
+                {
+                    stats.merge( *ageStats );
+                    if ( progress )
+                        progress->addDirs( item->totalSubDirs() + 1 );
+                }
+                else
+                {
+                    collectRecursive( stats, item, progress );
+                }
             }
-            else if ( item->isFileOrSymlink() )
+            else
             {
-                ++totalCount;
-                totalSize += item->size();
-
-                const auto  yearAndMonth = item->yearAndMonth();
-                const short year         = yearAndMonth.year;
-                const short month        = yearAndMonth.month;
-
-                YearMonthStats & yearStat = yearStats[ year ];
-                ++yearStat.count;
-                yearStat.size += item->size();
-
-                YearMonthStats & monthStat = monthStats[ FileAgeStats::yearMonthHash( year, month ) ];
-                ++monthStat.count;
-                monthStat.size += item->size();
+                stats.add( item );
             }
         }
     }
@@ -59,10 +58,59 @@ namespace
 }
 
 
-FileAgeStats::FileAgeStats( const FileInfo * subtree ):
+FileAgeStats::FileAgeStats( FileInfo * subtree, StatsProgress * progress ):
+    FileAgeStats{}
+{
+    if ( subtree && subtree->checkMagicNumber() )
+        collectRecursive( *this, subtree, progress );
+}
+
+
+FileAgeStats::FileAgeStats():
     _thisYear{ static_cast<short>( QDate::currentDate().year() ) },
     _thisMonth{ static_cast<short>( QDate::currentDate().month() ) }
 {
-    if ( subtree && subtree->checkMagicNumber() )
-        collectRecursive( _totalCount, _totalSize, _yearStats, _monthStats, subtree );
+}
+
+
+void FileAgeStats::add( const FileInfo * item )
+{
+    if ( !item->isFileOrSymlink() )
+        return;
+
+    ++_totalCount;
+    _totalSize += item->size();
+
+    const auto  yearAndMonth = item->yearAndMonth();
+    const short year         = yearAndMonth.year;
+    const short month        = yearAndMonth.month;
+
+    YearMonthStats & yearStat = _yearStats[ year ];
+    ++yearStat.count;
+    yearStat.size += item->size();
+
+    YearMonthStats & monthStat = _monthStats[ yearMonthHash( year, month ) ];
+    ++monthStat.count;
+    monthStat.size += item->size();
+}
+
+
+void FileAgeStats::merge( const FileAgeStats & other )
+{
+    _totalCount += other._totalCount;
+    _totalSize  += other._totalSize;
+
+    for ( auto it = other._yearStats.cbegin(); it != other._yearStats.cend(); ++it )
+    {
+        YearMonthStats & yearStat = _yearStats[ it.key() ];
+        yearStat.count += it.value().count;
+        yearStat.size  += it.value().size;
+    }
+
+    for ( auto it = other._monthStats.cbegin(); it != other._monthStats.cend(); ++it )
+    {
+        YearMonthStats & monthStat = _monthStats[ it.key() ];
+        monthStat.count += it.value().count;
+        monthStat.size  += it.value().size;
+    }
 }
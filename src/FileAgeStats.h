@@ -18,6 +18,7 @@
 namespace QDirStat
 {
     class FileInfo;
+    class StatsProgress;
 
     /**
      * File count and size statistics for one year or one month.
@@ -40,15 +41,38 @@ namespace QDirStat
     /**
      * Class for calculating and storing file age statistics, i.e. statistics
      * about the years of the last modification times of files in a subtree.
+     *
+     * Statistics can be merged, so large directories keep their own
+     * statistics up to date (see DirInfo::ageStats()) and the statistics
+     * for a subtree are mostly put together from those.
      **/
     class FileAgeStats final
     {
     public:
 
         /**
-         * Constructor.  Collects data for the given subtree.
+         * Constructor.  Collects data for the given subtree, merging the
+         * cached statistics of any large subdirectories.  If 'progress' is
+         * not null, the collection reports to it and stops early if it is
+         * cancelled.
+         **/
+        FileAgeStats( FileInfo * subtree, StatsProgress * progress = nullptr );
+
+        /**
+         * Constructor for empty statistics.
+         **/
+        FileAgeStats();
+
+        /**
+         * Add 'item' to the statistics if it is a file or symlink.
+         * Other items are ignored.
+         **/
+        void add( const FileInfo * item );
+
+        /**
+         * Add all the statistics from 'other'.
          **/
-        FileAgeStats( const FileInfo * subtree );
+        void merge( const FileAgeStats & other );
 
         /**
          * Return an unsorted list of the years where files with that
@@ -133,10 +133,8 @@ namespace
      * including "gaps", empty months and years newer than the oldest
      * year.
      **/
-    void populateTree( FileInfo * fileInfo, QTreeWidget * treeWidget, short yearsWithMonths )
+    void populateTree( const FileAgeStats & stats, QTreeWidget * treeWidget, short yearsWithMonths )
     {
-	const FileAgeStats stats{ fileInfo };
-
 	/**
 	 * Create a YearListItem and all its children for 'year'.
 	 **/
@@ -238,6 +236,18 @@ FileAgeStatsWindow::FileAgeStatsWindow( QWidget * parent ):
     connect( _ui->treeWidget,    &QTreeWidget::currentItemChanged,
              this,               &FileAgeStatsWindow::enableActions );
 
+    connect( &_statsRunner,      &StatsRunner::started,
+             this,               &FileAgeStatsWindow::collectionStarted );
+
+    connect( &_statsRunner,      &StatsRunner::progress,
+             this,               &FileAgeStatsWindow::showProgress );
+
+    connect( &_statsRunner,      &StatsRunner::finished,
+             this,               &FileAgeStatsWindow::collectionEnded );
+
+    connect( &_statsRunner,      &StatsRunner::aborted,
+             this,               &FileAgeStatsWindow::collectionEnded );
+
     show();
 }
 
@@ -290,21 +300,57 @@ void FileAgeStatsWindow::populate( FileInfo * fileInfo )
 {
     //logDebug() << "populating with " << fileInfo << Qt::endl;
 
+    if ( !fileInfo )
+    {
+	_statsRunner.cancel();
+	_ui->treeWidget->clear();
+	return;
+    }
+
+    _subtree = fileInfo;
+
+    _ui->headingLabel->setStatusTip( tr( "File age statistics for " ) % replaceCrLf( _subtree.url() ) );
+    showElidedLabel( _ui->headingLabel, this );
+
+    _statsRunner.start( fileInfo,
+                        [ fileInfo ]( StatsProgress & progress )
+                            { return new FileAgeStats{ fileInfo, &progress }; },
+                        [ this ]( std::unique_ptr<FileAgeStats> stats )
+                            { showStats( *stats ); } );
+}
+
+
+void FileAgeStatsWindow::showStats( const FileAgeStats & stats )
+{
     _ui->treeWidget->clear();
 
     const int newHeight = app()->dirTreeModel()->dirTreeIconSize().height();
     PercentBarDelegate::delegateForColumn( _ui->treeWidget, YL_CountPercentBarCol )->setHeight( newHeight );
     PercentBarDelegate::delegateForColumn( _ui->treeWidget, YL_SizePercentBarCol  )->setHeight( newHeight );
 
-    if ( !fileInfo )
-	return;
+    populateTree( stats, _ui->treeWidget, yearsWithMonths() );
+}
 
-    _subtree = fileInfo;
 
-    _ui->headingLabel->setStatusTip( tr( "File age statistics for " ) % replaceCrLf( _subtree.url() ) );
-    showElidedLabel( _ui->headingLabel, this );
+void FileAgeStatsWindow::collectionStarted()
+{
+    _ui->treeWidget->setEnabled( false );
+    _ui->locateButton->setEnabled( false );
+}
 
-    populateTree(_subtree(), _ui->treeWidget, yearsWithMonths() );
+
+void FileAgeStatsWindow::showProgress( int percent )
+{
+    _ui->headingLabel->setText( tr( "Collecting file age statistics... %1%" ).arg( percent ) );
+}
+
+
+void FileAgeStatsWindow::collectionEnded()
+{
+    _ui->treeWidget->setEnabled( true );
+    enableActions();
+
+    showElidedLabel( _ui->headingLabel, this );
 }
 
 
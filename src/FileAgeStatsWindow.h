@@ -16,12 +16,14 @@
 #include <QTreeWidgetItem>
 
 #include "ui_file-age-stats-window.h"
+#include "StatsRunner.h"
 #include "Subtree.h"
 #include "Typedefs.h" // FileCount, FileSize
 
 
 namespace QDirStat
 {
+    class FileAgeStats;
     class YearListItem;
 
     /**
@@ -101,14 +103,37 @@ namespace QDirStat
 	 **/
 	void enableActions();
 
+	/**
+	 * Disable the tree while new statistics are being collected.
+	 **/
+	void collectionStarted();
+
+	/**
+	 * Show the progress of collecting the statistics in the heading.
+	 **/
+	void showProgress( int percent );
+
+	/**
+	 * Restore the heading and enable the tree again once the
+	 * statistics are collected or the collection is cancelled.
+	 **/
+	void collectionEnded();
+
 
     protected:
 
 	/**
-	 * Populate the window.
+	 * Populate the window.  The statistics are collected in a worker
+	 * thread and the tree keeps showing the old statistics until the
+	 * new ones are ready.
 	 **/
 	void populate( FileInfo * fileInfo );
 
+	/**
+	 * Replace the contents of the tree with 'stats'.
+	 **/
+	void showStats( const FileAgeStats & stats );
+
 	/**
 	 * Key press event for detecting enter/return.
 	 *
@@ -132,7 +157,8 @@ namespace QDirStat
 
 	std::unique_ptr<Ui::FileAgeStatsWindow> _ui;
 
-	Subtree _subtree;
+	Subtree     _subtree;
+	StatsRunner _statsRunner;
 
     };	// class FileAgeStatsWindow
 
@@ -7,7 +7,7 @@
  *              Ian Nartowicz
  */
 
-#include <ctime> // gmtime()
+#include <time.h> // gmtime_r()
 
 #include "FileInfo.h"
 #include "Attic.h"
@@ -60,6 +60,20 @@ namespace
 	return parentSize == 0 ? 0.0f : 100.0 * size / parentSize;
     }
 
+
+    /**
+     * Returns the UTC year and month of 'time'.  This uses gmtime_r()
+     * because it may be called from several threads at once.
+     **/
+    YearAndMonth utcYearAndMonth( time_t time )
+    {
+	struct tm tm;
+	if ( !gmtime_r( &time, &tm ) )
+	    return { 0, 0 };
+
+	return { static_cast<short>( tm.tm_year + 1900 ), static_cast<short>( tm.tm_mon + 1 ) };
+    }
+
 } // namespace
 
 
@@ -73,6 +87,8 @@ FileInfo::FileInfo( DirInfo           * parent,
     _isLocalFile{ true },
     _isIgnored{ false },
     _hasUidGidPerm{ true },
+    _inLinkTable{ false },
+    _isCountedLink{ false },
     _device{ statInfo.st_dev },
     _mode{ statInfo.st_mode },
     _links{ statInfo.st_nlink },
@@ -137,7 +153,7 @@ FileSize FileInfo::size() const
     const FileSize size = _isSparseFile ? _allocatedSize : _size;
 
     if ( _links > 1 && !_tree->ignoreHardLinks() && isFile() )
-	return size / _links; // integer division!
+	return linkShare( size );
 
     return size;
 }
@@ -148,12 +164,22 @@ FileSize FileInfo::allocatedSize() const
     const FileSize size = _allocatedSize;
 
     if ( _links > 1 && !_tree->ignoreHardLinks() && isFile() )
-	return size / _links; // integer division!
+	return linkShare( size );
 
     return size;
 }
 
 
+FileSize FileInfo::linkShare( FileSize size ) const
+{
+    // Links in the hard link table count the whole inode exactly once
+    if ( _inLinkTable )
+	return _isCountedLink ? size : 0;
+
+    return size / _links; // integer division!
+}
+
+
 QString FileInfo::url() const
 {
     if ( !_parent )
@@ -374,14 +400,7 @@ YearAndMonth FileInfo::yearAndMonth() const
     if ( isPseudoDir() || isPkgInfo() )
 	return { 0, 0 };
 
-    // Using gmtime() which is standard C/C++
-    // unlike gmtime_r() which is not
-    const struct tm * mtime_tm = gmtime( &_mtime );
-
-    const short year  = mtime_tm->tm_year + 1900; // works up to year 34668
-    const short month = mtime_tm->tm_mon  + 1;
-
-    return { year, month };
+    return utcYearAndMonth( _mtime );
 }
 
 
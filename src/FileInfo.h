@@ -104,6 +104,8 @@ namespace QDirStat
 	    _isSparseFile{ isSparseFile },
 	    _isIgnored{ false },
 	    _hasUidGidPerm{ withUidGidPerm },
+	    _inLinkTable{ false },
+	    _isCountedLink{ false },
 	    _device{ 0 },
 	    _mode{ mode },
 	    _links{ links },
@@ -901,6 +903,35 @@ namespace QDirStat
 	 **/
 	void setIgnored( bool ignored ) { _isIgnored = ignored; }
 
+	/**
+	 * Mark this file as a hard link in the tree's HardLinkTable: either
+	 * the link that is counted with the full size of the inode, or one
+	 * that counts as zero bytes.  Files that are not in the table divide
+	 * their size by the number of links.
+	 *
+	 * Please note that size() and allocatedSize() take this into account.
+	 **/
+	void setCountedLink( bool counted )
+	    { _inLinkTable = true; _isCountedLink = counted; }
+
+	/**
+	 * Return 'true' if this file is the link of its inode that is counted
+	 * with the full size by the tree's HardLinkTable.
+	 **/
+	bool isCountedLink() const { return _inLinkTable && _isCountedLink; }
+
+	/**
+	 * Return the index of the MimeCategorizer category of this item, or
+	 * 0 if it hasn't been categorised yet.  The index is stored when the
+	 * parent directory is finalized; see MimeCategorizer::categoryIndex().
+	 **/
+	quint8 categoryIndex() const { return _categoryIndex; }
+
+	/**
+	 * Set the MimeCategorizer category index.
+	 **/
+	void setCategoryIndex( quint8 index ) { _categoryIndex = index; }
+
 	/**
 	 * Return the nearest PkgInfo parent or 0 if there is none.
 	 **/
@@ -992,6 +1023,16 @@ namespace QDirStat
 	    { return isFile() && blocks() > 1 && size() < 2 * STD_BLOCK_SIZE; }
 
 
+    protected:
+
+	/**
+	 * Return the part of 'size' counted for this hard link: all or
+	 * nothing if it is in the tree's HardLinkTable, otherwise an equal
+	 * share for each link.
+	 **/
+	FileSize linkShare( FileSize size ) const;
+
+
     private:
 
 	// Keep this short in order to use as little memory as possible -
@@ -1009,6 +1050,9 @@ namespace QDirStat
 	bool       _isSparseFile  :1;	// flag: sparse file (file with "holes")?
 	bool       _isIgnored     :1;	// flag: ignored by rule?
 	bool       _hasUidGidPerm :1;	// flag: was this constructed with uid/guid/ and permissions
+	bool       _inLinkTable   :1;	// flag: hard link counted by the tree's HardLinkTable?
+	bool       _isCountedLink :1;	// flag: the link of its inode that carries the size?
+	quint8     _categoryIndex{ 0 };	// MimeCategorizer category, fits in the padding before _device
 	dev_t      _device;		// device this object resides on
 	mode_t     _mode;		// file permissions + object type
 	nlink_t    _links;		// number of links
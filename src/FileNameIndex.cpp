@@ -0,0 +1,394 @@
+/*
+ *   File name: FileNameIndex.cpp
+ *   Summary:   Index of file names for fast searching in QDirStat
+ *   License:   GPL V2 - See file LICENSE for details.
+ *
+ *   Authors:   Stefan Hundhammer <Stefan.Hundhammer@gmx.de>
+ *              Ian Nartowicz
+ */
+
+#include <algorithm> // lower_bound(), sort(), unique()
+#include <numeric>   // iota()
+
+#include "FileNameIndex.h"
+#include "FileInfo.h"
+#include "FileInfoIterator.h"
+#include "FileSearchFilter.h"
+#include "ParallelUtil.h"
+
+
+// Number of characters in each indexed character sequence
+#define TRIGRAM_LENGTH  3
+
+
+using namespace QDirStat;
+
+
+namespace
+{
+    /**
+     * Return the three UTF-16 characters starting at 'str' packed into a
+     * single number.
+     **/
+    quint64 trigramKey( const QChar * str )
+    {
+	return ( quint64( str[ 0 ].unicode() ) << 32 ) |
+	       ( quint64( str[ 1 ].unicode() ) << 16 ) |
+	         quint64( str[ 2 ].unicode() );
+    }
+
+
+    /**
+     * Append every trigram in 'str' to 'trigrams'.
+     **/
+    void addTrigrams( const QString & str, QVector<quint64> & trigrams )
+    {
+	for ( int i = 0; i + TRIGRAM_LENGTH <= str.size(); ++i )
+	    trigrams << trigramKey( str.constData() + i );
+    }
+
+
+    /**
+     * Sort 'trigrams' and remove any duplicates.
+     **/
+    void sortUnique( QVector<quint64> & trigrams )
+    {
+	std::sort( trigrams.begin(), trigrams.end() );
+	trigrams.erase( std::unique( trigrams.begin(), trigrams.end() ), trigrams.end() );
+    }
+
+
+    /**
+     * Return the runs of literal characters in a wildcard pattern, ie.
+     * everything except wildcards, bracket expressions, and escapes.
+     * Every name matching the pattern must contain all of them.
+     **/
+    QStringList wildcardLiterals( const QString & pattern )
+    {
+	QStringList literals;
+	QString literal;
+
+	for ( int i = 0; i < pattern.size(); ++i )
+	{
+	    const QChar c = pattern.at( i );
+	    if ( c == u'*' || c == u'?' || c == u'\\' || c == u'[' )
+	    {
+		if ( !literal.isEmpty() )
+		    literals << literal;
+		literal.clear();
+
+		// Skip the whole of a bracket expression
+		if ( c == u'[' )
+		{
+		    const int end = pattern.indexOf( u']', i + 2 );
+		    i = end < 0 ? pattern.size() : end;
+		}
+	    }
+	    else
+	    {
+		literal += c;
+	    }
+	}
+
+	if ( !literal.isEmpty() )
+	    literals << literal;
+
+	return literals;
+    }
+
+
+    /**
+     * Return 'true' if 'item' is one of the node types 'filter' is looking
+     * for, is below 'subtree', and has a name matching the pattern.
+     **/
+    bool matchesItem( const FileSearchFilter & filter, const FileInfo * subtree, const FileInfo * item )
+    {
+	if ( ( !filter.findDirs()     || !item->isDir()     ) &&
+	     ( !filter.findFiles()    || !item->isFile()    ) &&
+	     ( !filter.findSymlinks() || !item->isSymlink() ) &&
+	     ( !filter.findPkgs()     || !item->isPkgInfo() ) )
+	{
+	    return false;
+	}
+
+	if ( item == subtree || !item->isInSubtree( subtree ) )
+	    return false;
+
+	return filter.matches( item->name() );
+    }
+
+} // namespace
+
+
+FileNameIndex::FileNameIndex( FileInfo * root )
+{
+    QHash<QString, int> nameIds;
+    QVector<FileInfo *> items;
+    QVector<int> itemNames;
+    if ( root )
+	addNames( root, nameIds, items, itemNames );
+
+    // Count the items with each name and convert the counts to offsets
+    _nameStart.fill( 0, _names.size() + 1 );
+    for ( int nameId : asConst( itemNames ) )
+	++_nameStart[ nameId + 1 ];
+    for ( int i = 1; i < _nameStart.size(); ++i )
+	_nameStart[ i ] += _nameStart[ i - 1 ];
+
+    // Pack the items grouped by name, using a running offset for each name
+    QVector<int> fill{ _nameStart };
+    _items.resize( items.size() );
+    for ( int i = 0; i < items.size(); ++i )
+	_items[ fill[ itemNames.at( i ) ]++ ] = items.at( i );
+
+    _sortedNames.resize( _names.size() );
+    std::iota( _sortedNames.begin(), _sortedNames.end(), 0 );
+    std::sort( _sortedNames.begin(), _sortedNames.end(), [ this ]( int id1, int id2 )
+	{ return _names.at( id1 ) < _names.at( id2 ); } );
+
+    buildTrigrams();
+}
+
+
+void FileNameIndex::addNames( FileInfo            * dir,
+			      QHash<QString, int> & nameIds,
+			      QVector<FileInfo *> & items,
+			      QVector<int>        & itemNames )
+{
+    for ( DotEntryIterator it{ dir }; *it; ++it )
+    {
+	const QString name = it->name().toCaseFolded();
+	auto nameId = nameIds.constFind( name );
+	if ( nameId == nameIds.cend() )
+	{
+	    nameId = nameIds.insert( name, _names.size() );
+	    _names << name;
+	}
+
+	items << *it;
+	itemNames << nameId.value();
+
+	if ( it->hasChildren() )
+	    addNames( *it, nameIds, items, itemNames );
+    }
+}
+
+
+void FileNameIndex::buildTrigrams()
+{
+    // First pass: count the names containing each trigram
+    QHash<quint64, int> counts;
+    QVector<quint64> nameTrigrams;
+    for ( const QString & name : asConst( _names ) )
+    {
+	nameTrigrams.clear();
+	addTrigrams( name, nameTrigrams );
+	sortUnique( nameTrigrams );
+	for ( quint64 trigram : asConst( nameTrigrams ) )
+	    ++counts[ trigram ];
+    }
+
+    _trigrams.reserve( counts.size() );
+    for ( auto it = counts.cbegin(); it != counts.cend(); ++it )
+	_trigrams << it.key();
+    std::sort( _trigrams.begin(), _trigrams.end() );
+
+    // Convert the counts to offsets, keeping a running offset for each trigram in the hash
+    _trigramStart.fill( 0, _trigrams.size() + 1 );
+    for ( int i = 0; i < _trigrams.size(); ++i )
+    {
+	int & count = counts[ _trigrams.at( i ) ];
+	_trigramStart[ i + 1 ] = _trigramStart.at( i ) + count;
+	count = _trigramStart.at( i );
+    }
+
+    // Second pass: fill the lists, in name id order so that each list is sorted
+    _trigramNames.resize( _trigramStart.last() );
+    for ( int nameId = 0; nameId < _names.size(); ++nameId )
+    {
+	nameTrigrams.clear();
+	addTrigrams( _names.at( nameId ), nameTrigrams );
+	sortUnique( nameTrigrams );
+	for ( quint64 trigram : asConst( nameTrigrams ) )
+	    _trigramNames[ counts[ trigram ]++ ] = nameId;
+    }
+}
+
+
+QVector<FileInfo *> FileNameIndex::find( const FileSearchFilter & filter,
+					 const FileInfo         * subtree,
+					 int                      maxResults,
+					 bool                   & overflow ) const
+{
+    overflow = false;
+
+    QVector<FileInfo *> results;
+    if ( !subtree )
+	return results;
+
+    QVector<int> nameIds;
+    if ( !candidates( filter, nameIds ) )
+	return scan( filter, subtree, maxResults, overflow );
+
+    for ( int nameId : asConst( nameIds ) )
+    {
+	for ( int i = _nameStart.at( nameId ); i < _nameStart.at( nameId + 1 ); ++i )
+	{
+	    FileInfo * item = _items.at( i );
+	    if ( !matchesItem( filter, subtree, item ) )
+		continue;
+
+	    if ( results.size() >= maxResults )
+	    {
+		overflow = true;
+		return results;
+	    }
+
+	    results << item;
+	}
+    }
+
+    return results;
+}
+
+
+bool FileNameIndex::candidates( const FileSearchFilter & filter, QVector<int> & nameIds ) const
+{
+    // Case folding preserves substrings, so the folded name of any match contains the folded pattern
+    const QString pattern = filter.pattern().toCaseFolded();
+    QVector<quint64> trigrams;
+
+    switch ( filter.filterMode() )
+    {
+	case SearchFilter::StartsWith:
+	    nameIds = prefixCandidates( pattern, false );
+	    return true;
+
+	case SearchFilter::ExactMatch:
+	    nameIds = prefixCandidates( pattern, true );
+	    return true;
+
+	case SearchFilter::Contains:
+	    addTrigrams( pattern, trigrams );
+	    break;
+
+	case SearchFilter::WildcardMode:
+	{
+	    const QStringList literals = wildcardLiterals( pattern );
+	    for ( const QString & literal : literals )
+		addTrigrams( literal, trigrams );
+	    break;
+	}
+
+	default:
+	    // Regular expressions and "select all" have to check everything
+	    return false;
+    }
+
+    if ( trigrams.isEmpty() )
+	return false;
+
+    sortUnique( trigrams );
+    nameIds = trigramCandidates( trigrams );
+
+    return true;
+}
+
+
+QVector<int> FileNameIndex::trigramCandidates( const QVector<quint64> & trigrams ) const
+{
+    // Find the list of names for each trigram, giving up if any of them isn't there at all
+    QVector<QPair<int, int>> lists;
+    for ( quint64 trigram : trigrams )
+    {
+	const auto it = std::lower_bound( _trigrams.cbegin(), _trigrams.cend(), trigram );
+	if ( it == _trigrams.cend() || *it != trigram )
+	    return QVector<int>{};
+
+	const int i = it - _trigrams.cbegin();
+	lists << qMakePair( _trigramStart.at( i ), _trigramStart.at( i + 1 ) );
+    }
+
+    // Start with the shortest list and keep only the names that are in all the others
+    std::sort( lists.begin(), lists.end(), []( const QPair<int, int> & list1, const QPair<int, int> & list2 )
+	{ return list1.second - list1.first < list2.second - list2.first; } );
+
+    const auto listBegin = [ this ]( const QPair<int, int> & list ) { return _trigramNames.cbegin() + list.first;  };
+    const auto listEnd   = [ this ]( const QPair<int, int> & list ) { return _trigramNames.cbegin() + list.second; };
+
+    QVector<int> nameIds{ listBegin( lists.first() ), listEnd( lists.first() ) };
+    for ( int i = 1; i < lists.size() && !nameIds.isEmpty(); ++i )
+    {
+	const auto begin = listBegin( lists.at( i ) );
+	const auto end   = listEnd  ( lists.at( i ) );
+	const auto isMissing = [ begin, end ]( int nameId ) { return !std::binary_search( begin, end, nameId ); };
+	nameIds.erase( std::remove_if( nameIds.begin(), nameIds.end(), isMissing ), nameIds.end() );
+    }
+
+    return nameIds;
+}
+
+
+QVector<int> FileNameIndex::prefixCandidates( const QString & prefix, bool exact ) const
+{
+    const auto lessThan = [ this ]( int nameId, const QString & str ) { return _names.at( nameId ) < str; };
+
+    QVector<int> nameIds;
+    for ( auto it = std::lower_bound( _sortedNames.cbegin(), _sortedNames.cend(), prefix, lessThan );
+	  it != _sortedNames.cend(); ++it )
+    {
+	const QString & name = _names.at( *it );
+	if ( exact ? name != prefix : !name.startsWith( prefix ) )
+	    break;
+
+	nameIds << *it;
+    }
+
+    std::sort( nameIds.begin(), nameIds.end() );
+
+    return nameIds;
+}
+
+
+QVector<FileInfo *> FileNameIndex::scan( const FileSearchFilter & filter,
+					 const FileInfo         * subtree,
+					 int                      maxResults,
+					 bool                   & overflow ) const
+{
+    const int size   = _items.size();
+    const int chunks = qBound( 1, size, ParallelUtil::threadCount() );
+
+    // Each chunk stops as soon as it has more results than could be used
+    QVector<QVector<FileInfo *>> chunkMatches( chunks );
+    QVector<FileInfo *> * matchLists = chunkMatches.data();
+    ParallelUtil::runParts( chunks, [ this, &filter, subtree, maxResults, size, chunks, matchLists ]( int chunk )
+    {
+	const int start = static_cast<int>( 1LL * size * chunk / chunks );
+	const int end   = static_cast<int>( 1LL * size * ( chunk + 1 ) / chunks );
+
+	QVector<FileInfo *> & matches = matchLists[ chunk ];
+	for ( int i = start; i < end && matches.size() <= maxResults; ++i )
+	{
+	    if ( matchesItem( filter, subtree, _items.at( i ) ) )
+		matches << _items.at( i );
+	}
+    } );
+
+    // Combine the chunks in order
+    QVector<FileInfo *> results;
+    for ( const QVector<FileInfo *> & matches : asConst( chunkMatches ) )
+    {
+	for ( FileInfo * item : matches )
+	{
+	    if ( results.size() >= maxResults )
+	    {
+		overflow = true;
+		return results;
+	    }
+
+	    results << item;
+	}
+    }
+
+    return results;
+}
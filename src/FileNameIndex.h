@@ -0,0 +1,137 @@
+/*
+ *   File name: FileNameIndex.h
+ *   Summary:   Index of file names for fast searching in QDirStat
+ *   License:   GPL V2 - See file LICENSE for details.
+ *
+ *   Authors:   Stefan Hundhammer <Stefan.Hundhammer@gmx.de>
+ *              Ian Nartowicz
+ */
+
+#ifndef FileNameIndex_h
+#define FileNameIndex_h
+
+#include <QHash>
+#include <QString>
+#include <QVector>
+
+
+namespace QDirStat
+{
+    class FileInfo;
+    class FileSearchFilter;
+
+    /**
+     * Read-only index of the names of all the items in a completed tree,
+     * so that the "Find Files" dialog can find matching items without
+     * walking the whole tree and checking every name.
+     *
+     * Names are interned: each distinct case-folded name is stored once,
+     * with a packed array of the items that have that name.  There are
+     * usually far fewer distinct names than items.  On top of that there
+     * are two lookup structures:
+     *
+     * - the distinct names in sorted order, for StartsWith and ExactMatch
+     *   searches by binary search;
+     *
+     * - a trigram index mapping every sequence of three characters to the
+     *   names containing it, for Contains and Wildcard searches.  The
+     *   candidate names are the intersection of the lists for all the
+     *   trigrams in the pattern (or in the literal parts of a wildcard).
+     *
+     * Candidates are always checked against the filter itself, so the
+     * index only has to avoid missing any matches.  Regular expressions,
+     * and patterns too short to have any trigrams, are matched by a
+     * parallel scan of the packed item array instead.
+     *
+     * The index holds plain pointers to the tree items and must be
+     * discarded as soon as the tree changes.  See DirTree::nameIndex().
+     **/
+    class FileNameIndex final
+    {
+    public:
+
+	/**
+	 * Constructor: index all the items below 'root', including dot
+	 * entries but not attics.
+	 **/
+	FileNameIndex( FileInfo * root );
+
+	/**
+	 * Return the items below 'subtree' matching 'filter', up to
+	 * 'maxResults' of them.  'overflow' is set if there were more.
+	 **/
+	QVector<FileInfo *> find( const FileSearchFilter & filter,
+				  const FileInfo         * subtree,
+				  int                      maxResults,
+				  bool                   & overflow ) const;
+
+	/**
+	 * Return the number of items in the index.
+	 **/
+	int itemCount() const { return _items.size(); }
+
+	/**
+	 * Return the number of distinct (case-folded) names in the index.
+	 **/
+	int nameCount() const { return _names.size(); }
+
+
+    protected:
+
+	/**
+	 * Recursively add the items below 'dir' to the name table and the
+	 * list of all items with the name id of each of them.
+	 **/
+	void addNames( FileInfo            * dir,
+		       QHash<QString, int> & nameIds,
+		       QVector<FileInfo *> & items,
+		       QVector<int>        & itemNames );
+
+	/**
+	 * Build the trigram index from the name table.
+	 **/
+	void buildTrigrams();
+
+	/**
+	 * Return the ids of the names which might match 'filter', in
+	 * ascending order.  Returns 'false' if the index can't narrow down
+	 * the candidates and the items must be scanned.
+	 **/
+	bool candidates( const FileSearchFilter & filter, QVector<int> & nameIds ) const;
+
+	/**
+	 * Return the ids of the names containing all of 'trigrams'.
+	 **/
+	QVector<int> trigramCandidates( const QVector<quint64> & trigrams ) const;
+
+	/**
+	 * Return the ids of the names starting with 'prefix', or equal to
+	 * it if 'exact' is set.
+	 **/
+	QVector<int> prefixCandidates( const QString & prefix, bool exact ) const;
+
+	/**
+	 * Check every item against 'filter' using all the available threads.
+	 **/
+	QVector<FileInfo *> scan( const FileSearchFilter & filter,
+				  const FileInfo         * subtree,
+				  int                      maxResults,
+				  bool                   & overflow ) const;
+
+
+    private:
+
+	QVector<QString>    _names;		// distinct case-folded names
+	QVector<int>        _sortedNames;	// name ids in name order
+	QVector<int>        _nameStart;		// offsets into _items for each name id
+	QVector<FileInfo *> _items;		// all the items, grouped by name
+
+	QVector<quint64>    _trigrams;		// sorted distinct trigrams
+	QVector<int>        _trigramStart;	// offsets into _trigramNames for each trigram
+	QVector<int>        _trigramNames;	// name ids, ascending for each trigram
+
+    };	// class FileNameIndex
+
+}	// namespace QDirStat
+
+#endif	// ifndef FileNameIndex_h
@@ -8,51 +8,94 @@
  */
 
 #include "FileSizeStats.h"
+#include "DirInfo.h"
 #include "FileInfoIterator.h"
+#include "StatsRunner.h"
 #include "Wildcard.h"
 
 
+// Above this many files, count the sizes in a sketch instead of sorting them all
+#define SKETCH_MIN_ITEMS       ( 1000 * 1000 )
+
+
 using namespace QDirStat;
 
 
-FileSizeStats::FileSizeStats( FileInfo * subtree, bool excludeSymlinks ):
+FileSizeStats::FileSizeStats( FileInfo      * subtree,
+                              bool            excludeSymlinks,
+                              StatsProgress * progress ):
     PercentileStats{}
 {
     if ( !subtree || !subtree->checkMagicNumber() )
         return;
 
-    reserve( subtree->totalNonDirItems() );
-    collect( subtree, excludeSymlinks );
-    sort();
+    // Go straight to a sketch if there will be too many files to sort,
+    // so the cached directory sketches can be merged
+    const FileCount items = subtree->totalNonDirItems();
+    if ( items > SKETCH_MIN_ITEMS )
+        useSketch( 0, DirSizeSketch::precisionBits() );
+    else
+        reserve( items );
+
+    collect( subtree, excludeSymlinks, progress );
 }
 
 
-FileSizeStats::FileSizeStats( const FileInfo * subtree, const WildcardCategory & wildcardCategory ):
+FileSizeStats::FileSizeStats( const FileInfo         * subtree,
+                              const WildcardCategory & wildcardCategory,
+                              StatsProgress          * progress ):
     PercentileStats{}
 {
     if ( !subtree || !subtree->checkMagicNumber() )
         return;
 
-    collect( subtree, wildcardCategory );
-    sort();
+    // The same precision as the cached sketches, better than 1%
+    useSketch( SKETCH_MIN_ITEMS, DirSizeSketch::precisionBits() );
+    collect( subtree, wildcardCategory, progress );
 }
 
 
-void FileSizeStats::collect( const FileInfo * subtree, bool excludeSymlinks )
+void FileSizeStats::collect( FileInfo * subtree, bool excludeSymlinks, StatsProgress * progress )
 {
+    if ( subtree->isDirInfo() )
+    {
+        // Use the cached sketch of a large subtree rather than visiting every file
+        const DirSizeSketch * sizeSketch =
+            isApproximate() ? static_cast<DirInfo *>( subtree )->sizeSketch() : nullptr;
+        if ( sizeSketch )
+        {
+            addSketch( sizeSketch->files() );
+            if ( !excludeSymlinks )
+                addSketch( sizeSketch->symlinks() );
+
+            if ( progress )
+                progress->addDirs( subtree->totalSubDirs() + 1 );
+
+            return;
+        }
+
+        if ( progress && !progress->visitDir() )
+            return;
+    }
+
     if ( ( !excludeSymlinks && subtree->isSymlink() ) || subtree->isFile() )
-        append( subtree->size() );
+        addValue( subtree->size() );
 
     for ( DotEntryIterator it{ subtree }; *it; ++it )
-        collect( *it, excludeSymlinks );
+        collect( *it, excludeSymlinks, progress );
 }
 
 
-void FileSizeStats::collect( const FileInfo * subtree, const WildcardCategory & wildcardCategory )
+void FileSizeStats::collect( const FileInfo         * subtree,
+                             const WildcardCategory & wildcardCategory,
+                             StatsProgress          * progress )
 {
+    if ( subtree->isDirInfo() && progress && !progress->visitDir() )
+        return;
+
     if ( wildcardCategory.matches( subtree ) )
-        append( subtree->size() );
+        addValue( subtree->size() );
 
     for ( DotEntryIterator it{ subtree }; *it; ++it )
-        collect( *it, wildcardCategory );
+        collect( *it, wildcardCategory, progress );
 }
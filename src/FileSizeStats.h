@@ -16,13 +16,19 @@
 namespace QDirStat
 {
     class FileInfo;
+    class StatsProgress;
     struct WildcardCategory;
 
     /**
      * Helper class for extended file size statistics.
      *
      * This collects file size data for trees or subtrees for later use for
-     * calculating a median or quantiles or histograms.
+     * calculating a median or quantiles or histograms.  For trees with more
+     * than a million files, the sizes are counted in a sketch and the
+     * statistics are estimates (see PercentileStats::isApproximate()).
+     * Those sketches are merged from the ones cached on large
+     * directories (see DirInfo::sizeSketch()), so the files themselves
+     * are mostly not visited.
      **/
     class FileSizeStats final : public PercentileStats
     {
@@ -30,32 +36,40 @@ namespace QDirStat
 
 	/**
 	 * Constructor with a subtree and optional flag whether to exclude
-	 * symlinks.
+	 * symlinks.  If 'progress' is not null, the collection reports to
+	 * it and stops early if it is cancelled.
 	 **/
-	FileSizeStats( FileInfo * subtree, bool excludeSymlinks = false );
+	FileSizeStats( FileInfo      * subtree,
+	               bool            excludeSymlinks = false,
+	               StatsProgress * progress = nullptr );
 
 	/**
 	 * Constructor with a subtree and WildcardCategory.  Used with
 	 * calls from FileTypeStatsWindow.
 	 **/
-	FileSizeStats( const FileInfo * subtree, const WildcardCategory & wildcardCategory );
+	FileSizeStats( const FileInfo         * subtree,
+	               const WildcardCategory & wildcardCategory,
+	               StatsProgress          * progress = nullptr );
 
 
     protected:
 
 	/**
-	 * Recurse through all file elements in the subtree and append the own
+	 * Recurse through all file elements in the subtree and add the own
 	 * size for each file to the data collection. Note that the data are
-	 * unsorted after this.
+	 * unsorted after this.  When collecting into a sketch, the cached
+	 * sketches of large subdirectories are merged instead.
 	 **/
-	void collect( const FileInfo * subtree, bool excludeSymlinks );
+	void collect( FileInfo * subtree, bool excludeSymlinks, StatsProgress * progress );
 
 	/**
-	 * Recurse through all file elements in the subtree and append the own
+	 * Recurse through all file elements in the subtree and add the own
 	 * size for each file matching 'wildcardCategory' to the data
 	 * collection. Note that the data are unsorted after this.
 	 **/
-	void collect( const FileInfo * subtree, const WildcardCategory & wildcardCategory );
+	void collect( const FileInfo         * subtree,
+	              const WildcardCategory & wildcardCategory,
+	              StatsProgress          * progress );
 
     };	// class FileSizeStats
 
@@ -188,6 +188,18 @@ FileSizeStatsWindow::FileSizeStatsWindow( QWidget * parent ):
     initWidgets( this, _ui.get() );
     connectActions();
 
+    connect( &_statsRunner, &StatsRunner::started,
+             this,          &FileSizeStatsWindow::collectionStarted );
+
+    connect( &_statsRunner, &StatsRunner::progress,
+             this,          &FileSizeStatsWindow::showProgress );
+
+    connect( &_statsRunner, &StatsRunner::finished,
+             this,          &FileSizeStatsWindow::collectionEnded );
+
+    connect( &_statsRunner, &StatsRunner::aborted,
+             this,          &FileSizeStatsWindow::collectionEnded );
+
     Settings::readWindowSettings( this, "FileSizeStatsWindow" );
     ActionManager::actionHotkeys( this, "FileSizeStatsWindow" );
 
@@ -286,34 +298,57 @@ void FileSizeStatsWindow::populate( FileInfo * fileInfo, const WildcardCategory
     _ui->headingLabel->setStatusTip( header % replaceCrLf( fileInfo->debugUrl() ));
     showElidedLabel( _ui->headingLabel, this ); // sets the label from the status tip, to fit the window
 
+    _initHistogram = true;
     loadStats( fileInfo );
-
-    initHistogram();
 }
 
 
 void FileSizeStatsWindow::refresh()
 {
     loadStats( _subtree() );
-
-    setPercentileRange();
 }
 
 
 void FileSizeStatsWindow::loadStats( FileInfo * fileInfo )
 {
-    FileSizeStats * stats = _wildcardCategory.isEmpty() ?
-                            new FileSizeStats{ fileInfo, _ui->excludeSymlinksCheckBox->isChecked() } :
-                            new FileSizeStats{ fileInfo, _wildcardCategory };
-    stats->calculatePercentiles();
+    const bool excludeSymlinks = _ui->excludeSymlinksCheckBox->isChecked();
+    const WildcardCategory wildcardCategory = _wildcardCategory;
+
+    const auto collect = [ fileInfo, excludeSymlinks, wildcardCategory ]( StatsProgress & progress )
+    {
+	FileSizeStats * stats = wildcardCategory.isEmpty() ?
+	                        new FileSizeStats{ fileInfo, excludeSymlinks, &progress } :
+	                        new FileSizeStats{ fileInfo, wildcardCategory, &progress };
+	if ( !progress.isCancelled() )
+	    stats->calculatePercentiles();
 
-    bucketsTableModel( _ui->bucketsTable )->setStats( stats );
-    percentileTableModel( _ui->percentileTable )->setStats( stats );
-    _ui->histogramView->init( stats );
+	return stats;
+    };
 
-    _stats.reset( stats );
+    _statsRunner.start( fileInfo, collect, [ this ]( std::unique_ptr<FileSizeStats> stats )
+	{ showStats( std::move( stats ) ); } );
+}
+
+
+void FileSizeStatsWindow::showStats( std::unique_ptr<FileSizeStats> stats )
+{
+    bucketsTableModel( _ui->bucketsTable )->setStats( stats.get() );
+    percentileTableModel( _ui->percentileTable )->setStats( stats.get() );
+    _ui->histogramView->init( stats.get() );
+
+    _stats = std::move( stats );
 
     setPercentileTable();
+
+    if ( _initHistogram )
+    {
+	_initHistogram = false;
+	initHistogram();
+    }
+    else
+    {
+	setPercentileRange();
+    }
 }
 
 
@@ -332,14 +367,19 @@ void FileSizeStatsWindow::initHistogram()
 
 void FileSizeStatsWindow::setPercentileTable()
 {
-    const double nominalCount = 1.0l * _stats->size() / _stats->maxPercentile();
+    // Nothing to show until the first statistics are ready
+    if ( !_stats )
+	return;
+
+    const double nominalCount = 1.0l * _stats->valueCount() / _stats->maxPercentile();
     const int precision = [ nominalCount ]()
     {
 	if ( nominalCount == 0 || nominalCount >= 10 ) return 0;
 	if ( nominalCount >= 1 ) return 1;
 	return 2;
     }();
-    const QString text = tr( "Nominal files per percentile: " ) % formatCount( nominalCount, precision );
+    const QString approximate = _stats->isApproximate() ? tr( " (approximate)" ) : QString{};
+    const QString text = tr( "Nominal files per percentile: " ) % formatCount( nominalCount, precision ) % approximate;
     _ui->nominalCountLabel->setText( text );
 
     const bool filterRows = !_ui->percentileFilterCheckBox->isChecked();
@@ -349,6 +389,9 @@ void FileSizeStatsWindow::setPercentileTable()
 
 void FileSizeStatsWindow::setPercentileRange()
 {
+    if ( !_stats )
+	return;
+
     const int       startPercentile = _ui->startPercentileSlider->value();
     const int       endPercentile   = _ui->endPercentileSlider->value();
     const FileCount dataCount       = _stats->percentileCount( startPercentile, endPercentile );
@@ -380,6 +423,9 @@ void FileSizeStatsWindow::markersChanged()
 
 void FileSizeStatsWindow::autoPercentileRange()
 {
+    if ( !_stats )
+	return;
+
     // Outliers are classed as more than three times the IQR beyond the 3rd quartile
     // Just use the IQR beyond the 1st quartile because of the usual skewed file size distribution
     const FileSize q1Value  = _stats->q1Value();
@@ -455,6 +501,30 @@ void FileSizeStatsWindow::showHelp() const
 }
 
 
+void FileSizeStatsWindow::collectionStarted()
+{
+    _ui->histogramPage->setEnabled( false );
+    _ui->bucketsPage->setEnabled( false );
+    _ui->percentilePage->setEnabled( false );
+}
+
+
+void FileSizeStatsWindow::showProgress( int percent )
+{
+    _ui->headingLabel->setText( tr( "Collecting file size statistics... %1%" ).arg( percent ) );
+}
+
+
+void FileSizeStatsWindow::collectionEnded()
+{
+    _ui->histogramPage->setEnabled( true );
+    _ui->bucketsPage->setEnabled( true );
+    _ui->percentilePage->setEnabled( true );
+
+    showElidedLabel( _ui->headingLabel, this );
+}
+
+
 bool FileSizeStatsWindow::event( QEvent * event )
 {
     switch ( event->type() )
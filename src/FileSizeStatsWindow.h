@@ -15,6 +15,7 @@
 #include <QDialog>
 
 #include "ui_file-size-stats-window.h"
+#include "StatsRunner.h"
 #include "Subtree.h"
 #include "Wildcard.h"
 
@@ -145,6 +146,23 @@ namespace QDirStat
 	 **/
 	void showHelp() const;
 
+	/**
+	 * Disable the statistics pages while new statistics are being
+	 * collected.
+	 **/
+	void collectionStarted();
+
+	/**
+	 * Show the progress of collecting the statistics in the heading.
+	 **/
+	void showProgress( int percent );
+
+	/**
+	 * Restore the heading and enable the statistics pages again once
+	 * the statistics are collected or the collection is cancelled.
+	 **/
+	void collectionEnded();
+
 
     protected:
 
@@ -154,24 +172,28 @@ namespace QDirStat
 	void connectActions();
 
 	/**
-	 * Populate with new content.  The titles are initialised, the
-	 * statistics are loaded, the buckets are filled, the models
-	 * are all reset, the percentile range is set automatically,
-	 * and the histogram is rebuilt.
+	 * Populate with new content.  The titles are initialised and the
+	 * statistics are loaded.  Once they are ready, the buckets are
+	 * filled, the models are all reset, the percentile range is set
+	 * automatically, and the histogram is rebuilt.
 	 **/
 	void populate( FileInfo * fileInfo, const WildcardCategory & wildcardCategory );
 
 	/**
-	 * (Re-)load the statistics from disk, including calculating
-	 * the percentiles.  Notify the models and reset the percentile
-	 * table model.
-	 *
-	 * Note that the buckets are not filled, the buckets table
-	 * model is not reset, and the histogram is not rebuilt.  These
-	 * must all be done immediately after a call to loadStats().
+	 * Start (re-)loading the statistics in a worker thread, including
+	 * calculating the percentiles.  The window keeps showing the old
+	 * statistics until showStats() is called with the new ones.
 	 **/
 	void loadStats( FileInfo * fileInfo );
 
+	/**
+	 * Replace the current statistics with 'stats'.  Notify the models
+	 * and reset the percentile table model, then either initialise the
+	 * histogram for a newly populated window or fill the buckets for
+	 * the current percentile range.
+	 **/
+	void showStats( std::unique_ptr<FileSizeStats> stats );
+
 	/**
 	 * Initialise the histogram data.
 	 **/
@@ -207,6 +229,9 @@ namespace QDirStat
 
 	Subtree          _subtree;
 	WildcardCategory _wildcardCategory;
+	bool             _initHistogram{ false };
+
+	StatsRunner      _statsRunner;
 
     };	// class FileSizeStatsWindow
 
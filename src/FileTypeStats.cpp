@@ -14,6 +14,7 @@
 #include "Logger.h"
 #include "MimeCategorizer.h"
 #include "MimeCategory.h"
+#include "StatsRunner.h"
 
 
 #define VERBOSE_STATS 0
@@ -81,13 +82,13 @@ namespace
 } // namespace
 
 
-FileTypeStats::FileTypeStats( FileInfo * subtree )
+FileTypeStats::FileTypeStats( FileInfo * subtree, StatsProgress * progress )
 {
     if ( subtree && subtree->checkMagicNumber() )
     {
 	const QRegularExpression matchUnusual{ "[^\\w]" };
 	const QRegularExpression matchInvalid{ "\\p{Z}|\\p{C}" };
-	collect( subtree, matchUnusual, matchInvalid );
+	collect( subtree, matchUnusual, matchInvalid, progress );
 
 #if VERBOSE_STATS
 	sanityCheck( subtree );
@@ -102,15 +103,19 @@ FileTypeStats::FileTypeStats( FileInfo * subtree )
 
 void FileTypeStats::collect( const FileInfo           * dir,
                              const QRegularExpression & matchUnusual,
-                             const QRegularExpression & matchInvalid )
+                             const QRegularExpression & matchInvalid,
+                             StatsProgress            * progress )
 {
+    if ( progress && !progress->visitDir() )
+	return;
+
     MimeCategorizer * categorizer = MimeCategorizer::instance();
 
     for ( DotEntryIterator it{ dir }; *it; ++it )
     {
 	if ( it->hasChildren() )
 	{
-	    collect( *it, matchUnusual, matchInvalid );
+	    collect( *it, matchUnusual, matchInvalid, progress );
 	}
 	else if ( it->isFileOrSymlink() )
 	{
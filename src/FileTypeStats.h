@@ -20,6 +20,7 @@ namespace QDirStat
 {
     class FileInfo;
     class MimeCategory;
+    class StatsProgress;
 
     struct PatternCategory
     {
@@ -78,9 +79,10 @@ namespace QDirStat
 
 	/**
 	 * Constructor.  Constructing an instance will analyse the given subtree
-	 * and populate the three statistics maps.
+	 * and populate the three statistics maps.  If 'progress' is not null,
+	 * the collection reports to it and stops early if it is cancelled.
 	 **/
-	FileTypeStats( FileInfo * subtree );
+	FileTypeStats( FileInfo * subtree, StatsProgress * progress = nullptr );
 
 	/**
 	 * Iterators for the two maps.
@@ -108,7 +110,8 @@ namespace QDirStat
 	 **/
 	void collect( const FileInfo           * dir,
                       const QRegularExpression & matchLetters,
-                      const QRegularExpression & matchSpaces );
+                      const QRegularExpression & matchSpaces,
+                      StatsProgress            * progress );
 
 	/**
 	 * Aggregate category entries to a map of CountSize structs with
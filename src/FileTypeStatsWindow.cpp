@@ -191,15 +191,10 @@ namespace
 
 
     /**
-     * Populate 'treeWidget' with type statistics collected for
-     * 'subtree'.  The statistics are discarded once the tree has
-     * been populated.
+     * Populate 'treeWidget' with type statistics 'stats'.
      **/
-    void populateTree( QTreeWidget * treeWidget, FileInfo * subtree )
+    void populateTree( QTreeWidget * treeWidget, const FileTypeStats & stats )
     {
-	// Collect statistics for 'subtree'
-	const FileTypeStats stats{ subtree };
-
 	// Create a map of toplevel items for finding pattern item parents
 	QHash<const MimeCategory *, FileTypeItem *> categoryItem;
 	for ( auto it = stats.categoriesBegin(); it != stats.categoriesEnd(); ++it )
@@ -326,6 +321,18 @@ FileTypeStatsWindow::FileTypeStatsWindow( QWidget * parent ):
     connect( _ui->actionLocate,    &QAction::triggered,
              this,                 &FileTypeStatsWindow::itemActivated );
 
+    connect( &_statsRunner,        &StatsRunner::started,
+             this,                 &FileTypeStatsWindow::collectionStarted );
+
+    connect( &_statsRunner,        &StatsRunner::progress,
+             this,                 &FileTypeStatsWindow::showProgress );
+
+    connect( &_statsRunner,        &StatsRunner::finished,
+             this,                 &FileTypeStatsWindow::collectionEnded );
+
+    connect( &_statsRunner,        &StatsRunner::aborted,
+             this,                 &FileTypeStatsWindow::collectionEnded );
+
     // See also signal/slot connections in file-type-stats-window.ui
 
     show();
@@ -376,6 +383,28 @@ void FileTypeStatsWindow::syncedPopulate()
 
 
 void FileTypeStatsWindow::populate( FileInfo * newSubtree )
+{
+    if ( !newSubtree )
+    {
+	_statsRunner.cancel();
+	_ui->treeWidget->clear();
+	return;
+    }
+
+    _subtree = newSubtree;
+
+    _ui->headingLabel->setStatusTip( tr( "File type statistics for " ) % replaceCrLf( _subtree.url() ) );
+    showElidedLabel( _ui->headingLabel, this );
+
+    _statsRunner.start( newSubtree,
+                        [ newSubtree ]( StatsProgress & progress )
+                            { return new FileTypeStats{ newSubtree, &progress }; },
+                        [ this ]( std::unique_ptr<FileTypeStats> stats )
+                            { showStats( *stats ); } );
+}
+
+
+void FileTypeStatsWindow::showStats( const FileTypeStats & stats )
 {
     _ui->treeWidget->clear();
 
@@ -383,15 +412,29 @@ void FileTypeStatsWindow::populate( FileInfo * newSubtree )
     PercentBarDelegate::delegateForColumn( _ui->treeWidget, FT_CountPercentBarCol )->setHeight( newHeight );
     PercentBarDelegate::delegateForColumn( _ui->treeWidget, FT_SizePercentBarCol  )->setHeight( newHeight );
 
-    if ( !newSubtree )
-	return;
+    populateTree( _ui->treeWidget, stats );
+}
 
-    _subtree = newSubtree;
 
-    _ui->headingLabel->setStatusTip( tr( "File type statistics for " ) % replaceCrLf( _subtree.url() ) );
-    showElidedLabel( _ui->headingLabel, this );
+void FileTypeStatsWindow::collectionStarted()
+{
+    _ui->treeWidget->setEnabled( false );
+    enableActions( false );
+}
+
+
+void FileTypeStatsWindow::showProgress( int percent )
+{
+    _ui->headingLabel->setText( tr( "Collecting file type statistics... %1%" ).arg( percent ) );
+}
 
-    populateTree( _ui->treeWidget, _subtree() );
+
+void FileTypeStatsWindow::collectionEnded()
+{
+    _ui->treeWidget->setEnabled( true );
+    enableActions();
+
+    showElidedLabel( _ui->headingLabel, this );
 }
 
 
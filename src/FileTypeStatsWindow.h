@@ -17,6 +17,7 @@
 
 #include "ui_file-type-stats-window.h"
 #include "FileTypeStats.h" // CountSize, PatternCategory
+#include "StatsRunner.h"
 #include "Subtree.h"
 #include "Typedefs.h" // FileCount, FileSize
 
@@ -115,14 +116,37 @@ namespace QDirStat
 	 **/
 	void contextMenu( const QPoint & pos );
 
+	/**
+	 * Disable the tree while new statistics are being collected.
+	 **/
+	void collectionStarted();
+
+	/**
+	 * Show the progress of collecting the statistics in the heading.
+	 **/
+	void showProgress( int percent );
+
+	/**
+	 * Restore the heading and enable the tree again once the
+	 * statistics are collected or the collection is cancelled.
+	 **/
+	void collectionEnded();
+
 
     protected:
 
 	/**
-	 * Populate the widgets for a subtree.
+	 * Populate the widgets for a subtree.  The statistics are
+	 * collected in a worker thread and the tree keeps showing the old
+	 * statistics until the new ones are ready.
 	 **/
 	void populate( FileInfo * subtree );
 
+	/**
+	 * Replace the contents of the tree with 'stats'.
+	 **/
+	void showStats( const FileTypeStats & stats );
+
 	/**
 	 * Enable or disable the actions.
 	 **/
@@ -157,7 +181,8 @@ namespace QDirStat
     private:
 
 	std::unique_ptr<Ui::FileTypeStatsWindow> _ui;
-	Subtree _subtree;
+	Subtree     _subtree;
+	StatsRunner _statsRunner;
 
     };	// class FileTypeStatsWindow
 
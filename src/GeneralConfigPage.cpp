@@ -10,10 +10,12 @@
 #include "GeneralConfigPage.h"
 #include "ConfigDialog.h"
 #include "DirTreeModel.h"
+#include "FormatUtil.h"
 #include "Logger.h"
 #include "MainWindow.h"
 #include "QDirStatApp.h"
 #include "Settings.h"
+#include "TreemapView.h"
 
 
 using namespace QDirStat;
@@ -46,6 +48,13 @@ namespace
         // Use word-joiner character to stop unwanted line breaks
         const QString joinedFileName = Settings::primaryFileName().replace( u'/', "/⁠" );
         ui->explainerLabel->setText( QObject::tr( "There are many more settings in the file " ) + joinedFileName );
+
+        const TreemapView * treemapView = mainWindow->treemapView();
+        const QString treemapMemory = QObject::tr( "Treemap memory: %1 for %2 tiles, %3 of %4 for cached cushions" );
+        ui->treemapMemoryLabel->setText( treemapMemory.arg( formatSize( treemapView->tileMemory() ) )
+                                                      .arg( treemapView->tileCount() )
+                                                      .arg( formatSize( treemapView->cushionMemory() ) )
+                                                      .arg( formatSize( treemapView->cushionMemoryLimit() ) ) );
     }
 
 }
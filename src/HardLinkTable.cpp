@@ -0,0 +1,153 @@
+/*
+ *   File name: HardLinkTable.cpp
+ *   Summary:   Table of hard-linked files for exact size accounting in QDirStat
+ *   License:   GPL V2 - See file LICENSE for details.
+ *
+ *   Authors:   Stefan Hundhammer <Stefan.Hundhammer@gmx.de>
+ *              Ian Nartowicz
+ */
+
+#include <algorithm> // remove_if()
+
+#include <QSet>
+
+#include "HardLinkTable.h"
+#include "DirInfo.h"
+#include "FileInfo.h"
+
+
+// Maximum estimated memory for the table before new inodes are turned away
+#define MAX_TABLE_BYTES  ( 64 * 1024 * 1024 )
+
+// Estimated bytes for each inode: the hash node, the key, and the link list
+#define INODE_BYTES  ( 2 * sizeof( void * ) + sizeof( QPair<dev_t, ino_t> ) + sizeof( QVector<FileInfo *> ) + 32 )
+
+// Estimated bytes for each link: the pointer in the list, and the index entry
+#define LINK_BYTES  ( 4 * sizeof( void * ) + sizeof( QPair<dev_t, ino_t> ) )
+
+
+using namespace QDirStat;
+
+
+void HardLinkTable::add( FileInfo * file, dev_t device, ino_t inode )
+{
+    const InodeKey key{ device, inode };
+
+    auto it = _inodes.find( key );
+    if ( it == _inodes.end() )
+    {
+	if ( memoryUsed() >= MAX_TABLE_BYTES )
+	{
+	    _isFull = true;
+	    return;
+	}
+
+	// The first link found is the one that is counted
+	it = _inodes.insert( key, Links{} );
+	file->setCountedLink( true );
+    }
+    else
+    {
+	file->setCountedLink( false );
+    }
+
+    it.value() << file;
+    _linkKeys.insert( file, key );
+    ++_linkCount;
+}
+
+
+template<typename Predicate>
+QHash<HardLinkTable::InodeKey, HardLinkTable::Links>::iterator
+HardLinkTable::removeLinks( QHash<InodeKey, Links>::iterator it, Predicate isRemoved )
+{
+    Links & links = it.value();
+    FileInfo * countedLink = links.first();
+
+    const auto newEnd = std::remove_if( links.begin(), links.end(), isRemoved );
+    for ( auto link = newEnd; link != links.end(); ++link )
+	_linkKeys.remove( *link );
+    _linkCount -= links.end() - newEnd;
+    links.erase( newEnd, links.end() );
+
+    if ( links.isEmpty() )
+	return _inodes.erase( it );
+
+    // Count the next link instead, and bring the totals above it up to date
+    if ( links.first() != countedLink )
+    {
+	FileInfo * newCountedLink = links.first();
+	newCountedLink->setCountedLink( true );
+	if ( newCountedLink->parent() )
+	    newCountedLink->parent()->markAsDirty();
+    }
+
+    return ++it;
+}
+
+
+void HardLinkTable::removeSubtrees( const FileInfoSet & subtrees )
+{
+    // Look up files in the index, and collect the directories for one pass through the table
+    QSet<const FileInfo *> dirs;
+    for ( const FileInfo * subtree : subtrees )
+    {
+	if ( subtree->isDirInfo() )
+	{
+	    dirs.insert( subtree );
+	}
+	else
+	{
+	    const auto key = _linkKeys.constFind( subtree );
+	    if ( key != _linkKeys.cend() )
+	    {
+		const auto isSubtree = [ subtree ]( const FileInfo * link ) { return link == subtree; };
+		removeLinks( _inodes.find( key.value() ), isSubtree );
+	    }
+	}
+    }
+
+    if ( dirs.isEmpty() || _inodes.isEmpty() )
+	return;
+
+    const auto inDirs = [ &dirs ]( const FileInfo * link ) -> bool
+    {
+	for ( const FileInfo * ancestor = link->parent(); ancestor; ancestor = ancestor->parent() )
+	{
+	    if ( dirs.contains( ancestor ) )
+		return true;
+	}
+
+	return false;
+    };
+
+    for ( auto it = _inodes.begin(); it != _inodes.end(); )
+	it = removeLinks( it, inDirs );
+}
+
+
+QVector<FileInfo *> HardLinkTable::groupedLinks( const FileInfo * subtree ) const
+{
+    QVector<FileInfo *> results;
+    if ( !subtree )
+	return results;
+
+    for ( const Links & links : _inodes )
+    {
+	for ( FileInfo * link : links )
+	{
+	    if ( link->isInSubtree( subtree ) )
+		results << link;
+	}
+    }
+
+    return results;
+}
+
+
+qint64 HardLinkTable::memoryUsed() const
+{
+    return ( _inodes.capacity() + _linkKeys.capacity() ) * sizeof( void * ) +
+	   _inodes.size() * qint64( INODE_BYTES ) +
+	   _linkCount * qint64( LINK_BYTES );
+}
@@ -0,0 +1,137 @@
+/*
+ *   File name: HardLinkTable.h
+ *   Summary:   Table of hard-linked files for exact size accounting in QDirStat
+ *   License:   GPL V2 - See file LICENSE for details.
+ *
+ *   Authors:   Stefan Hundhammer <Stefan.Hundhammer@gmx.de>
+ *              Ian Nartowicz
+ */
+
+#ifndef HardLinkTable_h
+#define HardLinkTable_h
+
+#include <sys/types.h> // dev_t, ino_t
+
+#include <QHash>
+#include <QPair>
+#include <QVector>
+
+#include "FileInfoSet.h"
+
+
+namespace QDirStat
+{
+    class FileInfo;
+
+    /**
+     * Table of the files with more than one hard link found while a tree
+     * is read, keyed by their device and inode numbers.
+     *
+     * The first link found for each inode is counted with the full size
+     * of the file; every other link of the same inode in the tree counts
+     * as zero bytes.  This gives exact totals even when only some of the
+     * links of a file are inside the tree, rather than dividing the size
+     * of each link by the number of links.
+     *
+     * The memory used by the table is estimated as it grows, and no new
+     * inodes are added once it reaches a fixed limit.  Files with inodes
+     * that are not in the table fall back to dividing their size by the
+     * number of links.
+     *
+     * The table holds plain pointers to the tree items, so links must be
+     * removed before they are deleted.  See DirTree::hardLinks().
+     **/
+    class HardLinkTable final
+    {
+    public:
+
+	/**
+	 * Add 'file' with device 'device' and inode 'inode' to the table
+	 * and mark it as either the counted link or an uncounted link.
+	 * If the table is full and the inode isn't in it yet, the file is
+	 * not added and its size is divided as before.
+	 *
+	 * This must be called before the file is inserted into its parent.
+	 **/
+	void add( FileInfo * file, dev_t device, ino_t inode );
+
+	/**
+	 * Remove all the links inside 'subtrees' from the table.  If the
+	 * counted link of an inode is removed, the next link is counted
+	 * instead and its parent is marked as dirty.
+	 *
+	 * Files are looked up directly.  Directories take one pass through
+	 * the table for all of them, so a batch of items to be deleted
+	 * should be removed with a single call.
+	 **/
+	void removeSubtrees( const FileInfoSet & subtrees );
+
+	/**
+	 * Return the links inside 'subtree', grouped by inode, with the
+	 * counted link first in each group.  Only inodes with at least one
+	 * link inside 'subtree' are returned.
+	 **/
+	QVector<FileInfo *> groupedLinks( const FileInfo * subtree ) const;
+
+	/**
+	 * Return the number of inodes in the table.
+	 **/
+	int inodeCount() const { return _inodes.size(); }
+
+	/**
+	 * Return the number of links in the table.
+	 **/
+	qint64 linkCount() const { return _linkCount; }
+
+	/**
+	 * Return the estimated number of bytes used by the table.
+	 **/
+	qint64 memoryUsed() const;
+
+	/**
+	 * Return 'true' if new inodes were turned away because the table
+	 * was full.
+	 **/
+	bool isFull() const { return _isFull; }
+
+	/**
+	 * Note that a file with multiple links was added to the tree
+	 * without being added to the table, for example because it is
+	 * ignored or it was read from a cache file, which has no inode
+	 * numbers.
+	 **/
+	void markIncomplete() { _isIncomplete = true; }
+
+	/**
+	 * Return 'true' if there may be files with multiple links in the
+	 * tree that are not in the table, because it was full or because
+	 * of markIncomplete().
+	 **/
+	bool isIncomplete() const { return _isFull || _isIncomplete; }
+
+
+    private:
+
+	typedef QPair<dev_t, ino_t>  InodeKey;
+	typedef QVector<FileInfo *>  Links;
+
+	/**
+	 * Remove the links of the inode at 'it' for which 'isRemoved'
+	 * returns 'true', from the table and from the index.  Returns the
+	 * iterator of the next inode.
+	 **/
+	template<typename Predicate>
+	QHash<InodeKey, Links>::iterator removeLinks( QHash<InodeKey, Links>::iterator it,
+	                                              Predicate                        isRemoved );
+
+	QHash<InodeKey, Links>            _inodes;
+	QHash<const FileInfo *, InodeKey> _linkKeys;	// the inode of each link
+	qint64                            _linkCount{ 0 };
+	bool                              _isFull{ false };
+	bool                              _isIncomplete{ false };
+
+    };	// class HardLinkTable
+
+}	// namespace QDirStat
+
+#endif	// ifndef HardLinkTable_h
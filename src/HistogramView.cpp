@@ -590,11 +590,11 @@ void HistogramView::addOverflowPanel( QGraphicsScene * scene, qreal panelWidth )
 
     // Upper pie chart: number of files cut off
     const FileCount histogramFiles = _stats->percentileCount( _startPercentile, _endPercentile );
-    const FileCount missingFiles   = _stats->size() - histogramFiles;
+    const FileCount missingFiles   = _stats->valueCount() - histogramFiles;
     addPie( missingFiles, histogramFiles );
 
     // Caption for the upper pie chart
-    const int missingPercent = qRound( percent( missingFiles, _stats->size() ) );
+    const int missingPercent = qRound( percent( missingFiles, _stats->valueCount() ) );
     const QString cutoffCaption =
 	missingFiles == 1 ? tr( "1 file cut off" ) : tr( "%L1 files cut off" ).arg( missingFiles );
     addText( cutoffCaption % tr( "<br/>%1% of all files" ).arg( missingPercent ) );
@@ -13,7 +13,6 @@
 #include "LocateFileTypeWindow.h"
 #include "DirTree.h"
 #include "DirTreeModel.h"
-#include "Exception.h"
 #include "FileInfoIterator.h"
 #include "FormatUtil.h"
 #include "MainWindow.h"
@@ -50,17 +49,49 @@ namespace
 
 
     /**
-     * One-time initialization of the tree widget.
+     * Recursively locate directories that contain files matching
+     * 'wildcardCategory' and add a search result for each one to
+     * 'results'.
      **/
-    void initTree( QTreeWidget * tree )
+    void findMatches( FileInfo               * dir,
+                      const WildcardCategory & wildcardCategory,
+                      StatsProgress          & progress,
+                      LocateListResults      & results )
     {
-//	app()->dirTreeModel()->setTreeIconSize( tree );
+	if ( !progress.visitDir() )
+	    return;
 
-	QTreeWidgetItem * headerItem = tree->headerItem();
-	headerItem->setText( PSR_CountCol,     QObject::tr( "Files" ) );
-	headerItem->setText( PSR_TotalSizeCol, QObject::tr( "Total Size" ) );
-	headerItem->setText( PSR_PathCol,      QObject::tr( "Directory" ) );
-	headerItem->setTextAlignment( PSR_PathCol, Qt::AlignLeft | Qt::AlignVCenter );
+	const FileInfoSet matches = matchingFiles( dir, wildcardCategory );
+	if ( !matches.isEmpty() )
+	{
+	    // Create a search result for this path
+	    const int count = matches.size();
+	    FileSize totalSize = 0LL;
+	    for ( const FileInfo * file : matches )
+		totalSize += file->size();
+
+	    results << LocateListResult{ dir, totalSize, 0, count, QString{}, QIcon{} };
+	}
+
+	// Recurse through any subdirectories
+	for ( DirInfoIterator it{ dir }; *it; ++it )
+	    findMatches( *it, wildcardCategory, progress, results );
+
+	// Unlike in FileTypeStats, there is no need to recurse through
+	// any dot entries: They are handled in matchingFiles() already.
+    }
+
+
+    /**
+     * One-time initialization of the model and the tree view.
+     **/
+    void initTree( LocateListModel * model, QTreeView * tree )
+    {
+	// The columns must be added in the order of PatternSearchResultColumns
+	model->addColumn( LF_Count, QObject::tr( "Files" ),      Qt::AlignRight );
+	model->addColumn( LF_Size,  QObject::tr( "Total Size" ), Qt::AlignRight );
+	model->addColumn( LF_Path,  QObject::tr( "Directory" ),  Qt::AlignLeft );
+	tree->setModel( model );
 
 	QHeaderView * header = tree->header();
 	header->setDefaultAlignment( Qt::AlignHCenter | Qt::AlignVCenter );
@@ -74,7 +105,8 @@ namespace
 
 LocateFileTypeWindow::LocateFileTypeWindow( QWidget * parent ):
     QDialog{ parent },
-    _ui{ new Ui::LocateFileTypeWindow }
+    _ui{ new Ui::LocateFileTypeWindow },
+    _model{ new LocateListModel{ this } }
 {
     // logDebug() << "init" << Qt::endl;
 
@@ -82,14 +114,26 @@ LocateFileTypeWindow::LocateFileTypeWindow( QWidget * parent ):
 
     _ui->setupUi( this );
 
-    initTree( _ui->treeWidget );
+    initTree( _model, _ui->treeView );
     Settings::readWindowSettings( this, "LocateFileTypeWindow" );
 
     connect( _ui->refreshButton, &QPushButton::clicked,
              this,               &LocateFileTypeWindow::refresh );
 
-    connect( _ui->treeWidget,    &QTreeWidget::currentItemChanged,
-             this,               &LocateFileTypeWindow::selectResult );
+    connect( _ui->treeView->selectionModel(), &QItemSelectionModel::currentChanged,
+             this,                            &LocateFileTypeWindow::selectResult );
+
+    connect( &_statsRunner,      &StatsRunner::started,
+             this,               &LocateFileTypeWindow::collectionStarted );
+
+    connect( &_statsRunner,      &StatsRunner::progress,
+             this,               &LocateFileTypeWindow::showProgress );
+
+    connect( &_statsRunner,      &StatsRunner::finished,
+             this,               &LocateFileTypeWindow::collectionEnded );
+
+    connect( &_statsRunner,      &StatsRunner::aborted,
+             this,               &LocateFileTypeWindow::collectionEnded );
 }
 
 
@@ -131,48 +175,64 @@ void LocateFileTypeWindow::populate( const WildcardCategory & wildcardCategory,
     _wildcardCategory = wildcardCategory;
     _subtree = fileInfo;
 
-    _ui->treeWidget->clear();
-    _ui->treeWidget->setIconSize( app()->dirTreeModel()->dirTreeIconSize() );
+    if ( !fileInfo )
+    {
+	_statsRunner.cancel();
+	showResults( LocateListResults{} );
+	return;
+    }
+
+    const auto collect = [ fileInfo, wildcardCategory ]( StatsProgress & progress )
+    {
+	LocateListResults * results = new LocateListResults;
+	findMatches( fileInfo, wildcardCategory, progress, *results );
+
+	return results;
+    };
+
+    _statsRunner.start( fileInfo, collect, [ this ]( std::unique_ptr<LocateListResults> results )
+	{ showResults( *results ); } );
+}
 
-    populateRecursive( fileInfo ? fileInfo : _subtree() );
 
-    const int count = _ui->treeWidget->topLevelItemCount();
+void LocateFileTypeWindow::showResults( const LocateListResults & results )
+{
+    _model->clear();
+    _model->addResults( results );
+    _ui->treeView->setIconSize( app()->dirTreeModel()->dirTreeIconSize() );
+
+    const int count = _model->rowCount();
     const QString intro = count == 1 ? tr( "1 directory" ) : tr( "%L1 directories" ).arg( count );
-    const QString & pattern = wildcardCategory.wildcard.pattern();
-    const QString & name = pattern.isEmpty() ? wildcardCategory.category->name() : pattern;
+    const QString & pattern = _wildcardCategory.wildcard.pattern();
+    const QString & name = pattern.isEmpty() ? _wildcardCategory.category->name() : pattern;
     const QString heading = tr( " with %1 files below %2" ).arg( name, replaceCrLf( _subtree.url() ) );
 
     // Force a redraw of the header from the status tip
     _ui->heading->setStatusTip( intro % heading );
     showElidedLabel( _ui->heading, this );
 
-    _ui->treeWidget->setCurrentItem( _ui->treeWidget->topLevelItem( 0 ) );
+    _ui->treeView->setCurrentIndex( _model->index( 0, 0 ) );
 //    logDebug() << count << " directories" << Qt::endl;
 }
 
 
-void LocateFileTypeWindow::populateRecursive( FileInfo * dir )
+void LocateFileTypeWindow::collectionStarted()
 {
-    if ( !dir )
-	return;
+    _ui->treeView->setEnabled( false );
+}
 
-    const FileInfoSet matches = matchingFiles( dir, _wildcardCategory );
-    if ( !matches.isEmpty() )
-    {
-	// Create a search result for this path
-	FileSize totalSize = 0LL;
-	for ( const FileInfo * file : matches )
-	    totalSize += file->size();
 
-	_ui->treeWidget->addTopLevelItem( new PatternSearchResultItem{ dir->url(), matches.size(), totalSize } );
-    }
+void LocateFileTypeWindow::showProgress( int percent )
+{
+    _ui->heading->setText( tr( "Locating files... %1%" ).arg( percent ) );
+}
 
-    // Recurse through any subdirectories
-    for ( DirInfoIterator it{ dir }; *it; ++it )
-	populateRecursive( *it );
 
-    // Unlike in FileTypeStats, there is no need to recurse through
-    // any dot entries: They are handled in matchingFiles() already.
+void LocateFileTypeWindow::collectionEnded()
+{
+    _ui->treeView->setEnabled( true );
+
+    showElidedLabel( _ui->heading, this );
 }
 
 
@@ -185,14 +245,12 @@ void LocateFileTypeWindow::refresh()
 void LocateFileTypeWindow::selectResults() const
 {
     const DirTree * tree = _subtree.tree();
-    const QTreeWidgetItem * item = _ui->treeWidget->currentItem();
-    if ( !tree || !item )
+    const QModelIndex current = _ui->treeView->currentIndex();
+    if ( !tree || !current.isValid() )
 	return;
 
-    const PatternSearchResultItem * searchResult = dynamic_cast<const PatternSearchResultItem *>( item );
-    CHECK_DYNAMIC_CAST( searchResult, "PatternSearchResultItem" );
-
-    FileInfo * dir = tree->locate( searchResult->path() );
+    const QString path = _model->path( current );
+    FileInfo * dir = tree->locate( path );
 
     const FileInfoSet matches = matchingFiles( dir, _wildcardCategory );
     if ( !matches.isEmpty() )
@@ -200,7 +258,7 @@ void LocateFileTypeWindow::selectResults() const
 
     app()->selectionModel()->setSelectedItems( matches );
 
-    //logDebug() << "Selecting " << searchResult->path() << " with " << matches.size() << " matches" << Qt::endl;
+    //logDebug() << "Selecting " << path << " with " << matches.size() << " matches" << Qt::endl;
 }
 
 
@@ -219,60 +277,3 @@ bool LocateFileTypeWindow::event( QEvent * event )
     return QDialog::event( event );
 }
 
-
-
-
-PatternSearchResultItem::PatternSearchResultItem( const QString & path, int count, FileSize totalSize ):
-    QTreeWidgetItem{ UserType },
-    _path{ path },
-    _count{ count },
-    _totalSize{ totalSize }
-{
-    /**
-     * Helper function to set the text and text alignment for a column.
-     **/
-    const auto set = [ this ]( int col, Qt::Alignment alignment, const QString & text )
-    {
-	setText( col, text );
-	setTextAlignment( col, alignment | Qt::AlignVCenter );
-    };
-
-    set( PSR_CountCol,     Qt::AlignRight, formatCount( count ) );
-    set( PSR_TotalSizeCol, Qt::AlignRight, formatSize( totalSize ) );
-    set( PSR_PathCol,      Qt::AlignLeft,  replaceCrLf( path ) );
-
-    setIcon( PSR_PathCol,  QIcon( app()->dirTreeModel()->dirIcon() ) );
-}
-
-
-QVariant PatternSearchResultItem::data( int column, int role ) const
-{
-    // This is just for the tooltip for elided values in the directory column
-    if ( role != Qt::ToolTipRole || column != PSR_PathCol )
-	return QTreeWidgetItem::data( column, role );
-
-    if ( !hasLineBreak( _path ) )
-	return tooltipForElided( this, PSR_PathCol, 0 );
-
-    return pathTooltip( _path );
-}
-
-
-bool PatternSearchResultItem::operator<( const QTreeWidgetItem & rawOther ) const
-{
-    if ( !treeWidget() )
-	return QTreeWidgetItem::operator<( rawOther );
-
-    // Since this is a reference, the dynamic_cast will throw a std::bad_cast
-    // exception if it fails. Not catching this here since this is a genuine
-    // error which should not be silently ignored.
-    const PatternSearchResultItem & other = dynamic_cast<const PatternSearchResultItem &>( rawOther );
-
-    switch ( treeWidget()->sortColumn() )
-    {
-	case PSR_CountCol:     return _count     < other.count();
-	case PSR_TotalSizeCol: return _totalSize < other.totalSize();
-	default:               return QTreeWidgetItem::operator<( rawOther );
-    }
-}
-
@@ -13,11 +13,11 @@
 #include <memory>
 
 #include <QDialog>
-#include <QTreeWidgetItem>
 
 #include "ui_locate-file-type-window.h"
+#include "LocateListModel.h"
+#include "StatsRunner.h"
 #include "Subtree.h"
-#include "Typedefs.h" // FileSize
 #include "Wildcard.h"
 
 
@@ -86,6 +86,22 @@ namespace QDirStat
 	void selectResult() const;
 	void selectResults() const;
 
+	/**
+	 * Disable the results list while a new search is running.
+	 **/
+	void collectionStarted();
+
+	/**
+	 * Show the progress of the search in the heading.
+	 **/
+	void showProgress( int percent );
+
+	/**
+	 * Restore the heading and enable the results list again once the
+	 * search is finished or cancelled.
+	 **/
+	void collectionEnded();
+
 
     protected:
 
@@ -93,17 +109,17 @@ namespace QDirStat
 	 * Populate the window: Locate files with 'wildcardCategory' in
 	 * 'fileInfo'.
 	 *
-	 * This clears the old search results first, then searches the subtree
-	 * and populates the search result list with the directories where
-	 * matching files were found.
+	 * The subtree is searched in a worker thread and the old search
+	 * results are shown until the search is finished.  The search
+	 * result list is then populated with the directories where matching
+	 * files were found.
 	 **/
 	void populate( const WildcardCategory & wildcardCategory, FileInfo * fileInfo );
 
 	/**
-	 * Recursively locate directories that contain files matching the
-	 * sWildcardCategory and create a search result item for each one.
+	 * Replace the search result list with 'results'.
 	 **/
-	void populateRecursive( FileInfo * dir );
+	void showResults( const LocateListResults & results );
 
 	/**
 	 * Event handler, reimplemented from QDialog/QWidget.
@@ -121,14 +137,17 @@ namespace QDirStat
 
 	std::unique_ptr<Ui::LocateFileTypeWindow> _ui;
 
-	Subtree          _subtree;
-	WildcardCategory _wildcardCategory;
+	LocateListModel * _model;
+	Subtree           _subtree;
+	WildcardCategory  _wildcardCategory;
+
+	StatsRunner       _statsRunner;
 
     };	// class LocateFileTypeWindow
 
 
     /**
-     * Column numbers for the file type tree widget
+     * Column numbers for the locate list
      **/
     enum PatternSearchResultColumns
     {
@@ -139,64 +158,6 @@ namespace QDirStat
     };
 
 
-    /**
-     * Item class for the locate list (which is really a tree widget),
-     * representing one directory that contains files with the desired
-     * pattern.
-     *
-     * This item intentionally does not store a FileInfo or DirInfo pointer
-     * for each search result, but its path. This is more expensive to store,
-     * and the corresponding DirInfo * has to be fetched again with
-     * DirTree::locate() (which is an expensive operation), but it is a lot
-     * safer in case the tree is modified, i.e. if the user starts cleanup
-     * operations or refreshes the tree from disk: Not only are no pointers
-     * stored that might become invalid, but the search result remains valid
-     * even after such an operation since the strings (the paths) will still
-     * match an object in the tree in most cases.
-     *
-     * In the worst case, the search result won't find the corresponding
-     * DirInfo * anymore (if that directory branch was deleted), but for sure
-     * it will not crash.
-     **/
-    class PatternSearchResultItem final : public QTreeWidgetItem
-    {
-    public:
-
-	/**
-	 * Constructor.
-	 **/
-	PatternSearchResultItem( const QString & path, int count, FileSize totalSize );
-
-	/**
-	 * Getters for the item properties.
-	 **/
-	const QString & path()       const { return _path; }
-	int             count()      const { return _count; }
-	FileSize        totalSize()  const { return _totalSize; }
-
-
-    protected:
-
-	/**
-	 * Override the model data, just for the tooltip for the
-	 * directory column.
-	 **/
-	QVariant data( int column, int role ) const override;
-
-	/**
-	 * Less-than operator for sorting.
-	 **/
-	bool operator<( const QTreeWidgetItem & other ) const override;
-
-
-    private:
-
-	QString  _path;
-	int      _count;
-	FileSize _totalSize;
-
-    };	// class PatternSearchResultItem
-
 }	// namespace QDirStat
 
 #endif	// LocateFileTypeWindow_h
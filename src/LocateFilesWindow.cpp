@@ -11,10 +11,10 @@
 
 #include "LocateFilesWindow.h"
 #include "ActionManager.h"
-#include "DirTreeModel.h"       // itemTypeIcon()
-#include "Exception.h"
-#include "FileInfoIterator.h"
+#include "DirTreeModel.h"       // dirTreeIconSize()
+#include "FileInfo.h"
 #include "FormatUtil.h"
+#include "LocateListModel.h"
 #include "MainWindow.h"
 #include "QDirStatApp.h"        // SelectionModel, DirTreeModel, mainWindow()
 #include "SelectionModel.h"
@@ -41,23 +41,6 @@ namespace
     }
 
 
-    /**
-     * Locate one of the items in this list results in the main window's
-     * tree and treemap widgets via their SelectionModel.
-     **/
-    void locateInMainWindow( QTreeWidgetItem * item )
-    {
-	if ( !item )
-	    return;
-
-	LocateListItem * searchResult = dynamic_cast<LocateListItem *>( item );
-	CHECK_DYNAMIC_CAST( searchResult, "LocateListItem" );
-
-	// logDebug() << "Locating " << searchResult->path() << " in tree" << Qt::endl;
-	app()->selectionModel()->setCurrentItemPath( searchResult->path() );
-    }
-
-
     /**
      * Add the hotkeys (shortcuts) of the cleanup actions to this window.
      **/
@@ -70,17 +53,15 @@ namespace
 
 
     /**
-     * One-time initialization of the tree widget.
+     * One-time initialization of the model and the tree view.
      **/
-    void initTree( QTreeWidget * tree )
+    void initTree( LocateListModel * model, QTreeView * tree )
     {
-//	app()->dirTreeModel()->setTreeIconSize( tree );
-
-	QTreeWidgetItem * headerItem = tree->headerItem();
-	headerItem->setText( LL_SizeCol,  QObject::tr( "Total Size" ) );
-	headerItem->setText( LL_MTimeCol, QObject::tr( "Last Modified" ) );
-	headerItem->setText( LL_PathCol,  QObject::tr( "Path" ) );
-	headerItem->setTextAlignment( LL_PathCol, Qt::AlignLeft | Qt::AlignVCenter);
+	// The columns must be added in the order of LocateListColumns
+	model->addColumn( LF_Size,  QObject::tr( "Total Size" ),    Qt::AlignRight );
+	model->addColumn( LF_MTime, QObject::tr( "Last Modified" ), Qt::AlignHCenter );
+	model->addColumn( LF_Path,  QObject::tr( "Path" ),          Qt::AlignLeft );
+	tree->setModel( model );
 
 	QHeaderView * header = tree->header();
 	header->setDefaultAlignment( Qt::AlignHCenter | Qt::AlignVCenter );
@@ -96,6 +77,7 @@ LocateFilesWindow::LocateFilesWindow( TreeWalker * treeWalker,
                                       QWidget    * parent ):
     QDialog{ parent },
     _ui{ new Ui::LocateFilesWindow },
+    _model{ new LocateListModel{ this } },
     _treeWalker{ treeWalker }
 {
     // logDebug() << "init" << Qt::endl;
@@ -104,7 +86,7 @@ LocateFilesWindow::LocateFilesWindow( TreeWalker * treeWalker,
 
     _ui->setupUi( this );
 
-    initTree( _ui->treeWidget );
+    initTree( _model, _ui->treeView );
     addCleanupHotkeys( this );
     _ui->resultsLabel->setText( QString{} );
 
@@ -113,10 +95,20 @@ LocateFilesWindow::LocateFilesWindow( TreeWalker * treeWalker,
     connect( _ui->refreshButton, &QPushButton::clicked,
              this,               &LocateFilesWindow::refresh );
 
-    connect( _ui->treeWidget,    &QTreeWidget::customContextMenuRequested,
+    connect( _ui->treeView,      &QTreeView::customContextMenuRequested,
              this,               &LocateFilesWindow::itemContextMenu );
 
-    connect( _ui->treeWidget, &QTreeWidget::currentItemChanged, &locateInMainWindow );
+    connect( _ui->treeView->selectionModel(), &QItemSelectionModel::currentChanged,
+             this,                            &LocateFilesWindow::locateInMainWindow );
+
+    connect( &_walkRunner,       &TreeWalkRunner::resultsFound,
+             this,               &LocateFilesWindow::addResults );
+
+    connect( &_walkRunner,       &TreeWalkRunner::finished,
+             this,               &LocateFilesWindow::searchFinished );
+
+    connect( &_walkRunner, &TreeWalkRunner::aborted, this, [ this ]()
+	{ showResultsCount( _model->rowCount(), false, _ui->resultsLabel ); } );
 }
 
 
@@ -133,7 +125,11 @@ LocateFilesWindow * LocateFilesWindow::sharedInstance( TreeWalker * treeWalker )
     static QPointer<LocateFilesWindow> _sharedInstance;
 
     if ( _sharedInstance )
+    {
+	// Stop any search still using the old tree walker
+	_sharedInstance->_walkRunner.cancel();
 	_sharedInstance->_treeWalker.reset( treeWalker );
+    }
     else
 	_sharedInstance = new LocateFilesWindow{ treeWalker, app()->mainWindow() };
 
@@ -160,11 +156,10 @@ void LocateFilesWindow::populateSharedInstance( TreeWalker    * treeWalker,
     LocateFilesWindow * instance = sharedInstance( treeWalker );
 
     // Set the heading and sort order for each new populate command
-    instance->_ui->treeWidget->sortByColumn( sortCol, sortOrder );
+    instance->_ui->treeView->sortByColumn( sortCol, sortOrder );
     instance->setHeadingText( headingText );
     instance->populate( fileInfo );
 
-    // Show now so the BusyPopup is not obscured
     instance->show();
     instance->raise();
 }
@@ -174,50 +169,60 @@ void LocateFilesWindow::populate( FileInfo * fileInfo )
 {
     // logDebug() << "populating with " << fileInfo << Qt::endl;
 
-    _ui->treeWidget->clear();
-    _ui->treeWidget->setIconSize( app()->dirTreeModel()->dirTreeIconSize() );
+    _model->clear();
+    _ui->treeView->setIconSize( app()->dirTreeModel()->dirTreeIconSize() );
 
     _subtree = fileInfo;
-    _treeWalker->prepare( fileInfo );
-
-    populateRecursive( fileInfo );
-    showResultsCount( _ui->treeWidget->topLevelItemCount(), _treeWalker->overflow(), _ui->resultsLabel );
 
     // Force a redraw of the header from the status tip
     _ui->heading->setStatusTip( _headingText.arg( fileInfo ? replaceCrLf( fileInfo->url() ) : QString{} ) );
     showElidedLabel( _ui->heading, this );
 
+    _ui->resultsLabel->setText( tr( "Searching..." ) );
+    _walkRunner.start( _treeWalker.get(), fileInfo );
+}
+
+
+void LocateFilesWindow::addResults( const QVector<FileInfo *> & results )
+{
+    // Add each batch at once, so it is only sorted into the list once
+    LocateListResults items;
+    items.reserve( results.size() );
+    for ( FileInfo * item : results )
+	items << LocateListResult{ item, item->totalSize(), item->mtime(), 0, QString{}, QIcon{} };
+    _model->addResults( items );
+}
+
+
+void LocateFilesWindow::searchFinished()
+{
+    showResultsCount( _model->rowCount(), _walkRunner.overflow(), _ui->resultsLabel );
+
     // Select the first row after a delay so it (and its signals) doesn't slow down the list showing
     QTimer::singleShot( 50, this, [ this ]()
-	{ _ui->treeWidget->setCurrentItem( _ui->treeWidget->topLevelItem( 0 ) ); } );
+	{ _ui->treeView->setCurrentIndex( _model->index( 0, 0 ) ); } );
 }
 
 
-void LocateFilesWindow::populateRecursive( FileInfo * dir )
+void LocateFilesWindow::locateInMainWindow( const QModelIndex & current )
 {
-    if ( !dir )
+    if ( !current.isValid() )
 	return;
 
-    for ( DotEntryIterator it{ dir }; *it; ++it )
-    {
-	if ( _treeWalker->check( *it ) )
-	    _ui->treeWidget->addTopLevelItem( new LocateListItem{ *it } );
-
-	if ( it->hasChildren() )
-	    populateRecursive( *it );
-    }
+    // logDebug() << "Locating " << _model->path( current ) << " in tree" << Qt::endl;
+    app()->selectionModel()->setCurrentItemPath( _model->path( current ) );
 }
 
 
 void LocateFilesWindow::itemContextMenu( const QPoint & pos )
 {
     // See if the right click was actually on an item
-    if ( !_ui->treeWidget->itemAt( pos ) )
+    if ( !_ui->treeView->indexAt( pos ).isValid() )
 	return;
 
     QMenu * menu = ActionManager::createMenu( { "actionCopyPath", "actionMoveToTrash" },
                                               { ActionManager::separator(), ActionManager::cleanups() } );
-    menu->exec( _ui->treeWidget->mapToGlobal( pos ) );
+    menu->exec( _ui->treeView->viewport()->mapToGlobal( pos ) );
 }
 
 
@@ -229,61 +234,3 @@ bool LocateFilesWindow::event( QEvent * event )
     return QDialog::event( event );
 }
 
-
-
-
-LocateListItem::LocateListItem( FileInfo * item ):
-    QTreeWidgetItem{ UserType },
-    _size{ item->totalSize() },
-    _mtime{ item->mtime() },
-    _path{ item->url() }
-{
-    /**
-     * Helper function to set the text and text alignment for a column.
-     **/
-    const auto set = [ this ]( int col, Qt::Alignment alignment, const QString & text )
-    {
-	setText( col, text );
-	setTextAlignment( col, alignment | Qt::AlignVCenter );
-    };
-
-    set( LL_SizeCol,  Qt::AlignRight,   formatSize( _size ) );
-    set( LL_MTimeCol, Qt::AlignHCenter, formatTime( _mtime ) );
-    set( LL_PathCol,  Qt::AlignLeft,    replaceCrLf( _path ) );
-
-    setIcon( LL_PathCol, app()->dirTreeModel()->itemTypeIcon( item ) );
-}
-
-
-QVariant LocateListItem::data( int column, int role ) const
-{
-    // This is just for the tooltip for elided values in the path column
-    if ( role != Qt::ToolTipRole || column != LL_PathCol )
-	return QTreeWidgetItem::data( column, role );
-
-    if ( !hasLineBreak( _path ) )
-	return tooltipForElided( this, LL_PathCol, 0 );
-
-    return pathTooltip( _path );
-}
-
-
-bool LocateListItem::operator<( const QTreeWidgetItem & rawOther ) const
-{
-    if ( !treeWidget() )
-	return QTreeWidgetItem::operator<( rawOther );
-
-    // Since this is a reference, the dynamic_cast will throw a std::bad_cast
-    // exception if it fails. Not catching this here since this is a genuine
-    // error which should not be silently ignored.
-    const LocateListItem & other = dynamic_cast<const LocateListItem &>( rawOther );
-
-    switch ( treeWidget()->sortColumn() )
-    {
-	case LL_SizeCol:  return _size  < other.size();
-	case LL_MTimeCol: return _mtime < other.mtime();
-	default:          return QTreeWidgetItem::operator<( rawOther );
-    }
-
-
-}
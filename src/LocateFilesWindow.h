@@ -13,15 +13,15 @@
 #include <memory>
 
 #include <QDialog>
-#include <QTreeWidgetItem>
 
 #include "ui_locate-files-window.h"
 #include "Subtree.h"
-#include "Typedefs.h" // FileSize
+#include "TreeWalkRunner.h"
 
 
 namespace QDirStat
 {
+    class LocateListModel;
     class TreeWalker;
 
     /**
@@ -90,6 +90,21 @@ namespace QDirStat
 	 **/
 	void itemContextMenu( const QPoint & pos );
 
+	/**
+	 * Add a batch of search results to the list.
+	 **/
+	void addResults( const QVector<FileInfo *> & results );
+
+	/**
+	 * Notification that the search is finished.
+	 **/
+	void searchFinished();
+
+	/**
+	 * Locate the result at 'current' in the main window.
+	 **/
+	void locateInMainWindow( const QModelIndex & current );
+
 
     protected:
 
@@ -105,18 +120,11 @@ namespace QDirStat
 	 * Populate the window: use the TreeWalker to find matching tree items
 	 * in 'fileInfo'.
 	 *
-	 * This clears the old search results first, then searches the subtree
-	 * and populates the search result list with the items where
-	 * TreeWalker::check() returns 'true'.
+	 * This clears the old search results first, then starts the search in
+	 * the background.  Results are added to the list as they are found.
 	 **/
 	void populate( FileInfo * fileInfo );
 
-	/**
-	 * Recursively locate directories that contain files matching the
-	 * search suffix and create a search result item for each one.
-	 **/
-	void populateRecursive( FileInfo * dir );
-
 	/**
 	 * Detect theme changes and resize events.  These changes result in the
 	 * header label being re-elided.
@@ -130,7 +138,9 @@ namespace QDirStat
 
 	std::unique_ptr<Ui::LocateFilesWindow> _ui;
 
+	LocateListModel           * _model;
 	std::unique_ptr<TreeWalker> _treeWalker;
+	TreeWalkRunner              _walkRunner; // must be destroyed before the tree walker
 	Subtree                     _subtree;
 	QString                     _headingText;
 
@@ -138,7 +148,7 @@ namespace QDirStat
 
 
     /**
-     * Column numbers for the file type tree widget
+     * Column numbers for the locate list
      **/
     enum LocateListColumns
     {
@@ -148,63 +158,6 @@ namespace QDirStat
 	LL_ColumnCount,
     };
 
-
-    /**
-     * Item class for the locate list, representing one file with its path.
-     *
-     * This item intentionally does not store a FileInfo or DirInfo pointer
-     * for each search result, but its path. This is more expensive to store,
-     * and the corresponding DirInfo * has to be fetched again with
-     * DirTree::locate() (which is an expensive operation), but it is a lot
-     * safer in case the tree is modified, i.e. if the user starts cleanup
-     * operations or refreshes the tree from disk: Not only are no pointers
-     * stored that might become invalid, but the search result remains valid
-     * even after such an operation since the strings (the paths) will still
-     * match an object in the tree in most cases.
-     *
-     * In the worst case, the search result won't find the corresponding
-     * FileInfo * anymore (if that directory branch was deleted), but for sure
-     * it will not crash.
-     **/
-    class LocateListItem final : public QTreeWidgetItem
-    {
-    public:
-
-	/**
-	 * Constructor.
-	 **/
-	LocateListItem( FileInfo * item );
-
-	/**
-	 * Getters for the item properties.
-	 **/
-	FileSize        size()  const { return _size;  }
-	time_t          mtime() const { return _mtime; }
-	const QString & path()  const { return _path;  }
-
-
-    protected:
-
-	/**
-	 * Override the model data, just for the tooltip for the path
-	 * column.
-	 **/
-	QVariant data( int column, int role ) const override;
-
-	/**
-	 * Less-than operator for sorting.
-	 **/
-	bool operator<( const QTreeWidgetItem & other ) const override;
-
-
-    private:
-
-	FileSize _size;
-	time_t   _mtime;
-	QString  _path;
-
-    };	// class LocateListItem
-
 }	// namespace QDirStat
 
 #endif // LocateFilesWindow_h
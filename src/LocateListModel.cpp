@@ -0,0 +1,375 @@
+/*
+ *   File name: LocateListModel.cpp
+ *   Summary:   QDirStat model and view for lists of located files
+ *   License:   GPL V2 - See file LICENSE for details.
+ *
+ *   Authors:   Stefan Hundhammer <Stefan.Hundhammer@gmx.de>
+ *              Ian Nartowicz
+ */
+
+#include <algorithm> // std::inplace_merge(), std::stable_sort()
+#include <numeric>   // std::iota()
+
+#include <QHelpEvent>
+
+#include "LocateListModel.h"
+#include "DirTree.h"
+#include "DirTreeModel.h"
+#include "FileInfo.h"
+#include "FormatUtil.h"
+#include "ParallelUtil.h"
+#include "QDirStatApp.h"
+
+
+// Lists with fewer rows than this for each thread are sorted in fewer threads
+#define MIN_PART_SIZE  10000
+
+
+using namespace QDirStat;
+
+
+namespace
+{
+    /**
+     * Return the path of 'result', taken from its tree item if it hasn't
+     * been filled in yet.
+     **/
+    QString resultPath( const LocateListResult & result )
+    {
+	return result.path.isEmpty() && result.item ? result.item->url() : result.path;
+    }
+
+
+    /**
+     * Return whether 'result1' sorts before 'result2' by 'field'.
+     **/
+    bool lessThan( const LocateListResult & result1, const LocateListResult & result2, LocateListField field )
+    {
+	switch ( field )
+	{
+	    case LF_Count: return result1.count < result2.count;
+	    case LF_Size:  return result1.size  < result2.size;
+	    case LF_MTime: return result1.mtime < result2.mtime;
+	    case LF_Path:  return result1.path  < result2.path;
+	}
+
+	return false;
+    }
+
+
+    /**
+     * Return the number of parts to split 'size' rows into, one for
+     * each thread, but never so many that the parts are very small.
+     **/
+    int partCount( int size )
+    {
+	return qBound( 1, size / MIN_PART_SIZE, ParallelUtil::threadCount() );
+    }
+
+
+    /**
+     * Stable sort the rows from 'begin' to 'end' with 'compare': sort
+     * one part for each thread, then merge neighbouring parts in
+     * parallel until there is only one.
+     **/
+    template<typename Compare>
+    void parallelSort( int * begin, int * end, const Compare & compare )
+    {
+	const int size  = end - begin;
+	const int parts = partCount( size );
+	const auto boundary = [ begin, size, parts ]( int part )
+	    { return begin + static_cast<int>( 1LL * size * part / parts ); };
+
+	ParallelUtil::runParts( parts, [ &boundary, &compare ]( int part )
+	    { std::stable_sort( boundary( part ), boundary( part + 1 ), compare ); } );
+
+	for ( int width = 1; width < parts; width *= 2 )
+	{
+	    // Merge each pair of neighbouring sorted runs into one
+	    const int merges = ( parts + width - 1 ) / ( 2 * width );
+	    ParallelUtil::runParts( merges, [ &boundary, &compare, width, parts ]( int merge )
+	    {
+		const int first = 2 * width * merge;
+		const int last  = qMin( first + 2 * width, parts );
+		std::inplace_merge( boundary( first ), boundary( first + width ), boundary( last ), compare );
+	    } );
+	}
+    }
+
+} // namespace
+
+
+LocateListModel::LocateListModel( QObject * parent ):
+    QAbstractTableModel{ parent }
+{
+}
+
+
+void LocateListModel::addColumn( LocateListField field, const QString & title, Qt::Alignment alignment )
+{
+    const int column = _columns.size();
+
+    beginInsertColumns( QModelIndex{}, column, column );
+    _columns << Column{ field, title, alignment };
+    endInsertColumns();
+}
+
+
+void LocateListModel::clear()
+{
+    beginResetModel();
+    _results.clear();
+    _hasTreeItems = false;
+    endResetModel();
+}
+
+
+void LocateListModel::addResults( const LocateListResults & results )
+{
+    if ( results.isEmpty() )
+	return;
+
+    const FileInfo * firstItem = results.first().item;
+    if ( firstItem )
+    {
+	watchTree( firstItem->tree() );
+	_hasTreeItems = true;
+    }
+
+    const int first = _results.size();
+    beginInsertRows( QModelIndex{}, first, first + results.size() - 1 );
+    _results << results;
+    endInsertRows();
+
+    // Keep the list sorted
+    if ( _sortColumn >= 0 )
+	sortRows( first );
+}
+
+
+QString LocateListModel::path( const QModelIndex & index ) const
+{
+    if ( !index.isValid() || index.row() >= _results.size() )
+	return QString{};
+
+    return resultPath( _results.at( index.row() ) );
+}
+
+
+QVariant LocateListModel::data( const QModelIndex & index, int role ) const
+{
+    if ( !index.isValid() || index.row() >= _results.size() || index.column() >= _columns.size() )
+	return QVariant{};
+
+    const LocateListResult & result = _results.at( index.row() );
+    const Column           & column = _columns.at( index.column() );
+
+    switch ( role )
+    {
+	case Qt::DisplayRole:
+	    switch ( column.field )
+	    {
+		case LF_Count: return formatCount( result.count );
+		case LF_Size:  return formatSize( result.size );
+		case LF_MTime: return formatTime( result.mtime );
+		case LF_Path:  return replaceCrLf( resultPath( result ) );
+	    }
+	    return QVariant{};
+
+	case Qt::TextAlignmentRole:
+	    return QVariant{ Qt::AlignVCenter | column.alignment };
+
+	case Qt::DecorationRole:
+	    if ( column.field != LF_Path )
+		return QVariant{};
+
+	    return result.item ? app()->dirTreeModel()->itemTypeIcon( result.item ) : result.icon;
+
+	case Qt::ToolTipRole:
+	{
+	    // Tooltips for elided paths are handled in the view
+	    if ( column.field != LF_Path )
+		return QVariant{};
+
+	    const QString path = resultPath( result );
+	    if ( hasLineBreak( path ) )
+		return pathTooltip( path );
+
+	    return QVariant{};
+	}
+
+	default:
+	    return QVariant{};
+    }
+}
+
+
+QVariant LocateListModel::headerData( int section, Qt::Orientation orientation, int role ) const
+{
+    if ( orientation != Qt::Horizontal || section < 0 || section >= _columns.size() )
+	return QAbstractTableModel::headerData( section, orientation, role );
+
+    switch ( role )
+    {
+	case Qt::DisplayRole:
+	    return _columns.at( section ).title;
+
+	case Qt::TextAlignmentRole:
+	    if ( _columns.at( section ).field == LF_Path )
+		return QVariant{ Qt::AlignVCenter | Qt::AlignLeft };
+
+	    return QVariant{ Qt::AlignVCenter | Qt::AlignHCenter };
+
+	default:
+	    return QVariant{};
+    }
+}
+
+
+void LocateListModel::sort( int column, Qt::SortOrder order )
+{
+    _sortColumn = column < _columns.size() ? column : -1;
+    _sortOrder  = order;
+
+    if ( _sortColumn >= 0 )
+	sortRows( 0 );
+}
+
+
+void LocateListModel::sortRows( int first )
+{
+    const LocateListField field = _columns.at( _sortColumn ).field;
+
+    // The paths are needed for sorting, but are cached for showing them later
+    if ( field == LF_Path )
+	fillPaths( first );
+
+    const LocateListResult * results = _results.constData();
+    const bool ascending = _sortOrder == Qt::AscendingOrder;
+    const auto compare = [ results, field, ascending ]( int row1, int row2 )
+    {
+	return ascending ? lessThan( results[ row1 ], results[ row2 ], field ) :
+	                   lessThan( results[ row2 ], results[ row1 ], field );
+    };
+
+    // Sort the rows from 'first' on, then merge them with the rows that are already sorted
+    QVector<int> rows( _results.size() );
+    std::iota( rows.begin(), rows.end(), 0 );
+    parallelSort( rows.data() + first, rows.data() + rows.size(), compare );
+    std::inplace_merge( rows.begin(), rows.begin() + first, rows.end(), compare );
+
+    reorder( rows );
+}
+
+
+void LocateListModel::fillPaths( int first )
+{
+    // Make sure the list isn't shared before writing to it from other threads
+    LocateListResult * results = _results.data();
+    const int size  = _results.size() - first;
+    const int parts = partCount( size );
+
+    ParallelUtil::runParts( parts, [ results, first, size, parts ]( int part )
+    {
+	const int begin = first + static_cast<int>( 1LL * size * part / parts );
+	const int end   = first + static_cast<int>( 1LL * size * ( part + 1 ) / parts );
+	for ( int i = begin; i < end; ++i )
+	{
+	    LocateListResult & result = results[ i ];
+	    if ( result.path.isEmpty() && result.item )
+		result.path = result.item->url();
+	}
+    } );
+}
+
+
+void LocateListModel::reorder( const QVector<int> & rows )
+{
+    emit layoutAboutToBeChanged( QList<QPersistentModelIndex>{}, QAbstractItemModel::VerticalSortHint );
+
+    LocateListResults results;
+    results.reserve( rows.size() );
+    for ( int row : rows )
+	results << std::move( _results[ row ] );
+    _results.swap( results );
+
+    // Move the persistent indexes, such as the current item, to the new rows
+    const QModelIndexList oldIndexes = persistentIndexList();
+    if ( !oldIndexes.isEmpty() )
+    {
+	QVector<int> newRows( rows.size() );
+	for ( int i = 0; i < rows.size(); ++i )
+	    newRows[ rows[ i ] ] = i;
+
+	QModelIndexList newIndexes;
+	newIndexes.reserve( oldIndexes.size() );
+	for ( const QModelIndex & oldIndex : oldIndexes )
+	    newIndexes << index( newRows[ oldIndex.row() ], oldIndex.column() );
+
+	changePersistentIndexList( oldIndexes, newIndexes );
+    }
+
+    emit layoutChanged( QList<QPersistentModelIndex>{}, QAbstractItemModel::VerticalSortHint );
+}
+
+
+void LocateListModel::resolvePaths()
+{
+    // Nothing to do if the paths have already been resolved for an earlier change
+    if ( !_hasTreeItems )
+	return;
+
+    _hasTreeItems = false;
+    fillPaths( 0 );
+
+    for ( LocateListResult & result : _results )
+    {
+	if ( result.item )
+	{
+	    result.icon = app()->dirTreeModel()->itemTypeIcon( result.item );
+	    result.item = nullptr;
+	}
+    }
+}
+
+
+void LocateListModel::watchTree( DirTree * tree )
+{
+    if ( tree == _tree )
+	return;
+
+    if ( _tree )
+	disconnect( _tree, nullptr, this, nullptr );
+
+    _tree = tree;
+    if ( !tree )
+	return;
+
+    // All these are sent before the tree is changed
+    connect( tree, &DirTree::clearing,         this, &LocateListModel::resolvePaths );
+    connect( tree, &DirTree::clearingSubtree,  this, &LocateListModel::resolvePaths );
+    connect( tree, &DirTree::deletingChildren, this, &LocateListModel::resolvePaths );
+    connect( tree, &DirTree::startingReading,  this, &LocateListModel::resolvePaths );
+    connect( tree, &DirTree::startingRefresh,  this, &LocateListModel::resolvePaths );
+}
+
+
+
+
+bool LocateListView::viewportEvent( QEvent * event )
+{
+    if ( event && event->type() == QEvent::ToolTip )
+    {
+	const QHelpEvent * helpEvent = static_cast<QHelpEvent *>( event );
+	const QModelIndex index = indexAt( helpEvent->pos() );
+	if ( index.isValid() )
+	{
+	    // Show a tooltip when the model provides one or when the column is elided
+	    tooltipForElided( visualRect( index ), sizeHintForIndex( index ), model(), index, helpEvent->globalPos() );
+
+	    return true;
+	}
+    }
+
+    return QTreeView::viewportEvent( event );
+}
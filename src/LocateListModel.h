@@ -0,0 +1,225 @@
+/*
+ *   File name: LocateListModel.h
+ *   Summary:   QDirStat model and view for lists of located files
+ *   License:   GPL V2 - See file LICENSE for details.
+ *
+ *   Authors:   Stefan Hundhammer <Stefan.Hundhammer@gmx.de>
+ *              Ian Nartowicz
+ */
+
+#ifndef LocateListModel_h
+#define LocateListModel_h
+
+#include <QAbstractTableModel>
+#include <QIcon>
+#include <QPointer>
+#include <QTreeView>
+#include <QVector>
+
+#include "Typedefs.h" // FileSize
+
+
+namespace QDirStat
+{
+    class DirTree;
+    class FileInfo;
+
+    /**
+     * The kinds of values that can be shown in a LocateListModel column.
+     **/
+    enum LocateListField
+    {
+	LF_Count,
+	LF_Size,
+	LF_MTime,
+	LF_Path,
+    };
+
+
+    /**
+     * One row of a LocateListModel: a tree item with the values to show
+     * for it.  The path is only filled in when it is needed.  Once the
+     * tree changes, the item pointer is cleared and the path and icon
+     * are kept instead.
+     **/
+    struct LocateListResult
+    {
+	FileInfo * item;
+	FileSize   size;
+	time_t     mtime;
+	int        count;
+	QString    path;
+	QIcon      icon;
+    };
+    typedef QVector<LocateListResult> LocateListResults;
+
+
+    /**
+     * Model for a flat list of search results, such as in the "Locate
+     * Files" windows.
+     *
+     * The results are stored as tree items with their sort keys, rather
+     * than as widget items, and each row is only formatted when a view
+     * asks for it.  Sorting sorts the rows in parallel.  Results added
+     * to a sorted list are merged into it in order.
+     *
+     * Before the tree is changed, the path of every result is resolved
+     * so that no pointers into the tree are kept.  The results can then
+     * still be located by path once the tree has been read again.
+     **/
+    class LocateListModel final : public QAbstractTableModel
+    {
+	Q_OBJECT
+
+    public:
+
+	/**
+	 * Constructor.  The model has no columns until they are added
+	 * with addColumn().
+	 **/
+	LocateListModel( QObject * parent );
+
+	/**
+	 * Add a column showing 'field' with the header 'title' and the
+	 * text aligned with 'alignment'.
+	 **/
+	void addColumn( LocateListField field, const QString & title, Qt::Alignment alignment );
+
+	/**
+	 * Remove all the results.
+	 **/
+	void clear();
+
+	/**
+	 * Add 'results' to the list.
+	 **/
+	void addResults( const LocateListResults & results );
+
+	/**
+	 * Return the path of the result for 'index'.
+	 **/
+	QString path( const QModelIndex & index ) const;
+
+	/**
+	 * Return the number of rows (results) or columns.
+	 *
+	 * Implemented from QAbstractItemModel.
+	 **/
+	int rowCount( const QModelIndex & parent = QModelIndex{} ) const override
+	    { return parent.isValid() ? 0 : _results.size(); }
+	int columnCount( const QModelIndex & parent = QModelIndex{} ) const override
+	    { return parent.isValid() ? 0 : _columns.size(); }
+
+	/**
+	 * Return data to be displayed for the specified model index and
+	 * role.
+	 *
+	 * Implemented from QAbstractItemModel.
+	 **/
+	QVariant data( const QModelIndex & index, int role ) const override;
+
+	/**
+	 * Return header data for the specified section, orientation, and
+	 * role.
+	 *
+	 * Reimplemented from QAbstractItemModel.
+	 **/
+	QVariant headerData( int section, Qt::Orientation orientation, int role ) const override;
+
+	/**
+	 * Sort the results by 'column'.
+	 *
+	 * Reimplemented from QAbstractItemModel.
+	 **/
+	void sort( int column, Qt::SortOrder order = Qt::AscendingOrder ) override;
+
+
+    protected slots:
+
+	/**
+	 * Fill in the path and icon of every result and forget the tree
+	 * items.  Called before the tree is changed.
+	 **/
+	void resolvePaths();
+
+
+    protected:
+
+	/**
+	 * Sort the rows from 'first' on by the current sort column and
+	 * merge them with the rows before them, which must already be
+	 * sorted.
+	 **/
+	void sortRows( int first );
+
+	/**
+	 * Fill in the path of every result from 'first' on that doesn't
+	 * have one yet.
+	 **/
+	void fillPaths( int first );
+
+	/**
+	 * Put the rows in the order 'rows', where each entry is the
+	 * current row of the result to move to that position, and update
+	 * any persistent indexes.
+	 **/
+	void reorder( const QVector<int> & rows );
+
+	/**
+	 * Connect to 'tree' to resolve the paths before it changes.
+	 **/
+	void watchTree( DirTree * tree );
+
+
+    private:
+
+	struct Column
+	{
+	    LocateListField field;
+	    QString         title;
+	    Qt::Alignment   alignment;
+	};
+
+	QVector<Column>   _columns;
+	LocateListResults _results;
+	QPointer<DirTree> _tree;
+	int               _sortColumn{ -1 };
+	bool              _hasTreeItems{ false };  // some results still point into the tree
+	Qt::SortOrder     _sortOrder{ Qt::AscendingOrder };
+
+    };	// class LocateListModel
+
+
+    /**
+     * Tree view for a LocateListModel.  This only adds tooltips for
+     * elided values.
+     **/
+    class LocateListView final : public QTreeView
+    {
+	Q_OBJECT
+
+    public:
+
+	/**
+	 * Constructor.
+	 **/
+	LocateListView( QWidget * parent = nullptr ):
+	    QTreeView{ parent }
+	{}
+
+
+    protected:
+
+	/**
+	 * Event handler for the viewport, to show tooltips for elided
+	 * values.
+	 *
+	 * Reimplemented from QAbstractScrollArea.
+	 **/
+	bool viewportEvent( QEvent * event ) override;
+
+    };	// class LocateListView
+
+}	// namespace QDirStat
+
+#endif	// ifndef LocateListModel_h
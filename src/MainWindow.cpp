@@ -8,6 +8,7 @@
  */
 
 #include <QClipboard>
+#include <QFile>
 #include <QFileDialog>
 #include <QMessageBox>
 
@@ -184,6 +185,9 @@ void MainWindow::connectSignals( DirTree        * dirTree,
     connect( selectionModel,           &SelectionModel::currentItemChanged,
              this,                     &MainWindow::currentItemChanged );
 
+    connect( selectionModel,           &SelectionModel::currentItemChanged,
+             dirTree,                  &DirTree::prioritize );
+
     // Connect here so this is called after MainWindow::updateActions
     connect( selectionModel,           &SelectionModel::selectionChanged,
                                        &ActionManager::updateActions );
@@ -709,6 +713,26 @@ void MainWindow::askReadCache()
 }
 
 
+void MainWindow::resumeScan()
+{
+    DirTree * tree = app()->dirTree();
+    tree->clear();
+    tree->reset();
+    _historyButtons->clear();
+    _ui->breadcrumbNavigator->clear();
+
+    _stopWatch.start();
+
+    if ( !tree->resumeReading() )
+    {
+	idleDisplay();
+	QMessageBox::warning( this, tr( "Error" ), tr( "Can't resume the scan from " ) + DirTree::checkpointFileName() );
+    }
+
+    updateActions();
+}
+
+
 void MainWindow::askWriteCache()
 {
     const QString fileName =
@@ -1040,6 +1064,7 @@ void MainWindow::updateActions()
     _ui->actionStopReading->setEnabled  ( reading );
     _ui->actionRefreshAll->setEnabled   ( isTree );
     _ui->actionAskReadCache->setEnabled ( !reading );
+    _ui->actionResumeScan->setEnabled   ( !reading && QFile::exists( DirTree::checkpointFileName() ) );
     _ui->actionAskWriteCache->setEnabled( isTree && !pkgView && firstToplevel->isDirInfo() );
 
     const FileInfoSet selectedItems = app()->selectionModel()->selectedItems();
@@ -192,6 +192,12 @@ namespace QDirStat
          **/
         void askReadCache();
 
+        /**
+         * Clear the current tree and replace it with the checkpoint of a
+         * scan that was interrupted, then continue reading it.
+         **/
+        void resumeScan();
+
         /**
          * Open a file selection dialog and save the current tree to the selected
          * file.
@@ -52,6 +52,7 @@ void MainWindow::connectMenuActions()
     connectAction( _ui->actionContinueReading,    &MainWindow::refreshSelected );
     connectAction( _ui->actionStopReading,        &MainWindow::stopReading );
     connectAction( _ui->actionAskReadCache,       &MainWindow::askReadCache );
+    connectAction( _ui->actionResumeScan,         &MainWindow::resumeScan );
     connectAction( _ui->actionAskWriteCache,      &MainWindow::askWriteCache );
     // actionQuit, see .ui file
 
@@ -7,6 +7,8 @@
  *              Ian Nartowicz
  */
 
+#include <algorithm> // fill()
+
 #include <QElapsedTimer>
 
 #include "MimeCategorizer.h"
@@ -140,6 +142,15 @@ QColor MimeCategorizer::color( const FileInfo * item )
 }
 
 
+quint8 MimeCategorizer::categoryIndex( const FileInfo * item )
+{
+    const QReadLocker locker{ &_lock };
+
+    const MimeCategory * matchedCategory = category( item );
+    return matchedCategory ? _categoryIndexes.value( matchedCategory, UncategorisedIndex ) : NoCategoryIndex;
+}
+
+
 const MimeCategory * MimeCategorizer::category( const FileInfo * item,
                                                 QString        & pattern,
                                                 bool           & caseInsensitive )
@@ -371,6 +382,27 @@ void MimeCategorizer::buildMaps()
 }
 
 
+void MimeCategorizer::buildPalette()
+{
+    _categoryIndexes.clear();
+
+    // Anything without a valid index is drawn the same as uncategorised files
+    std::fill( std::begin( _palette ), std::end( _palette ), QColor{ Qt::white }.rgb() );
+
+    int index = FirstCategoryIndex;
+    for ( const MimeCategory * category : asConst( _categories ) )
+    {
+	// Any categories past the end of the palette will be looked up every time
+	if ( index >= CategoryIndexCount )
+	    break;
+
+	_categoryIndexes.insert( category, static_cast<quint8>( index ) );
+	_palette[ index ] = category->color().rgb();
+	++index;
+    }
+}
+
+
 void MimeCategorizer::addExactKeys( const MimeCategory * category )
 {
     for ( const QString & key : category->caseSensitiveExactList() )
@@ -485,12 +517,16 @@ void MimeCategorizer::readSettings()
     ensureMandatoryCategories();
 
     buildMaps();
+    buildPalette();
 }
 
 
 void MimeCategorizer::replaceCategories( const MimeCategoryList & categories )
 {
-   _lock.lockForWrite();
+    // Anything reading the palette without the lock has to stop before it changes
+    emit categoriesChanging();
+
+    _lock.lockForWrite();
     writeSettings( categories );
     readSettings();
     _lock.unlock();
@@ -11,6 +11,8 @@
 #define MimeCategorizer_h
 
 #include <QBitArray>
+#include <QColor>
+#include <QHash>
 #include <QObject>
 #include <QReadWriteLock>
 #include <QVector>
@@ -41,6 +43,20 @@ namespace QDirStat
     typedef QVector<WildcardCategory>             WildcardList;
 
 
+    /**
+     * Special values for the category index stored in each FileInfo.
+     * Indexes from FirstCategoryIndex upwards refer to the categories
+     * in the order they are configured.
+     **/
+    enum CategoryIndex
+    {
+	UncategorisedIndex = 0,		// not looked up yet
+	NoCategoryIndex    = 1,		// doesn't match any category
+	FirstCategoryIndex = 2,
+	CategoryIndexCount = 256,	// one byte in FileInfo
+    };
+
+
     /**
      * Class to determine the MimeCategory of filenames.
      *
@@ -125,6 +141,27 @@ namespace QDirStat
 	 **/
 	QColor color( const FileInfo * item );
 
+	/**
+	 * Return the category index for a FileInfo item, to be stored in
+	 * the item and used with paletteColor() later.  Returns
+	 * NoCategoryIndex if the item doesn't fit into any of the
+	 * categories, or UncategorisedIndex if there are too many
+	 * categories to store its index.
+	 *
+	 * This function is mutex-protected.
+	 **/
+	quint8 categoryIndex( const FileInfo * item );
+
+	/**
+	 * Return the colour for a category index from categoryIndex().
+	 * This is a plain array lookup without any locking, used by the
+	 * treemap render threads.  The palette is only written in the
+	 * main thread between the categoriesChanging() and
+	 * categoriesChanged() signals, so any other thread calling this
+	 * must have stopped when categoriesChanging() returns.
+	 **/
+	QColor paletteColor( quint8 index ) const { return QColor{ _palette[ index ] }; }
+
 	/**
 	 * Return the MimeCategory for a filename or 0 if it doesn't fit into
 	 * any of the available categories.
@@ -176,6 +213,12 @@ namespace QDirStat
 
     signals:
 
+	/**
+	 * Emitted when changes from the settings dialogue are about to be
+	 * applied, before the palette and category indexes change.
+	 **/
+	void categoriesChanging();
+
 	/**
 	 * Emitted when changes are applied from the settings dialogue.
 	 **/
@@ -221,6 +264,12 @@ namespace QDirStat
 	 **/
 	void buildMaps();
 
+	/**
+	 * Number the categories and build the palette of category colours
+	 * for each index.
+	 **/
+	void buildPalette();
+
 	/**
 	 * Add all patterns with no wildcards (exact filename match) to either
 	 * the case-sensitive map or the case-insensitive map, and also to a
@@ -326,6 +375,9 @@ namespace QDirStat
 	QBitArray           _caseInsensitiveLengths;
 	QBitArray           _caseSensitiveLengths;
 
+	QHash<const MimeCategory *, quint8> _categoryIndexes;
+	QRgb                _palette[ CategoryIndexCount ];
+
 	QReadWriteLock      _lock;
 
     };	// class MimeCategorizer
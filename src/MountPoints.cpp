@@ -7,6 +7,8 @@
  *              Ian Nartowicz
  */
 
+#include <sys/sysmacros.h> // makedev()
+
 #include <QFile>
 #include <QRegularExpression>
 #include <QFileInfo>
@@ -290,6 +292,10 @@ void MountPoints::populate()
 
     checkForFuseblk( *this );
     _hasNtfs = checkForNtfs( *this );
+
+#if USE_PROC_MOUNTS
+    readDeviceNumbers();
+#endif
 }
 
 
@@ -382,6 +388,51 @@ void MountPoints::readStorageInfo()
 }
 #endif // HAVE_Q_STORAGE_INFO
 
+
+void MountPoints::readDeviceNumbers()
+{
+    QFile file{ "/proc/self/mountinfo" };
+
+    if ( !file.open( QIODevice::ReadOnly | QIODevice::Text ) )
+    {
+        logInfo() << "Can't open /proc/self/mountinfo, mount points can only be found by path" << Qt::endl;
+        return;
+    }
+
+    const QRegularExpression whitespace{ "\\s+" };
+
+    QTextStream in{ &file };
+    for ( QString line = in.readLine(); !line.isNull(); line = in.readLine() )
+    {
+        // File format (/proc/self/mountinfo):
+        //
+        //   29 1 8:6 / / rw,relatime shared:1 - ext4 /dev/sda6 rw,errors=remount-ro
+        //   45 29 8:7 / /work rw,relatime shared:27 - ext4 /dev/sda7 rw
+        //
+        // The third field is the device number and the fifth is the mount point
+
+        const QStringList fields = line.split( whitespace, Qt::SkipEmptyParts );
+        if ( fields.size() < 5 )
+            continue;
+
+        const QStringList majorMinor = fields[2].split( u':' );
+        if ( majorMinor.size() != 2 )
+            continue;
+
+        QString path = fields[4];
+        path.replace( "\\040"_L1, " "_L1 ); // escaped spaces
+
+        // Keep the first mount of each device, later ones are bind mounts or duplicates
+        MountPoint * mountPoint = value( path, nullptr );
+        const dev_t device = makedev( majorMinor[0].toUInt(), majorMinor[1].toUInt() );
+        if ( mountPoint && !_devices.contains( device ) )
+            _devices.insert( device, mountPoint );
+    }
+
+    // logDebug() << "Found device numbers for " << _devices.size() << " mount points" << Qt::endl;
+}
+
+
 QString MountPoints::device( const QString & url )
 {
     const MountPoint * mountPoint = MountPoints::findByPath( url );
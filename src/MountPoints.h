@@ -12,6 +12,9 @@
 
 #include <memory>
 
+#include <sys/types.h> // dev_t
+
+#include <QHash>
 #include <QStringList>
 #include <QTextStream>
 
@@ -272,7 +275,7 @@ namespace QDirStat
 	 * Clear the map and delete all the mountpoints.
 	 **/
 	void clear()
-	    { qDeleteAll( *this ); MountPointMap::clear(); }
+	    { qDeleteAll( *this ); MountPointMap::clear(); _devices.clear(); }
 
 
     public:
@@ -296,6 +299,19 @@ namespace QDirStat
 	 **/
 	static const MountPoint * findNearestMountPoint( const QString & path );
 
+	/**
+	 * Return the mount point of the filesystem with device number
+	 * 'device', as in the st_dev of the files on it, or 0 if it isn't
+	 * known.  If the filesystem is mounted more than once, this is the
+	 * first mount.  Ownership of the returned object is not transferred
+	 * to the caller.
+	 *
+	 * This is just a hash lookup, so it is much faster than finding the
+	 * mount point from a path.
+	 **/
+	static const MountPoint * findByDevice( dev_t device )
+	    { return instance()->_devices.value( device, nullptr ); }
+
 	/**
 	 * Return the device name where 'dir' is on if it's a mount point.
 	 * This uses MountPoints which reads /proc/mounts.
@@ -363,6 +379,12 @@ namespace QDirStat
 	void readStorageInfo();
 #endif
 
+	/**
+	 * Read the device number of each mount point from
+	 * /proc/self/mountinfo for findByDevice().
+	 **/
+	void readDeviceNumbers();
+
 	/**
 	 * Add a mount point to the map.
 	 **/
@@ -374,6 +396,8 @@ namespace QDirStat
 
 	bool _hasNtfs;
 
+	QHash<dev_t, MountPoint *> _devices;
+
     };	// class MountPoints
 
 
@@ -0,0 +1,21 @@
+/*
+ *   File name: ParallelUtil.cpp
+ *   Summary:   Utilities for splitting work across threads in QDirStat
+ *   License:   GPL V2 - See file LICENSE for details.
+ *
+ *   Authors:   Stefan Hundhammer <Stefan.Hundhammer@gmx.de>
+ *              Ian Nartowicz
+ */
+
+#include "ParallelUtil.h"
+
+
+using namespace QDirStat;
+
+
+QThreadPool * ParallelUtil::threadPool()
+{
+    // Not the global pool, which is limited to one thread for the treemap
+    static QThreadPool pool;
+    return &pool;
+}
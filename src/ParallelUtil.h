@@ -0,0 +1,61 @@
+/*
+ *   File name: ParallelUtil.h
+ *   Summary:   Utilities for splitting work across threads in QDirStat
+ *   License:   GPL V2 - See file LICENSE for details.
+ *
+ *   Authors:   Stefan Hundhammer <Stefan.Hundhammer@gmx.de>
+ *              Ian Nartowicz
+ */
+
+#ifndef ParallelUtil_h
+#define ParallelUtil_h
+
+#include <QFuture>
+#include <QThreadPool>
+#include <QVector>
+#include <QtConcurrent/QtConcurrent>
+
+
+namespace QDirStat
+{
+    /**
+     * Utilities for splitting work across threads
+     **/
+    namespace ParallelUtil
+    {
+	/**
+	 * Return the thread pool shared by all parallel calculations.
+	 **/
+	QThreadPool * threadPool();
+
+	/**
+	 * Return the most parts that are worth splitting work into.
+	 **/
+	inline int threadCount() { return threadPool()->maxThreadCount(); }
+
+	/**
+	 * Run 'task( i )' for each part number from 0 to 'count' - 1 and
+	 * wait for them all to finish.  Part 0 is run in this thread and
+	 * the others in the shared pool, so a single part never leaves this
+	 * thread.  This must not be called from a task in the shared pool.
+	 **/
+	template<typename Task>
+	void runParts( int count, const Task & task )
+	{
+	    QVector<QFuture<void>> futures;
+	    futures.reserve( count - 1 );
+	    for ( int i = 1; i < count; ++i )
+		futures << QtConcurrent::run( threadPool(), [ &task, i ]() { task( i ); } );
+
+	    if ( count > 0 )
+		task( 0 );
+
+	    for ( QFuture<void> & future : futures )
+		future.waitForFinished();
+	}
+
+    }	// namespace ParallelUtil
+
+}	// namespace QDirStat
+
+#endif // ParallelUtil_h
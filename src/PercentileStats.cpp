@@ -7,26 +7,142 @@
  *              Ian Nartowicz
  */
 
-#include <set>
+#include <algorithm> // inplace_merge(), lower_bound(), nth_element(), sort(), unique(), upper_bound()
 
 #include "PercentileStats.h"
 #include "Exception.h"
 #include "FormatUtil.h" // only needed with VERBOSE_LOGGING
+#include "ParallelUtil.h"
+#include "Typedefs.h"   // asConst
 
 
 #define VERBOSE_LOGGING 0
 
+// Don't split the data points into chunks smaller than this for separate threads
+#define MIN_CHUNK_SIZE  100000
+
 
 using namespace QDirStat;
 
 
+namespace
+{
+    /**
+     * Return the boundaries of the chunks to split 'count' data points
+     * into, from 0 to 'count', with up to one chunk for each of 'threads'.
+     **/
+    QVector<int> chunkBoundaries( int count, int threads )
+    {
+	const int chunks = qBound( 1, count / MIN_CHUNK_SIZE, threads );
+
+	QVector<int> boundaries;
+	for ( int i = 0; i <= chunks; ++i )
+	    boundaries << static_cast<int>( 1LL * count * i / chunks );
+
+	return boundaries;
+    }
+
+
+    /**
+     * Rearrange 'values' from 'start' to 'end' so that each position in
+     * the sorted list of ranks from 'firstRank' to 'lastRank' holds the
+     * value it would hold if the list was sorted.  Each selection splits
+     * the range, so the total effort grows with the logarithm of the
+     * number of ranks instead of the number of values.
+     **/
+    void selectRanks( PercentileValue * values,
+		      int               start,
+		      int               end,
+		      const int       * firstRank,
+		      const int       * lastRank )
+    {
+	if ( firstRank == lastRank )
+	    return;
+
+	const int * midRank = firstRank + ( lastRank - firstRank ) / 2;
+	std::nth_element( values + start, values + *midRank, values + end );
+
+	selectRanks( values, start, *midRank, firstRank, midRank );
+	selectRanks( values, *midRank + 1, end, midRank + 1, lastRank );
+    }
+
+} // namespace
+
+
+void PercentileStats::useSketch( PercentileCount threshold, int precisionBits )
+{
+    _sketch          = QuantileSketch{ precisionBits };
+    _sketchThreshold = threshold;
+    _sketched        = false;
+
+    if ( threshold == 0 || size() > threshold )
+	moveToSketch();
+}
+
+
+void PercentileStats::addSketch( const QuantileSketch & sketch )
+{
+    if ( !_sketched )
+	moveToSketch();
+
+    _sketch.merge( sketch );
+}
+
+
+void PercentileStats::moveToSketch()
+{
+#if VERBOSE_LOGGING
+    logDebug() << "Moving " << size() << " elements to a sketch" << Qt::endl;
+#endif
+
+    for ( PercentileValue value : asConst( *this ) )
+	_sketch.add( value );
+
+    // Release the memory as well as the values
+    clear();
+    squeeze();
+
+    _sketched = true;
+}
+
+
 void PercentileStats::sort()
 {
+    // A sketch is always in order
+    if ( _sketched )
+	return;
+
 #if VERBOSE_LOGGING
     logDebug() << "Sorting " << size() << " elements" << Qt::endl;
 #endif
 
-    std::sort( begin(), end() );
+    QVector<int> chunks = chunkBoundaries( size(), ParallelUtil::threadCount() );
+    PercentileValue * values = data();
+
+    // Sort each chunk in a separate thread
+    ParallelUtil::runParts( chunks.size() - 1, [ values, &chunks ]( int chunk )
+	{ std::sort( values + chunks.at( chunk ), values + chunks.at( chunk + 1 ) ); } );
+
+    // Merge neighbouring pairs of sorted chunks in parallel until there is only one left
+    while ( chunks.size() > 2 )
+    {
+	QVector<int> merged;
+	for ( int i = 0; i < chunks.size() - 1; i += 2 )
+	    merged << chunks.at( i );
+	merged << chunks.last();
+
+	ParallelUtil::runParts( ( chunks.size() - 1 ) / 2, [ values, &chunks ]( int pair )
+	{
+	    const int start = chunks.at( 2 * pair );
+	    const int mid   = chunks.at( 2 * pair + 1 );
+	    const int end   = chunks.at( 2 * pair + 2 );
+	    std::inplace_merge( values + start, values + mid, values + end );
+	} );
+
+	chunks = merged;
+    }
+
+    _sorted = true;
 
 #if VERBOSE_LOGGING
     logDebug() << "Sorting done." << Qt::endl;
@@ -34,10 +150,29 @@ void PercentileStats::sort()
 }
 
 
+void PercentileStats::selectPercentiles()
+{
+    // Each percentile is interpolated between the data points either side of its rank
+    QVector<int> ranks;
+    for ( int i = minPercentile(); i <= maxPercentile(); ++i )
+    {
+	const int rank = std::floor( ( size() - 1.0 ) * i / maxPercentile() );
+	ranks << rank;
+	if ( rank + 1 < size() )
+	    ranks << rank + 1;
+    }
+
+    std::sort( ranks.begin(), ranks.end() );
+    ranks.erase( std::unique( ranks.begin(), ranks.end() ), ranks.end() );
+
+    selectRanks( data(), 0, size(), ranks.cbegin(), ranks.cend() );
+}
+
+
 PercentileBoundary PercentileStats::quantile( int order, int number ) const
 {
     // Validate everything so the calculation will be safe
-    if ( isEmpty() )
+    if ( valueCount() == 0 )
 	return 0;
 
     CHECK_INDEX( order, 2, maxPercentile(), "Quantile order out of range" );
@@ -46,7 +181,11 @@ PercentileBoundary PercentileStats::quantile( int order, int number ) const
 	THROW( Exception{ QString{ "Invalid quantile #%1 for %2-quantile" }.arg( number ).arg( order ) } );
 
     // Calculate the data point rank for the number and order (C=1 algorithm, rank 1 is list index 0)
-    const double indexRank = ( size() - 1.0 ) * number / order;
+    const double indexRank = ( valueCount() - 1.0 ) * number / order;
+
+    // The sketch interpolates in the same way between its estimated values
+    if ( _sketched )
+	return _sketch.quantile( indexRank );
 
     // Separate the rank into its base integer to index the list and fraction part for interpolation
     const int    index  = std::floor( indexRank );
@@ -63,6 +202,10 @@ PercentileBoundary PercentileStats::quantile( int order, int number ) const
 
 void PercentileStats::calculatePercentiles()
 {
+    // Unsorted data only needs the values around each percentile to be in place
+    if ( !_sketched && !_sorted )
+	selectPercentiles();
+
     _percentiles.clear(); // just in case anyone calls this more than once
 
     // Calculate and store all the percentile boundaries
@@ -73,36 +216,20 @@ void PercentileStats::calculatePercentiles()
     _percentileCounts = PercentileCountList( 1 );
     _percentileSums   = PercentileValueList( 1 );
 
-    // Just keep running totals to go into the lists
-    PercentileCount count = 0;
-    PercentileValue sum   = 0;
-
-    // Iterate the percentiles as we go along, starting at percentile 1
-    auto it = _percentiles.cbegin() + 1;
-    const auto filledPercentile = [ this, &it, &count, &sum ]()
-    {
-	// Put the running totals into the lists
-	_percentileCounts.append( count );
-	_percentileSums.append( sum );
-
-	// Move on to the next percentile
-	++it;
-    };
-
-    // Iterate all the data points - should be in order, so add to each percentile in turn
-    for ( PercentileValue value : *this )
+    // Estimate the cumulative counts and sums for each percentile boundary from the sketch
+    if ( _sketched )
     {
-	// Have we gone past this percentile upper boundary?
-	while ( value > *it )
-	    filledPercentile();
+	for ( auto it = _percentiles.cbegin() + 1; it != _percentiles.cend(); ++it )
+	{
+	    PercentileValue sum;
+	    _percentileCounts.append( _sketch.countUpTo( *it, &sum ) );
+	    _percentileSums.append( sum );
+	}
 
-	++count;
-	sum += value;
+	return;
     }
 
-    // Fill trailing entries, percentiles after the last stats entry, including when no stats at all
-    while ( it != _percentiles.cend() )
-	filledPercentile();
+    countPercentiles();
 
 #if VERBOSE_LOGGING
     for ( int i=0; i < _percentileSums.size(); ++i )
@@ -117,6 +244,53 @@ void PercentileStats::calculatePercentiles()
 }
 
 
+void PercentileStats::countPercentiles()
+{
+    const int percentiles = _percentiles.size();
+
+    // Each chunk of data points gets its own count and sum for every percentile
+    const QVector<int> chunks = chunkBoundaries( size(), ParallelUtil::threadCount() );
+    const int chunkCount = chunks.size() - 1;
+    PercentileCountList chunkCounts( chunkCount * percentiles );
+    PercentileValueList chunkSums( chunkCount * percentiles );
+
+    const PercentileValue    * values     = constData();
+    const PercentileBoundary * boundaries = _percentiles.constData();
+    PercentileCount          * counts     = chunkCounts.data();
+    PercentileValue          * sums       = chunkSums.data();
+
+    ParallelUtil::runParts( chunkCount, [ &chunks, percentiles, values, boundaries, counts, sums ]( int chunk )
+    {
+	PercentileCount * partCounts = counts + chunk * percentiles;
+	PercentileValue * partSums   = sums   + chunk * percentiles;
+
+	for ( int i = chunks.at( chunk ); i < chunks.at( chunk + 1 ); ++i )
+	{
+	    // Each value is in the first percentile with a boundary no lower than the value
+	    const PercentileValue value = values[ i ];
+	    const int index = std::lower_bound( boundaries + 1, boundaries + percentiles - 1, value ) - boundaries;
+	    ++partCounts[ index ];
+	    partSums[ index ] += value;
+	}
+    } );
+
+    // Add up the chunks into running totals for the lists
+    PercentileCount count = 0;
+    PercentileValue sum   = 0;
+    for ( int i = 1; i < percentiles; ++i )
+    {
+	for ( int chunk = 0; chunk < chunkCount; ++chunk )
+	{
+	    count += counts[ chunk * percentiles + i ];
+	    sum   += sums  [ chunk * percentiles + i ];
+	}
+
+	_percentileCounts.append( count );
+	_percentileSums.append( sum );
+    }
+}
+
+
 void PercentileStats::validatePercentileIndex( int index )
 {
     CHECK_INDEX( index, minPercentile(), maxPercentile(), "Percentile index out of range" );
@@ -181,58 +355,88 @@ void PercentileStats::fillBuckets( bool logWidths, int bucketCount, int startPer
                << Qt::endl;
 #endif
 
-    // Special case: don't skip files with size equal to P0 for the first percentile/bucket
-    auto beginIt = cbegin();
-    if ( startPercentile > minPercentile() )
-    {
-	// Find the first (ie. smallest) data point that we want for the first bucket
-	while ( beginIt != cend() && *beginIt <= bucketsStart )
-	    ++beginIt;
-    }
-
-    // Find the start of the next (ie. second) bucket to use in the loop
+    // Calculate all the bucket boundaries, each from the one before
     PercentileBoundary nextBucketStart = bucketsStart;
-    const auto getNextBucketStart = [ this, logWidths, bucketWidth, &nextBucketStart ]()
+    for ( int i = 0; i <= bucketCount; ++i )
     {
-	// Add the current bucket start value to the list and find the start of the next
 	_buckets.append( nextBucketStart );
-	return logWidths ? nextBucketStart * bucketWidth : nextBucketStart + bucketWidth;
-    };
-    nextBucketStart = getNextBucketStart();
+	nextBucketStart = logWidths ? nextBucketStart * bucketWidth : nextBucketStart + bucketWidth;
 
-    // A log scaling factor doesn't work on zero, unless we actually have a zero bucket increment
-    if ( logWidths && nextBucketStart == 0 && bucketWidth > 1 )
-	nextBucketStart = 1;
+	// A log scaling factor doesn't work on zero, unless we actually have a zero bucket increment
+	if ( i == 0 && logWidths && nextBucketStart == 0 && bucketWidth > 1 )
+	    nextBucketStart = 1;
+    }
+
+    // Special case: don't skip files with size equal to P0 for the first percentile/bucket
+    const bool includeStart = startPercentile == minPercentile();
 
-    // Fill buckets from the data point we just found, up to the last requested value
-    auto bucketIt = _bucketCounts.begin();
-    for ( auto it = beginIt; it != cend() && *it <= bucketsEnd; ++it )
+    if ( _sketched )
+	fillSketchBuckets( includeStart, bucketsStart, bucketsEnd );
+    else
+	countBuckets( includeStart, bucketsStart, bucketsEnd );
+}
+
+
+void PercentileStats::countBuckets( bool               includeStart,
+				    PercentileBoundary bucketsStart,
+				    PercentileBoundary bucketsEnd )
+{
+    const int bucketCount = _bucketCounts.size();
+
+    // Each chunk of data points gets its own count for every bucket
+    const QVector<int> chunks = chunkBoundaries( size(), ParallelUtil::threadCount() );
+    const int chunkCount = chunks.size() - 1;
+    PercentileCountList chunkCounts( chunkCount * bucketCount );
+
+    const PercentileValue    * values     = constData();
+    const PercentileBoundary * boundaries = _buckets.constData();
+    PercentileCount          * counts     = chunkCounts.data();
+
+    ParallelUtil::runParts( chunkCount, [ &chunks, bucketCount, values, boundaries, counts,
+					  includeStart, bucketsStart, bucketsEnd ]( int chunk )
     {
-	// Loop through buckets until we reach the one for this data point, skipping empty buckets
-	while ( *it >= nextBucketStart )
+	PercentileCount * partCounts = counts + chunk * bucketCount;
+
+	for ( int i = chunks.at( chunk ); i < chunks.at( chunk + 1 ); ++i )
 	{
-	    // The calculated end of the last bucket might not exactly match the final data point
-	    if ( bucketIt + 1 != _bucketCounts.end() )
-	    {
-		// For most buckets, just append to the boundaries and get the start of the next bucket
-		++bucketIt;
-		nextBucketStart = getNextBucketStart();
-	    }
-	    else
-	    {
-		// The bucket start calculated after the last bucket is actually the last file size needed,
-		// so nudge it up by one, leaving the end of the last bucket equal to the last data point.
-		++nextBucketStart;
-	    }
+	    const PercentileValue value = values[ i ];
+	    if ( value > bucketsEnd || value < bucketsStart || ( value == bucketsStart && !includeStart ) )
+		continue;
+
+	    // The bucket is the number of bucket starts after the first that are no higher than the value;
+	    // the calculated end of the last bucket might not exactly match the last data point
+	    const auto it = std::upper_bound( boundaries + 1, boundaries + bucketCount, value );
+	    ++partCounts[ it - boundaries - 1 ];
 	}
+    } );
 
-	// Add a data point to this bucket
-	( *bucketIt )++;
+    for ( int i = 0; i < bucketCount; ++i )
+    {
+	for ( int chunk = 0; chunk < chunkCount; ++chunk )
+	    _bucketCounts[ i ] += counts[ chunk * bucketCount + i ];
     }
+}
+
 
-    // Add any empty trailing buckets to the bucket boundaries list
-    while ( _buckets.size() <= _bucketCounts.size() )
-	nextBucketStart = getNextBucketStart();
+void PercentileStats::fillSketchBuckets( bool               includeStart,
+					 PercentileBoundary bucketsStart,
+					 PercentileBoundary bucketsEnd )
+{
+    // The data points are integers, so those below a boundary are those up to the integer below it
+    const auto countBelow = [ this ]( PercentileBoundary boundary )
+	{ return _sketch.countUpTo( std::ceil( boundary ) - 1 ); };
+
+    PercentileCount previousCount = includeStart ? countBelow( bucketsStart ) : _sketch.countUpTo( bucketsStart );
+
+    for ( int i = 0; i < _bucketCounts.size(); ++i )
+    {
+	// The last bucket always extends to the last requested value
+	const bool lastBucket = i + 1 == _bucketCounts.size();
+	const PercentileCount count = lastBucket ? _sketch.countUpTo( bucketsEnd ) : countBelow( _buckets[ i + 1 ] );
+
+	_bucketCounts[ i ] = qMax( count - previousCount, 0 );
+	previousCount = qMax( count, previousCount );
+    }
 }
 
 
@@ -15,12 +15,11 @@
 
 #include <QVector>
 
+#include "QuantileSketch.h" // PercentileCount, PercentileValue, PercentileBoundary
+
 
 namespace QDirStat
 {
-    typedef qint32                      PercentileCount; // can hold FileCount
-    typedef qint64                      PercentileValue; // can hold FileSize or time_t
-    typedef long double                 PercentileBoundary; // can hold a fractional PercentileValue
     typedef QVector<PercentileBoundary> Percentiles;
     typedef QVector<PercentileCount>    PercentileCountList;
     typedef QVector<PercentileValue>    PercentileValueList;
@@ -63,6 +62,13 @@ namespace QDirStat
      * Derived classes have to populate the percentile and bucket lists
      * explicitly as they are not needed in all cases and so are not
      * automatically filled.
+     *
+     * For very large data sets, derived classes can call useSketch() so
+     * that once more than a given number of values have been added with
+     * addValue(), the values are counted in a QuantileSketch instead of
+     * being stored and sorted.  All the percentiles, sums, and buckets are
+     * then estimated from the sketch, with a small relative error in the
+     * values.  The list itself is left empty in that case.
      **/
     class PercentileStats : public PercentileValueList
     {
@@ -102,12 +108,26 @@ namespace QDirStat
 
 	/**
 	 * Calculate a percentile directly, without creating or using
-	 * _percentiles.  Treewalker uses this for one-off queries and it
-	 * is used for populating the _percentiles list.
+	 * _percentiles.  It is used for populating the _percentiles list.
+	 * Unless the data has been sorted, it is only valid after
+	 * calculatePercentiles() has selected the percentile ranks.
 	 **/
 	PercentileBoundary percentile( int number ) const
 	    { return quantile( maxPercentile(), number ); }
 
+	/**
+	 * Return the number of data points that have been collected,
+	 * whether they are stored in the list or counted in the sketch.
+	 **/
+	PercentileCount valueCount() const
+	    { return _sketched ? _sketch.count() : size(); }
+
+	/**
+	 * Return 'true' if the data points have been counted in a
+	 * sketch and all the statistics are estimates.
+	 **/
+	bool isApproximate() const { return _sketched; }
+
 	/**
 	 * Calculates the percentiles list and sums for this set of data.  Not
 	 * done automatically because not all users need this (ie. Treewalker).
@@ -331,10 +351,83 @@ namespace QDirStat
     protected:
 
 	/**
-	 * Sort the collected data in ascending order.  This class does not
-	 * know if all the data that has been added to the list has been sorted,
-	 * so it is vital that sort() is called after all collect() calls are
-	 * complete, before the data is analysed.
+	 * Count the values in a QuantileSketch with 'precisionBits' bits of
+	 * precision once more than 'threshold' values have been added with
+	 * addValue().  If 'threshold' is 0, the sketch is used from the start.
+	 **/
+	void useSketch( PercentileCount threshold, int precisionBits );
+
+	/**
+	 * Add a data point, to the list or to the sketch.
+	 **/
+	void addValue( PercentileValue value )
+	{
+	    if ( _sketched )
+	    {
+		_sketch.add( value );
+		return;
+	    }
+
+	    append( value );
+	    _sorted = false;
+	    if ( _sketchThreshold > 0 && size() > _sketchThreshold )
+		moveToSketch();
+	}
+
+	/**
+	 * Add all the data points counted in 'sketch', which must have the
+	 * same precision as the sketch set up by useSketch().  The data
+	 * points in the list are moved to the sketch first.
+	 **/
+	void addSketch( const QuantileSketch & sketch );
+
+	/**
+	 * Move all the data points from the list into the sketch.
+	 **/
+	void moveToSketch();
+
+	/**
+	 * Rearrange the data points so that the values either side of the
+	 * rank of each percentile are where they would be in the sorted
+	 * list, which is all that quantile() needs.  This is much faster
+	 * than sorting the whole list.
+	 **/
+	void selectPercentiles();
+
+	/**
+	 * Fill the cumulative percentile counts and sums from the list of
+	 * data points, which doesn't need to be sorted.  Chunks of the list
+	 * are counted in separate threads.
+	 **/
+	void countPercentiles();
+
+	/**
+	 * Fill the buckets from the list of data points from 'bucketsStart'
+	 * to 'bucketsEnd', including values equal to 'bucketsStart' only if
+	 * 'includeStart' is set.  The list doesn't need to be sorted and
+	 * chunks of it are counted in separate threads.
+	 **/
+	void countBuckets( bool               includeStart,
+			   PercentileBoundary bucketsStart,
+			   PercentileBoundary bucketsEnd );
+
+	/**
+	 * Fill the buckets from the sketch, with the same rules as
+	 * countBuckets().  The number of data points in each bucket is
+	 * estimated from the sketch.
+	 **/
+	void fillSketchBuckets( bool               includeStart,
+				PercentileBoundary bucketsStart,
+				PercentileBoundary bucketsEnd );
+
+	/**
+	 * Sort the collected data in ascending order.  Chunks of the list
+	 * are sorted in separate threads and then merged.
+	 *
+	 * This is only needed if the data itself has to be in order:
+	 * calculatePercentiles() only selects the values it needs from
+	 * unsorted data.  Values appended directly to the list after sorting
+	 * are not tracked, so sort() must be called again after that.
 	 **/
 	void sort();
 
@@ -403,6 +496,11 @@ namespace QDirStat
 	Buckets             _buckets;
 	PercentileCountList _bucketCounts;
 
+	QuantileSketch      _sketch;
+	PercentileCount     _sketchThreshold{ 0 };
+	bool                _sketched{ false };
+	bool                _sorted{ false };
+
     };	// class PercentileStats
 
 }	// namespace QDirStat
@@ -0,0 +1,194 @@
+/*
+ *   File name: PngWriter.cpp
+ *   Summary:   Streaming PNG image writer for QDirStat
+ *   License:   GPL V2 - See file LICENSE for details.
+ *
+ *   Authors:   Stefan Hundhammer <Stefan.Hundhammer@gmx.de>
+ *              Ian Nartowicz
+ */
+
+#include "PngWriter.h"
+#include "Logger.h"
+
+
+// Size of the compressed data in each IDAT chunk
+#define PNG_CHUNK_SIZE	( 256 * 1024 )
+
+// PNG row filter types
+#define PNG_FILTER_SUB	1
+
+
+using namespace QDirStat;
+
+
+namespace
+{
+    /**
+     * Store 'value' in 'buffer' as a 4-byte big-endian number, as used
+     * for all integers in a PNG file.
+     **/
+    void putUInt32( char * buffer, quint32 value )
+    {
+	buffer[ 0 ] = static_cast<char>( ( value >> 24 ) & 0xFF );
+	buffer[ 1 ] = static_cast<char>( ( value >> 16 ) & 0xFF );
+	buffer[ 2 ] = static_cast<char>( ( value >>  8 ) & 0xFF );
+	buffer[ 3 ] = static_cast<char>(   value         & 0xFF );
+    }
+
+} // namespace
+
+
+PngWriter::PngWriter( const QString & fileName, int width, int height ):
+    _file{ fileName },
+    _width{ width },
+    _height{ height },
+    _zStream{},
+    _rowBuffer{ 1 + 3 * width, '\0' },
+    _outBuffer{ PNG_CHUNK_SIZE, '\0' }
+{
+    if ( width <= 0 || height <= 0 )
+    {
+	logError() << "Invalid image size " << width << "x" << height << Qt::endl;
+	return;
+    }
+
+    if ( !_file.open( QIODevice::WriteOnly | QIODevice::Truncate ) )
+    {
+	logError() << "Can't open " << fileName << ": " << _file.errorString() << Qt::endl;
+	return;
+    }
+
+    if ( deflateInit( &_zStream, Z_DEFAULT_COMPRESSION ) != Z_OK )
+    {
+	logError() << "Can't initialize zlib" << Qt::endl;
+	return;
+    }
+
+    _zStream.next_out  = reinterpret_cast<Bytef *>( _outBuffer.data() );
+    _zStream.avail_out = _outBuffer.size();
+    _ok = true;
+
+    // PNG signature
+    _file.write( "\x89PNG\r\n\x1a\n", 8 );
+
+    // Header: width, height, 8 bits per channel, RGB, default compression,
+    // filtering, and no interlacing
+    char header[ 13 ];
+    putUInt32( header,     width );
+    putUInt32( header + 4, height );
+    header[  8 ] = 8;
+    header[  9 ] = 2;
+    header[ 10 ] = 0;
+    header[ 11 ] = 0;
+    header[ 12 ] = 0;
+    writeChunk( "IHDR", header, sizeof( header ) );
+}
+
+
+PngWriter::~PngWriter()
+{
+    deflateEnd( &_zStream );
+}
+
+
+void PngWriter::writeRow( const QRgb * row )
+{
+    if ( !_ok || _rowsWritten >= _height )
+	return;
+
+    // Each byte is stored as the difference from the same byte in the previous pixel
+    uchar * data = reinterpret_cast<uchar *>( _rowBuffer.data() );
+    *data++ = PNG_FILTER_SUB;
+
+    QRgb previous = 0;
+    for ( int x = 0; x < _width; ++x )
+    {
+	const QRgb pixel = row[ x ];
+	*data++ = static_cast<uchar>( qRed  ( pixel ) - qRed  ( previous ) );
+	*data++ = static_cast<uchar>( qGreen( pixel ) - qGreen( previous ) );
+	*data++ = static_cast<uchar>( qBlue ( pixel ) - qBlue ( previous ) );
+	previous = pixel;
+    }
+
+    _zStream.next_in  = reinterpret_cast<Bytef *>( _rowBuffer.data() );
+    _zStream.avail_in = _rowBuffer.size();
+    compress( Z_NO_FLUSH );
+
+    ++_rowsWritten;
+}
+
+
+bool PngWriter::finish()
+{
+    if ( !_ok )
+	return false;
+
+    if ( _rowsWritten != _height )
+    {
+	logError() << "Only " << _rowsWritten << " of " << _height << " rows written" << Qt::endl;
+	_ok = false;
+	return false;
+    }
+
+    compress( Z_FINISH );
+    writeChunk( "IEND", nullptr, 0 );
+
+    _file.close();
+    if ( _file.error() != QFileDevice::NoError )
+    {
+	logError() << "Error writing " << _file.fileName() << ": " << _file.errorString() << Qt::endl;
+	_ok = false;
+    }
+
+    return _ok;
+}
+
+
+void PngWriter::compress( int flush )
+{
+    while ( _ok )
+    {
+	const int result = deflate( &_zStream, flush );
+	if ( result == Z_STREAM_ERROR )
+	{
+	    logError() << "zlib error" << Qt::endl;
+	    _ok = false;
+	    return;
+	}
+
+	// Write an IDAT chunk whenever the output buffer is full, and the remainder at the end
+	const bool finished = flush == Z_FINISH && result == Z_STREAM_END;
+	if ( _zStream.avail_out == 0 || finished )
+	{
+	    writeChunk( "IDAT", _outBuffer.constData(), _outBuffer.size() - _zStream.avail_out );
+	    _zStream.next_out  = reinterpret_cast<Bytef *>( _outBuffer.data() );
+	    _zStream.avail_out = _outBuffer.size();
+	}
+
+	if ( finished || ( flush == Z_NO_FLUSH && _zStream.avail_in == 0 ) )
+	    return;
+    }
+}
+
+
+void PngWriter::writeChunk( const char * type, const char * data, int length )
+{
+    char lengthBytes[ 4 ];
+    putUInt32( lengthBytes, length );
+    _file.write( lengthBytes, 4 );
+
+    // The checksum covers the chunk type and data, but not the length
+    uLong crc = crc32( 0L, Z_NULL, 0 );
+    crc = crc32( crc, reinterpret_cast<const Bytef *>( type ), 4 );
+    _file.write( type, 4 );
+
+    if ( length > 0 )
+    {
+	crc = crc32( crc, reinterpret_cast<const Bytef *>( data ), length );
+	_file.write( data, length );
+    }
+
+    char crcBytes[ 4 ];
+    putUInt32( crcBytes, crc );
+    _file.write( crcBytes, 4 );
+}
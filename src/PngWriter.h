@@ -0,0 +1,109 @@
+/*
+ *   File name: PngWriter.h
+ *   Summary:   Streaming PNG image writer for QDirStat
+ *   License:   GPL V2 - See file LICENSE for details.
+ *
+ *   Authors:   Stefan Hundhammer <Stefan.Hundhammer@gmx.de>
+ *              Ian Nartowicz
+ */
+
+#ifndef PngWriter_h
+#define PngWriter_h
+
+#include <zlib.h>
+
+#include <QByteArray>
+#include <QFile>
+#include <QRgb>
+
+
+namespace QDirStat
+{
+    /**
+     * Class to write a PNG file one row at a time, so that images much
+     * larger than would fit in memory can be written.  QImageWriter can
+     * only write a complete QImage.
+     *
+     * The image is written as 8-bit RGB with no alpha channel.  Each row is
+     * filtered with the PNG "Sub" filter, which suits the smooth gradients
+     * of cushion treemaps, and compressed using zlib.
+     *
+     * Usage:
+     *
+     *     PngWriter writer{ fileName, width, height };
+     *     for ( int y = 0; y < height; ++y )
+     *         writer.writeRow( row( y ) );
+     *     if ( !writer.finish() )
+     *         logError() << ...
+     **/
+    class PngWriter final
+    {
+    public:
+
+	/**
+	 * Constructor.  Opens 'fileName' for writing and writes the PNG
+	 * header for an image of 'width' x 'height' pixels.
+	 **/
+	PngWriter( const QString & fileName, int width, int height );
+
+	/**
+	 * Destructor.  Releases the compression stream.  An image that was
+	 * not completed with finish() is left truncated.
+	 **/
+	~PngWriter();
+
+	/**
+	 * Suppress copy and assignment constructors (there is a file handle
+	 * and a zlib stream).
+	 **/
+	PngWriter( const PngWriter & ) = delete;
+	PngWriter & operator=( const PngWriter & ) = delete;
+
+	/**
+	 * Return 'true' if the file is open and there have been no errors.
+	 **/
+	bool isOk() const { return _ok; }
+
+	/**
+	 * Write the next row of the image.  'row' must contain 'width'
+	 * pixels; any alpha value is ignored.
+	 **/
+	void writeRow( const QRgb * row );
+
+	/**
+	 * Flush the compressed data and close the file.  Returns 'true' if
+	 * the complete image was written successfully.
+	 **/
+	bool finish();
+
+
+    protected:
+
+	/**
+	 * Compress whatever is in the input buffer, writing IDAT chunks as
+	 * the output buffer fills up.  'flush' is the zlib flush mode.
+	 **/
+	void compress( int flush );
+
+	/**
+	 * Write one PNG chunk with its length and checksum.
+	 **/
+	void writeChunk( const char * type, const char * data, int length );
+
+
+    private:
+
+	QFile      _file;
+	int        _width;
+	int        _height;
+	int        _rowsWritten{ 0 };
+	bool       _ok{ false };
+	z_stream   _zStream;
+	QByteArray _rowBuffer;
+	QByteArray _outBuffer;
+
+    };	// class PngWriter
+
+}	// namespace QDirStat
+
+#endif	// ifndef PngWriter_h
@@ -0,0 +1,219 @@
+/*
+ *   File name: QuantileSketch.cpp
+ *   Summary:   Statistics classes for QDirStat
+ *   License:   GPL V2 - See file LICENSE for details.
+ *
+ *   Authors:   Stefan Hundhammer <Stefan.Hundhammer@gmx.de>
+ *              Ian Nartowicz
+ */
+
+#include <cmath> // floor(), ldexp()
+
+#include <QtAlgorithms> // qCountLeadingZeroBits()
+
+#include "QuantileSketch.h"
+#include "Exception.h"
+
+
+using namespace QDirStat;
+
+
+QuantileSketch::QuantileSketch( int precisionBits ):
+    _precisionBits{ qBound( 0, precisionBits, 12 ) }
+{
+}
+
+
+void QuantileSketch::add( PercentileValue value )
+{
+    if ( value < 0 )
+	value = 0;
+
+    const int index = bucketIndex( value );
+    if ( index >= _counts.size() )
+    {
+	_counts.resize( index + 1 );
+	_sums.resize( index + 1 );
+    }
+
+    ++_counts[ index ];
+    _sums[ index ] += value;
+
+    if ( _count == 0 || value < _min )
+	_min = value;
+    if ( _count == 0 || value > _max )
+	_max = value;
+
+    ++_count;
+    _sum += value;
+}
+
+
+void QuantileSketch::merge( const QuantileSketch & other )
+{
+    if ( other._count == 0 )
+	return;
+
+    if ( other._precisionBits != _precisionBits )
+	THROW( Exception{ "Can't merge quantile sketches with different precision" } );
+
+    if ( other._counts.size() > _counts.size() )
+    {
+	_counts.resize( other._counts.size() );
+	_sums.resize( other._sums.size() );
+    }
+
+    for ( int i = 0; i < other._counts.size(); ++i )
+    {
+	_counts[ i ] += other._counts[ i ];
+	_sums[ i ]   += other._sums[ i ];
+    }
+
+    if ( _count == 0 || other._min < _min )
+	_min = other._min;
+    if ( _count == 0 || other._max > _max )
+	_max = other._max;
+
+    _count += other._count;
+    _sum   += other._sum;
+}
+
+
+void QuantileSketch::clear()
+{
+    _counts.clear();
+    _sums.clear();
+    _count = 0;
+    _sum   = 0;
+    _min   = 0;
+    _max   = 0;
+}
+
+
+int QuantileSketch::bucketIndex( PercentileValue value ) const
+{
+    // Small values each have their own bucket
+    const PercentileValue subBuckets = 1LL << _precisionBits;
+    if ( value < subBuckets )
+	return value;
+
+    // Split each power of two above that into 'subBuckets' buckets
+    const int exponent = 63 - qCountLeadingZeroBits( static_cast<quint64>( value ) );
+    const int shift    = exponent - _precisionBits;
+
+    return ( shift + 1 ) * subBuckets + ( ( value >> shift ) - subBuckets );
+}
+
+
+PercentileBoundary QuantileSketch::bucketStart( int index ) const
+{
+    const int subBuckets = 1 << _precisionBits;
+    if ( index < subBuckets )
+	return index;
+
+    const int shift = index / subBuckets - 1;
+    const int sub   = index % subBuckets;
+
+    return std::ldexp( static_cast<PercentileBoundary>( subBuckets + sub ), shift );
+}
+
+
+PercentileBoundary QuantileSketch::lowestValue( int index ) const
+{
+    return qMax<PercentileBoundary>( bucketStart( index ), _min );
+}
+
+
+PercentileBoundary QuantileSketch::highestValue( int index ) const
+{
+    return qMin<PercentileBoundary>( bucketEnd( index ) - 1, _max );
+}
+
+
+PercentileBoundary QuantileSketch::valueAt( qint64 rank ) const
+{
+    qint64 cumulative = 0;
+    for ( int i = 0; i < _counts.size(); ++i )
+    {
+	const PercentileCount count = _counts[ i ];
+	if ( rank < cumulative + count )
+	{
+	    // A single value in a bucket is known exactly from the bucket sum
+	    if ( count == 1 )
+		return _sums[ i ];
+
+	    // Otherwise spread the values evenly from the lowest to the highest possible
+	    const PercentileBoundary lowest  = lowestValue( i );
+	    const PercentileBoundary highest = highestValue( i );
+
+	    return lowest + ( highest - lowest ) * ( rank - cumulative ) / ( count - 1 );
+	}
+
+	cumulative += count;
+    }
+
+    return _max;
+}
+
+
+PercentileBoundary QuantileSketch::quantile( double rank ) const
+{
+    if ( _count == 0 )
+	return 0;
+
+    rank = qBound( 0.0, rank, _count - 1.0 );
+
+    // Interpolate between the values either side of a fractional rank, as for exact percentiles
+    const qint64 index  = std::floor( rank );
+    const double modulo = rank - index;
+
+    PercentileBoundary result = valueAt( index );
+    if ( modulo )
+	result += modulo * ( valueAt( index + 1 ) - result );
+
+    return result;
+}
+
+
+PercentileCount QuantileSketch::countUpTo( PercentileBoundary value, PercentileValue * sum ) const
+{
+    PercentileCount count    = 0;
+    PercentileValue countSum = 0;
+
+    for ( int i = 0; i < _counts.size(); ++i )
+    {
+	const PercentileCount bucketCount = _counts[ i ];
+	if ( bucketCount == 0 )
+	    continue;
+
+	const PercentileBoundary lowest  = lowestValue( i );
+	const PercentileBoundary highest = highestValue( i );
+
+	// Buckets are in ascending order, so there is nothing more to count
+	if ( lowest > value )
+	    break;
+
+	if ( highest <= value )
+	{
+	    count    += bucketCount;
+	    countSum += _sums[ i ];
+	    continue;
+	}
+
+	// Count the part of the bucket up to 'value', consistent with valueAt()
+	PercentileCount partCount;
+	if ( bucketCount == 1 )
+	    partCount = _sums[ i ] <= value ? 1 : 0;
+	else
+	    partCount = std::floor( ( value - lowest ) * ( bucketCount - 1 ) / ( highest - lowest ) ) + 1;
+
+	count    += partCount;
+	countSum += static_cast<PercentileBoundary>( _sums[ i ] ) * partCount / bucketCount;
+	break;
+    }
+
+    if ( sum )
+	*sum = countSum;
+
+    return count;
+}
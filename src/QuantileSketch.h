@@ -0,0 +1,154 @@
+/*
+ *   File name: QuantileSketch.h
+ *   Summary:   Statistics classes for QDirStat
+ *   License:   GPL V2 - See file LICENSE for details.
+ *
+ *   Authors:   Stefan Hundhammer <Stefan.Hundhammer@gmx.de>
+ *              Ian Nartowicz
+ */
+
+#ifndef QuantileSketch_h
+#define QuantileSketch_h
+
+#include <QVector>
+
+
+namespace QDirStat
+{
+    typedef qint32      PercentileCount;    // can hold FileCount
+    typedef qint64      PercentileValue;    // can hold FileSize or time_t
+    typedef long double PercentileBoundary; // can hold a fractional PercentileValue
+
+    /**
+     * Compact, mergeable summary of a large set of non-negative integer
+     * values such as file sizes, from which quantiles, counts, and sums
+     * can be estimated without storing or sorting the values.
+     *
+     * The values are counted in log-linear buckets: each power of two is
+     * split into 2^precisionBits buckets of equal width, and values below
+     * 2^precisionBits each have their own bucket.  Every value is in a
+     * bucket no wider than 1/2^precisionBits of the value itself, so
+     * quantiles are accurate to within that relative error (0.8% for the
+     * default of 7 bits).  The number of buckets depends only on the
+     * precision and the largest value, never on the number of values.
+     *
+     * With a precision of 0 bits, there is one bucket for 0 and one for
+     * each power of two: a plain log2 histogram with at most 64 buckets.
+     *
+     * Within a bucket, values are assumed to be spread evenly from the
+     * lowest to the highest integer value it can hold, limited by the
+     * exact minimum and maximum of all the values.  The sum of the values
+     * in each bucket is exact.
+     *
+     * Sketches with the same precision can be merged by adding their
+     * buckets, giving exactly the same result as adding all the values
+     * to one sketch.
+     **/
+    class QuantileSketch final
+    {
+    public:
+
+	/**
+	 * Constructor: an empty sketch with 'precisionBits' (0 to 12) bits
+	 * of precision.
+	 **/
+	QuantileSketch( int precisionBits = 7 );
+
+	/**
+	 * Add 'value' to the sketch.  Negative values are counted as 0.
+	 **/
+	void add( PercentileValue value );
+
+	/**
+	 * Add all the values from 'other' to this sketch.  Both sketches
+	 * must have the same precision.
+	 **/
+	void merge( const QuantileSketch & other );
+
+	/**
+	 * Remove all the values from the sketch.
+	 **/
+	void clear();
+
+	/**
+	 * Return the precision of this sketch in bits.
+	 **/
+	int precisionBits() const { return _precisionBits; }
+
+	/**
+	 * Return the number of values, their sum, and the smallest and
+	 * largest of them.
+	 **/
+	PercentileCount count()    const { return _count; }
+	PercentileValue sum()      const { return _sum;   }
+	PercentileValue minValue() const { return _min;   }
+	PercentileValue maxValue() const { return _max;   }
+
+	/**
+	 * Return the number of buckets currently in use, up to and
+	 * including the bucket of the largest value.
+	 **/
+	int bucketsCount() const { return _counts.size(); }
+
+	/**
+	 * Return the number of values in bucket 'index' and their sum.
+	 **/
+	PercentileCount bucketCount( int index ) const { return _counts.at( index ); }
+	PercentileValue bucketSum  ( int index ) const { return _sums.at( index );   }
+
+	/**
+	 * Return the smallest value that can be counted in bucket 'index'
+	 * and the smallest value of the next bucket.
+	 **/
+	PercentileBoundary bucketStart( int index ) const;
+	PercentileBoundary bucketEnd  ( int index ) const { return bucketStart( index + 1 ); }
+
+	/**
+	 * Return the estimated value with rank 'rank' (from 0 for the
+	 * smallest to count() - 1 for the largest), interpolating between
+	 * neighbouring ranks for a fractional rank.
+	 **/
+	PercentileBoundary quantile( double rank ) const;
+
+	/**
+	 * Return the estimated number of values no larger than 'value'.  If
+	 * 'sum' is not null, it is set to the estimated sum of those values.
+	 **/
+	PercentileCount countUpTo( PercentileBoundary value, PercentileValue * sum = nullptr ) const;
+
+
+    protected:
+
+	/**
+	 * Return the index of the bucket for 'value'.
+	 **/
+	int bucketIndex( PercentileValue value ) const;
+
+	/**
+	 * Return the lowest and highest value that there can be in bucket
+	 * 'index', given the minimum and maximum of all the values.
+	 **/
+	PercentileBoundary lowestValue ( int index ) const;
+	PercentileBoundary highestValue( int index ) const;
+
+	/**
+	 * Return the estimated value with integer rank 'rank'.
+	 **/
+	PercentileBoundary valueAt( qint64 rank ) const;
+
+
+    private:
+
+	int                 _precisionBits;
+	QVector<PercentileCount> _counts;
+	QVector<PercentileValue> _sums;
+	PercentileCount     _count{ 0 };
+	PercentileValue     _sum{ 0 };
+	PercentileValue     _min{ 0 };
+	PercentileValue     _max{ 0 };
+
+    };	// class QuantileSketch
+
+}	// namespace QDirStat
+
+#endif	// ifndef QuantileSketch_h
@@ -0,0 +1,165 @@
+/*
+ *   File name: StatsRunner.cpp
+ *   Summary:   QDirStat helper class to collect statistics in a worker thread
+ *   License:   GPL V2 - See file LICENSE for details.
+ *
+ *   Authors:   Stefan Hundhammer <Stefan.Hundhammer@gmx.de>
+ *              Ian Nartowicz
+ */
+
+#include <QtConcurrent/QtConcurrent>
+
+#include "StatsRunner.h"
+#include "DirTree.h"
+#include "FileInfo.h"
+
+
+// Interval in milliseconds between progress signals
+#define PROGRESS_INTERVAL  200
+
+
+using namespace QDirStat;
+
+
+int StatsProgress::percent() const
+{
+    if ( _totalDirs <= 0 )
+	return 0;
+
+    // Not every directory is visited, so the count is only an estimate
+    return qMin( 100LL, 100LL * _dirs / _totalDirs );
+}
+
+
+void StatsProgress::reset( FileCount totalDirs )
+{
+    _dirs      = 0;
+    _cancelled = false;
+    _totalDirs = totalDirs;
+}
+
+
+
+
+StatsRunner::StatsRunner( QObject * parent ):
+    QObject{ parent }
+{
+    // One collection at a time: a new one always cancels the old one
+    _pool.setMaxThreadCount( 1 );
+
+    _progressTimer.setInterval( PROGRESS_INTERVAL );
+    connect( &_progressTimer, &QTimer::timeout, this, &StatsRunner::sendProgress );
+}
+
+
+StatsRunner::~StatsRunner()
+{
+    disconnect();
+    cancel();
+}
+
+
+void StatsRunner::startJob( FileInfo                                     * subtree,
+                            const std::function<void( StatsProgress & )> & collect,
+                            const std::function<void()>                  & ready )
+{
+    cancel();
+
+    if ( !subtree )
+	return;
+
+    watchTree( subtree->tree() );
+
+    // Bring the totals and summaries up to date now, they can't be recalculated in the worker thread
+    _progress.reset( subtree->totalSubDirs() + 1 );
+
+    _running = true;
+    const int runId = _runId;
+
+    emit started();
+
+    // The tree can't be read in another thread while it is still changing
+    if ( _tree && _tree->isBusy() )
+    {
+	collect( _progress );
+	finishJob( runId, ready );
+	return;
+    }
+
+    const auto collectStats = [ this, collect, ready, runId ]()
+    {
+	collect( _progress );
+
+	// Hand the statistics over to the main thread
+	QMetaObject::invokeMethod( this, [ this, ready, runId ]()
+	    { finishJob( runId, ready ); }, Qt::QueuedConnection );
+    };
+
+#if QT_VERSION < QT_VERSION_CHECK( 6, 0, 0 )
+    QtConcurrent::run( &_pool, collectStats );
+#else
+    std::ignore = QtConcurrent::run( &_pool, collectStats );
+#endif
+
+    _progressTimer.start();
+}
+
+
+void StatsRunner::cancel()
+{
+    _progress.cancel();
+    _pool.waitForDone();
+
+    // Ignore the statistics if they are still queued for the main thread
+    if ( _running )
+    {
+	_running = false;
+	++_runId;
+	_progressTimer.stop();
+	emit aborted();
+    }
+}
+
+
+void StatsRunner::finishJob( int runId, const std::function<void()> & ready )
+{
+    if ( runId != _runId || !_running )
+	return;
+
+    _running = false;
+    ++_runId;
+    _progressTimer.stop();
+
+    ready();
+
+    emit finished();
+}
+
+
+void StatsRunner::sendProgress()
+{
+    if ( _running )
+	emit progress( _progress.percent() );
+}
+
+
+void StatsRunner::watchTree( DirTree * tree )
+{
+    if ( tree == _tree )
+	return;
+
+    if ( _tree )
+	disconnect( _tree, nullptr, this, nullptr );
+
+    _tree = tree;
+    if ( !tree )
+	return;
+
+    // All these are sent before the tree is changed
+    connect( tree, &DirTree::clearing,         this, &StatsRunner::cancel );
+    connect( tree, &DirTree::clearingSubtree,  this, &StatsRunner::cancel );
+    connect( tree, &DirTree::deletingChild,    this, &StatsRunner::cancel );
+    connect( tree, &DirTree::deletingChildren, this, &StatsRunner::cancel );
+    connect( tree, &DirTree::startingReading,  this, &StatsRunner::cancel );
+    connect( tree, &DirTree::startingRefresh,  this, &StatsRunner::cancel );
+}
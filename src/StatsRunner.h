@@ -0,0 +1,223 @@
+/*
+ *   File name: StatsRunner.h
+ *   Summary:   QDirStat helper class to collect statistics in a worker thread
+ *   License:   GPL V2 - See file LICENSE for details.
+ *
+ *   Authors:   Stefan Hundhammer <Stefan.Hundhammer@gmx.de>
+ *              Ian Nartowicz
+ */
+
+#ifndef StatsRunner_h
+#define StatsRunner_h
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <type_traits>
+
+#include <QObject>
+#include <QPointer>
+#include <QThreadPool>
+#include <QTimer>
+
+#include "Typedefs.h" // FileCount
+
+
+namespace QDirStat
+{
+    class DirTree;
+    class FileInfo;
+
+    /**
+     * Progress of statistics being collected by a StatsRunner.  The
+     * collection reports each directory it visits and stops as soon as
+     * it finds that it has been cancelled.
+     **/
+    class StatsProgress final
+    {
+    public:
+
+	/**
+	 * Count one more directory as collected.  Return 'false' if the
+	 * collection has been cancelled and should stop.
+	 **/
+	bool visitDir()
+	    { _dirs.fetch_add( 1, std::memory_order_relaxed ); return !_cancelled; }
+
+	/**
+	 * Count 'dirs' more directories as collected, for example when
+	 * merging the cached statistics of a subtree.
+	 **/
+	void addDirs( FileCount dirs ) { _dirs.fetch_add( dirs, std::memory_order_relaxed ); }
+
+	/**
+	 * Return 'true' if the collection has been cancelled.
+	 **/
+	bool isCancelled() const { return _cancelled; }
+
+	/**
+	 * Return the percentage of the directories collected so far.
+	 **/
+	int percent() const;
+
+
+    protected:
+
+	friend class StatsRunner;
+
+	/**
+	 * Reset the progress for a new collection of 'totalDirs'
+	 * directories.
+	 **/
+	void reset( FileCount totalDirs );
+
+	/**
+	 * Tell the collection to stop.
+	 **/
+	void cancel() { _cancelled = true; }
+
+
+    private:
+
+	std::atomic<FileCount> _dirs{ 0 };
+	std::atomic<bool>      _cancelled{ false };
+	FileCount              _totalDirs{ 0 };
+
+    };	// class StatsProgress
+
+
+    /**
+     * Class to collect statistics for a subtree in a worker thread, so
+     * that the GUI stays responsive while a large tree is summarised.
+     *
+     * Only one collection runs at a time: starting another one cancels
+     * the one in progress.  The statistics are handed to the main thread
+     * in one piece once they are complete, so a window can keep showing
+     * its old statistics until then and replace them all at once.
+     *
+     * The worker thread reads the tree without any locking, so the
+     * totals and cached summaries are brought up to date before it
+     * starts, and the collection is cancelled whenever the tree is about
+     * to be changed.  The subtree is therefore unchanged for as long as
+     * the collection runs.  While the tree is being read, the statistics
+     * are collected in the main thread instead.
+     **/
+    class StatsRunner final : public QObject
+    {
+	Q_OBJECT
+
+    public:
+
+	/**
+	 * Constructor.
+	 **/
+	StatsRunner( QObject * parent = nullptr );
+
+	/**
+	 * Destructor.  Cancels any collection in progress without sending
+	 * any more signals.
+	 **/
+	~StatsRunner() override;
+
+	/**
+	 * Start collecting statistics for 'subtree', cancelling any
+	 * collection already in progress.
+	 *
+	 * 'collect' is called in the worker thread with a StatsProgress
+	 * and returns a new statistics object.  'ready' is called in the
+	 * main thread with a std::unique_ptr to that object once the
+	 * collection is finished.  'ready' is not called if the collection
+	 * is cancelled.
+	 **/
+	template<typename Collect, typename Ready>
+	void start( FileInfo * subtree, Collect collect, Ready ready )
+	{
+	    typedef typename std::remove_pointer<decltype( collect( _progress ) )>::type Stats;
+
+	    // The statistics are deleted along with the functions if they are never handed over
+	    const auto stats = std::make_shared<std::unique_ptr<Stats>>();
+	    startJob( subtree,
+	              [ collect, stats ]( StatsProgress & progress ) { stats->reset( collect( progress ) ); },
+	              [ ready, stats ]() { ready( std::move( *stats ) ); } );
+	}
+
+	/**
+	 * Return 'true' if statistics are being collected.
+	 **/
+	bool isRunning() const { return _running; }
+
+
+    public slots:
+
+	/**
+	 * Stop any collection in progress and wait for the worker thread
+	 * to return.
+	 **/
+	void cancel();
+
+
+    signals:
+
+	/**
+	 * Emitted when a collection is started, after cancelling any
+	 * previous one.
+	 **/
+	void started();
+
+	/**
+	 * Emitted periodically while statistics are being collected in the
+	 * worker thread, with the percentage of the subtree done.
+	 **/
+	void progress( int percent );
+
+	/**
+	 * Emitted after the statistics have been handed over.
+	 **/
+	void finished();
+
+	/**
+	 * Emitted when a collection in progress is cancelled.
+	 **/
+	void aborted();
+
+
+    protected:
+
+	/**
+	 * Start running 'collect' for 'subtree' and call 'ready' when it is
+	 * finished.
+	 **/
+	void startJob( FileInfo                                     * subtree,
+	               const std::function<void( StatsProgress & )> & collect,
+	               const std::function<void()>                  & ready );
+
+	/**
+	 * Notification that collection number 'runId' is finished.
+	 **/
+	void finishJob( int runId, const std::function<void()> & ready );
+
+	/**
+	 * Send the progress of the collection in progress.
+	 **/
+	void sendProgress();
+
+	/**
+	 * Connect to 'tree' to cancel collections before it changes.
+	 **/
+	void watchTree( DirTree * tree );
+
+
+    private:
+
+	QThreadPool       _pool;
+	QTimer            _progressTimer;
+	StatsProgress     _progress;
+	QPointer<DirTree> _tree;
+	int               _runId{ 0 };
+	bool              _running{ false };
+
+    };	// class StatsRunner
+
+}	// namespace QDirStat
+
+#endif	// ifndef StatsRunner_h
@@ -0,0 +1,226 @@
+/*
+ *   File name: TreeWalkRunner.cpp
+ *   Summary:   QDirStat helper class to walk a FileInfo tree in parallel
+ *   License:   GPL V2 - See file LICENSE for details.
+ *
+ *   Authors:   Stefan Hundhammer <Stefan.Hundhammer@gmx.de>
+ *              Ian Nartowicz
+ */
+
+#include <QtConcurrent/QtConcurrent>
+
+#include "TreeWalkRunner.h"
+#include "DirTree.h"
+#include "FileInfo.h"
+#include "FileInfoIterator.h"
+#include "TreeWalker.h"
+
+
+// Number of parts to split a walk into for each thread, to even out the load
+#define PARTS_PER_THREAD     8
+
+// Subtrees with fewer items than this are never split into separate parts
+#define MIN_PART_ITEMS    1000
+
+
+using namespace QDirStat;
+
+
+TreeWalkRunner::TreeWalkRunner( QObject * parent ):
+    QObject{ parent }
+{
+}
+
+
+TreeWalkRunner::~TreeWalkRunner()
+{
+    disconnect();
+    cancel();
+}
+
+
+void TreeWalkRunner::start( TreeWalker * treeWalker, FileInfo * subtree )
+{
+    cancel();
+
+    if ( !treeWalker || !subtree )
+	return;
+
+    _treeWalker   = treeWalker;
+    _results.clear();
+    _pendingParts = 0;
+    _resultCount  = 0;
+    _overflow     = false;
+
+    watchTree( subtree->tree() );
+
+    // Bring the totals and summaries up to date now, they can't be recalculated in the worker threads
+    const FileCount totalItems = subtree->totalItems();
+
+    treeWalker->prepare( subtree );
+
+    const int walkId = _walkId;
+
+    QVector<FileInfo *> items;
+    if ( treeWalker->findResults( subtree, items ) )
+    {
+	++_pendingParts;
+	partFinished( walkId, items );
+	return;
+    }
+
+    // The tree can't be read in other threads while it is still changing
+    _inline = _tree && _tree->isBusy();
+
+    const FileCount parts = _pool.maxThreadCount() * PARTS_PER_THREAD;
+    const FileCount maxItems = qMax<FileCount>( MIN_PART_ITEMS, totalItems / parts );
+
+    // Hold the walk open until all the parts are started, in case parts finish immediately
+    ++_pendingParts;
+    startParts( subtree, maxItems );
+    partFinished( walkId, QVector<FileInfo *>{} );
+}
+
+
+void TreeWalkRunner::cancel()
+{
+    _cancelled = true;
+    _pool.waitForDone();
+    _cancelled = false;
+
+    // Ignore any results still queued for the cancelled walk
+    if ( _treeWalker )
+    {
+	_treeWalker = nullptr;
+	++_walkId;
+	emit aborted();
+    }
+}
+
+
+void TreeWalkRunner::startParts( FileInfo * dir, FileCount maxItems )
+{
+    startPart( dir, false );
+
+    for ( DotEntryIterator it{ dir }; *it; ++it )
+    {
+	if ( !it->hasChildren() )
+	    continue;
+
+	if ( it->totalItems() > maxItems )
+	    startParts( *it, maxItems );
+	else
+	    startPart( *it, true );
+    }
+}
+
+
+void TreeWalkRunner::startPart( FileInfo * dir, bool recursive )
+{
+    // The walk may already have finished with the maximum number of results
+    if ( !_treeWalker )
+	return;
+
+    ++_pendingParts;
+    const int walkId = _walkId;
+
+    if ( _inline )
+    {
+	partFinished( walkId, _treeWalker->walk( dir, recursive, _cancelled ) );
+	return;
+    }
+
+    const TreeWalker * treeWalker = _treeWalker;
+    const auto walkPart = [ this, treeWalker, dir, recursive, walkId ]()
+    {
+	const QVector<FileInfo *> partResults = treeWalker->walk( dir, recursive, _cancelled );
+
+	// Hand the results over to the main thread
+	QMetaObject::invokeMethod( this, [ this, walkId, partResults ]()
+	    { partFinished( walkId, partResults ); }, Qt::QueuedConnection );
+    };
+
+#if QT_VERSION < QT_VERSION_CHECK( 6, 0, 0 )
+    QtConcurrent::run( &_pool, walkPart );
+#else
+    std::ignore = QtConcurrent::run( &_pool, walkPart );
+#endif
+}
+
+
+void TreeWalkRunner::partFinished( int walkId, const QVector<FileInfo *> & partResults )
+{
+    if ( walkId != _walkId || !_treeWalker )
+	return;
+
+    if ( _treeWalker->streamsResults() )
+    {
+	QVector<FileInfo *> items{ partResults };
+
+	const int maxResults = _treeWalker->maxResults();
+	if ( maxResults > 0 && _resultCount + items.size() > maxResults )
+	{
+	    items.resize( maxResults - _resultCount );
+	    _overflow = true;
+	}
+
+	_resultCount += items.size();
+	if ( !items.isEmpty() )
+	    emit resultsFound( items );
+
+	if ( _overflow )
+	{
+	    finishWalk();
+	    return;
+	}
+    }
+    else
+    {
+	_treeWalker->merge( _results, partResults );
+    }
+
+    if ( --_pendingParts == 0 )
+	finishWalk();
+}
+
+
+void TreeWalkRunner::finishWalk()
+{
+    if ( !_treeWalker->streamsResults() )
+    {
+	_resultCount = _results.size();
+	if ( !_results.isEmpty() )
+	    emit resultsFound( _results );
+	_results.clear();
+    }
+
+    _treeWalker = nullptr;
+    ++_walkId;
+
+    // Stop any parts still being walked after reaching the maximum number of results
+    _cancelled = true;
+
+    emit finished();
+}
+
+
+void TreeWalkRunner::watchTree( DirTree * tree )
+{
+    if ( tree == _tree )
+	return;
+
+    if ( _tree )
+	disconnect( _tree, nullptr, this, nullptr );
+
+    _tree = tree;
+    if ( !tree )
+	return;
+
+    // All these are sent before the tree is changed
+    connect( tree, &DirTree::clearing,         this, &TreeWalkRunner::cancel );
+    connect( tree, &DirTree::clearingSubtree,  this, &TreeWalkRunner::cancel );
+    connect( tree, &DirTree::deletingChild,    this, &TreeWalkRunner::cancel );
+    connect( tree, &DirTree::deletingChildren, this, &TreeWalkRunner::cancel );
+    connect( tree, &DirTree::startingReading,  this, &TreeWalkRunner::cancel );
+    connect( tree, &DirTree::startingRefresh,  this, &TreeWalkRunner::cancel );
+}
@@ -0,0 +1,159 @@
+/*
+ *   File name: TreeWalkRunner.h
+ *   Summary:   QDirStat helper class to walk a FileInfo tree in parallel
+ *   License:   GPL V2 - See file LICENSE for details.
+ *
+ *   Authors:   Stefan Hundhammer <Stefan.Hundhammer@gmx.de>
+ *              Ian Nartowicz
+ */
+
+#ifndef TreeWalkRunner_h
+#define TreeWalkRunner_h
+
+#include <atomic>
+
+#include <QObject>
+#include <QPointer>
+#include <QThreadPool>
+#include <QVector>
+
+#include "Typedefs.h" // FileCount
+
+
+namespace QDirStat
+{
+    class DirTree;
+    class FileInfo;
+    class TreeWalker;
+
+    /**
+     * Class to run a TreeWalker over a subtree using a thread pool, so
+     * that the GUI stays responsive while a large tree is searched.
+     *
+     * The subtree is split into parts of roughly equal numbers of items
+     * and each part is walked in a separate task.  Large directories are
+     * split further, so the parts are never much bigger than a fraction of
+     * the whole subtree.  The results of each part are sent in a
+     * resultsFound() signal as soon as the part is finished, or merged
+     * and sent once at the end for walkers that can't stream results.
+     *
+     * A walk can be cancelled at any time.  Walks are also cancelled
+     * whenever the tree is about to be changed, since the worker threads
+     * read the tree without any locking.  While the tree is being read,
+     * the parts are walked in the main thread instead.
+     **/
+    class TreeWalkRunner final : public QObject
+    {
+	Q_OBJECT
+
+    public:
+
+	/**
+	 * Constructor.
+	 **/
+	TreeWalkRunner( QObject * parent = nullptr );
+
+	/**
+	 * Destructor.  Cancels any walk in progress without sending any
+	 * more signals.
+	 **/
+	~TreeWalkRunner() override;
+
+	/**
+	 * Start walking 'subtree' with 'treeWalker', cancelling any walk
+	 * already in progress.  'treeWalker' must stay valid until the walk
+	 * is finished or cancelled.
+	 **/
+	void start( TreeWalker * treeWalker, FileInfo * subtree );
+
+	/**
+	 * Return 'true' if a walk is in progress.
+	 **/
+	bool isRunning() const { return _treeWalker != nullptr; }
+
+	/**
+	 * Return 'true' if the last walk found more results than the
+	 * maximum for its tree walker.
+	 **/
+	bool overflow() const { return _overflow; }
+
+
+    public slots:
+
+	/**
+	 * Stop any walk in progress and wait for the worker threads to
+	 * return.  No more results are sent for that walk.
+	 **/
+	void cancel();
+
+
+    signals:
+
+	/**
+	 * Emitted with each batch of results.
+	 **/
+	void resultsFound( const QVector<FileInfo *> & items );
+
+	/**
+	 * Emitted when the whole subtree has been walked, or the maximum
+	 * number of results has been reached.  Not emitted if the walk was
+	 * cancelled.
+	 **/
+	void finished();
+
+	/**
+	 * Emitted when a walk in progress is cancelled.
+	 **/
+	void aborted();
+
+
+    protected:
+
+	/**
+	 * Start walking the items in 'dir' and all the items below them,
+	 * splitting any directories with more than 'maxItems' items into
+	 * separate parts.
+	 **/
+	void startParts( FileInfo * dir, FileCount maxItems );
+
+	/**
+	 * Start walking one part of the tree: the items in 'dir' and, if
+	 * 'recursive' is set, all the items below them.
+	 **/
+	void startPart( FileInfo * dir, bool recursive );
+
+	/**
+	 * Notification that a part of walk number 'walkId' has been walked
+	 * with the results 'partResults'.
+	 **/
+	void partFinished( int walkId, const QVector<FileInfo *> & partResults );
+
+	/**
+	 * Send the results of the walk when it is finished.
+	 **/
+	void finishWalk();
+
+	/**
+	 * Connect to 'tree' to cancel walks before it changes.
+	 **/
+	void watchTree( DirTree * tree );
+
+
+    private:
+
+	QThreadPool         _pool;
+	std::atomic<bool>   _cancelled{ false };
+	QPointer<DirTree>   _tree;
+	TreeWalker        * _treeWalker{ nullptr };
+	QVector<FileInfo *> _results;
+	int                 _walkId{ 0 };
+	int                 _pendingParts{ 0 };
+	int                 _resultCount{ 0 };
+	bool                _inline{ false };
+	bool                _overflow{ false };
+
+    };	// class TreeWalkRunner
+
+}	// namespace QDirStat
+
+#endif	// ifndef TreeWalkRunner_h
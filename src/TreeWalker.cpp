@@ -7,10 +7,14 @@
  *              Ian Nartowicz
  */
 
+#include <algorithm> // pop_heap(), push_heap()
+
 #include "TreeWalker.h"
-#include "FileInfo.h"
-#include "FileSizeStats.h"
-#include "FileMTimeStats.h"
+#include "DirInfo.h"
+#include "DirTree.h"
+#include "FileInfoIterator.h"
+#include "FileNameIndex.h"
+#include "HardLinkTable.h"
 #include "SysUtil.h"
 
 
@@ -24,92 +28,226 @@ using namespace QDirStat;
 namespace
 {
     /**
-     * Calculate a data value threshold from a set of PercentileStats from
-     * an upper percentile up to the maximum value (P100).
+     * Heap ordering so that the lowest ranked file is at the front of the
+     * heap, ready to be replaced by a higher ranked one.
      **/
-    PercentileBoundary upperPercentileThreshold( PercentileStats & stats )
+    template<typename T>
+    bool higherRank( const T & file1, const T & file2 )
     {
-        if ( stats.size() <= 100               ) return stats.percentile( 80 );
-        if ( stats.size() <= MAX_RESULTS * 10  ) return stats.percentile( 90 );
-        if ( stats.size() <= MAX_RESULTS * 20  ) return stats.percentile( 95 );
-        if ( stats.size() <= MAX_RESULTS * 100 ) return stats.percentile( 99 );
-
-        return stats.at( stats.size() - MAX_RESULTS ); // check() for >= this value
+        return file1.first > file2.first;
     }
 
 
     /**
-     * Calculate a data value threshold from a set of PercentileStats from
-     * the minimum value (P0) to a lower percentile.
+     * Add 'file' to 'heap' if there is space or if it ranks higher than
+     * the lowest ranked file already in the heap.
      **/
-    PercentileBoundary lowerPercentileThreshold( PercentileStats & stats )
+    template<typename T>
+    void addToHeap( QVector<T> & heap, const T & file )
     {
-        if ( stats.size() <= 100               ) return stats.percentile( 20 );
-        if ( stats.size() <= MAX_RESULTS * 10  ) return stats.percentile( 10 );
-        if ( stats.size() <= MAX_RESULTS * 20  ) return stats.percentile(  5 );
-        if ( stats.size() <= MAX_RESULTS * 100 ) return stats.percentile(  1 );
-
-        return stats.at( MAX_RESULTS ); // check() for <= this value
+        if ( heap.size() < MAX_RESULTS )
+        {
+            heap.append( file );
+            std::push_heap( heap.begin(), heap.end(), higherRank<T> );
+        }
+        else if ( file.first > heap.first().first )
+        {
+            std::pop_heap( heap.begin(), heap.end(), higherRank<T> );
+            heap.last() = file;
+            std::push_heap( heap.begin(), heap.end(), higherRank<T> );
+        }
     }
 
 } // namespace
 
 
-void LargestFilesTreeWalker::prepare( FileInfo * subtree )
+QVector<FileInfo *> TreeWalker::walk( FileInfo * dir, bool recursive, const std::atomic<bool> & cancelled ) const
 {
-    FileSizeStats stats{ subtree };
+    QVector<FileInfo *> items;
+    if ( dir )
+        walk( dir, recursive, cancelled, items );
+
+    return items;
+}
+
 
-    _threshold = std::floor( upperPercentileThreshold( stats ) );
+void TreeWalker::walk( FileInfo                * dir,
+                       bool                      recursive,
+                       const std::atomic<bool> & cancelled,
+                       QVector<FileInfo *>     & items ) const
+{
+    if ( cancelled )
+        return;
+
+    for ( DotEntryIterator it{ dir }; *it; ++it )
+    {
+        if ( check( *it ) )
+            items << *it;
+
+        if ( recursive && it->hasChildren() )
+            walk( *it, recursive, cancelled, items );
+    }
 }
 
 
-bool LargestFilesTreeWalker::check( const FileInfo * item )
+void TreeWalker::merge( QVector<FileInfo *> & items, const QVector<FileInfo *> & partResults ) const
 {
-    return item && item->isFileOrSymlink() && item->size() >= _threshold;
+    items << partResults;
 }
 
 
 
 
-void NewFilesTreeWalker::prepare( FileInfo * subtree )
+bool TopFilesTreeWalker::check( const FileInfo * item ) const
 {
-    FileMTimeStats stats{ subtree };
+    return item && item->isFileOrSymlink();
+}
+
+
+QVector<FileInfo *> TopFilesTreeWalker::walk( FileInfo                * dir,
+                                              bool                      recursive,
+                                              const std::atomic<bool> & cancelled ) const
+{
+    RankedFiles heap;
+    heap.reserve( MAX_RESULTS );
+    if ( dir && recursive )
+    {
+        collect( dir, heap, cancelled );
+    }
+    else if ( dir )
+    {
+        for ( DotEntryIterator it{ dir }; *it; ++it )
+        {
+            if ( check( *it ) )
+                addToHeap( heap, RankedFile{ key( *it ), *it } );
+        }
+    }
+
+    QVector<FileInfo *> items;
+    items.reserve( heap.size() );
+    for ( const RankedFile & file : asConst( heap ) )
+        items << file.second;
+
+    return items;
+}
+
 
-    _threshold = std::floor( upperPercentileThreshold( stats ) );
+void TopFilesTreeWalker::merge( QVector<FileInfo *> & items, const QVector<FileInfo *> & partResults ) const
+{
+    RankedFiles heap;
+    heap.reserve( MAX_RESULTS );
+    addRanked( heap, items );
+    addRanked( heap, partResults );
+
+    items.clear();
+    for ( const RankedFile & file : asConst( heap ) )
+        items << file.second;
 }
 
 
-bool NewFilesTreeWalker::check( const FileInfo * item )
+void TopFilesTreeWalker::collect( FileInfo * dir, RankedFiles & heap, const std::atomic<bool> & cancelled ) const
 {
-    return item && item->isFileOrSymlink() && item->mtime() >= _threshold;
+    if ( cancelled )
+        return;
+
+    for ( DotEntryIterator it{ dir }; *it; ++it )
+    {
+        if ( check( *it ) )
+            addToHeap( heap, RankedFile{ key( *it ), *it } );
+
+        if ( it->hasChildren() && !canSkip( *it, heap ) )
+            collect( *it, heap, cancelled );
+    }
 }
 
 
+bool TopFilesTreeWalker::canSkip( FileInfo * dir, const RankedFiles & heap ) const
+{
+    if ( heap.size() < MAX_RESULTS || !dir->isDirInfo() )
+        return false;
 
+    const DirTopFiles * topFiles = static_cast<DirInfo *>( dir )->topFiles();
+    if ( !topFiles )
+        return false;
 
-void OldFilesTreeWalker::prepare( FileInfo * subtree )
+    // Files which only equal the lowest ranked file in the heap wouldn't be added
+    const QVector<FileInfo *> & best = summary( topFiles );
+    return best.isEmpty() || key( best.first() ) <= heap.first().first;
+}
+
+
+void TopFilesTreeWalker::addRanked( RankedFiles & heap, const QVector<FileInfo *> & items ) const
 {
-    FileMTimeStats stats{ subtree };
+    for ( FileInfo * item : items )
+        addToHeap( heap, RankedFile{ key( item ), item } );
+}
+
+
 
-    _threshold = std::ceil( lowerPercentileThreshold( stats ) );
+
+qint64 LargestFilesTreeWalker::key( const FileInfo * item ) const
+{
+    return item->size();
 }
 
 
-bool OldFilesTreeWalker::check( const FileInfo * item )
+const QVector<FileInfo *> & LargestFilesTreeWalker::summary( const DirTopFiles * topFiles ) const
 {
-    return item && item->isFileOrSymlink() && item->mtime() <= _threshold;
+    return topFiles->largest();
 }
 
 
 
 
-bool HardLinkedFilesTreeWalker::check( const FileInfo * item )
+qint64 NewFilesTreeWalker::key( const FileInfo * item ) const
+{
+    return item->mtime();
+}
+
+
+const QVector<FileInfo *> & NewFilesTreeWalker::summary( const DirTopFiles * topFiles ) const
+{
+    return topFiles->newest();
+}
+
+
+
+
+qint64 OldFilesTreeWalker::key( const FileInfo * item ) const
+{
+    // The oldest files rank highest
+    return -static_cast<qint64>( item->mtime() );
+}
+
+
+const QVector<FileInfo *> & OldFilesTreeWalker::summary( const DirTopFiles * topFiles ) const
+{
+    return topFiles->oldest();
+}
+
+
+
+
+bool HardLinkedFilesTreeWalker::check( const FileInfo * item ) const
 {
     return item && item->isFile() && item->links() > 1;
 }
 
 
-bool BrokenSymlinksTreeWalker::check( const FileInfo * item )
+bool HardLinkedFilesTreeWalker::findResults( FileInfo * subtree, QVector<FileInfo *> & items )
+{
+    // Walk the tree instead if the table has files missing from it
+    const HardLinkTable * hardLinks = subtree->tree()->hardLinks();
+    if ( !hardLinks || hardLinks->isIncomplete() )
+        return false;
+
+    items = hardLinks->groupedLinks( subtree );
+
+    return true;
+}
+
+
+bool BrokenSymlinksTreeWalker::check( const FileInfo * item ) const
 {
     return item && item->isSymlink() && item->isBrokenSymlink();
 }
@@ -117,7 +255,7 @@ bool BrokenSymlinksTreeWalker::check( const FileInfo * item )
 
 
 
-bool SparseFilesTreeWalker::check( const FileInfo * item )
+bool SparseFilesTreeWalker::check( const FileInfo * item ) const
 {
     return item && item->isFile() && item->isSparseFile();
 }
@@ -125,7 +263,7 @@ bool SparseFilesTreeWalker::check( const FileInfo * item )
 
 
 
-bool FilesFromYearTreeWalker::check( const FileInfo * item )
+bool FilesFromYearTreeWalker::check( const FileInfo * item ) const
 {
     return item && item->isFileOrSymlink() && item->yearAndMonth().year == _year;
 }
@@ -133,7 +271,7 @@ bool FilesFromYearTreeWalker::check( const FileInfo * item )
 
 
 
-bool FilesFromMonthTreeWalker::check( const FileInfo * item )
+bool FilesFromMonthTreeWalker::check( const FileInfo * item ) const
 {
     if ( !item || !item->isFileOrSymlink() )
         return false;
@@ -145,21 +283,8 @@ bool FilesFromMonthTreeWalker::check( const FileInfo * item )
 
 
 
-void FindFilesTreeWalker::prepare( FileInfo * )
-{
-    _count = 0;
-    _overflow = false;
-}
-
-
-bool FindFilesTreeWalker::check( const FileInfo * item )
+bool FindFilesTreeWalker::check( const FileInfo * item ) const
 {
-    if ( _count >= MAX_FIND_FILES_RESULTS )
-    {
-        _overflow = true;
-        return false;
-    }
-
     if ( !item )
         return false;
 
@@ -171,10 +296,25 @@ bool FindFilesTreeWalker::check( const FileInfo * item )
         return false;
     }
 
-    if ( !_filter.matches( item->name() ) )
+    return _filter.matches( item->name() );
+}
+
+
+int FindFilesTreeWalker::maxResults() const
+{
+    return MAX_FIND_FILES_RESULTS;
+}
+
+
+bool FindFilesTreeWalker::findResults( FileInfo * subtree, QVector<FileInfo *> & items )
+{
+    const FileNameIndex * index = subtree && subtree->tree() ? subtree->tree()->nameIndex() : nullptr;
+    if ( !index )
         return false;
 
-    ++_count;
+    // Ask for one more than the limit so that an overflow is noticed
+    bool overflow;
+    items = index->find( _filter, subtree, MAX_FIND_FILES_RESULTS + 1, overflow );
 
     return true;
 }
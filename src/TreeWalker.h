@@ -10,12 +10,18 @@
 #ifndef TreeWalker_h
 #define TreeWalker_h
 
+#include <atomic>
+
+#include <QPair>
+#include <QVector>
+
 #include "FileSearchFilter.h"
 #include "Typedefs.h" // FileSize
 
 
 namespace QDirStat
 {
+    class DirTopFiles;
     class FileInfo;
 
     /**
@@ -47,8 +53,9 @@ namespace QDirStat
         TreeWalker & operator=( const TreeWalker & ) = delete;
 
         /**
-         * General preparations before items are checked.  The base
-         * implementation does nothing.
+         * General preparations before items are checked.  This is called
+         * in the main thread before any part of the tree is walked.  The
+         * base implementation does nothing.
          *
          * Derived classes can reimplement this to collect statistics,
          * calculate thresholds. or initialise variables.
@@ -59,102 +66,198 @@ namespace QDirStat
          * Check if 'item' fits into the category (largest / newest / oldest
          * file etc.). Return 'true' if it fits, 'false' if not.
          *
+         * This is called from several threads at once, so it must not
+         * modify the walker or the tree.
+         *
          * Derived classes are required to implement this.
          **/
-        virtual bool check( const FileInfo * item ) = 0;
+        virtual bool check( const FileInfo * item ) const = 0;
+
+        /**
+         * Return the maximum number of results, or 0 if there is no limit.
+         * The base class returns 0.
+         **/
+        virtual int maxResults() const { return 0; }
+
+        /**
+         * Return 'true' if the results from each part of the tree can be
+         * shown as soon as that part has been walked.  The base class
+         * returns 'true'.
+         *
+         * Derived classes whose results depend on the whole subtree return
+         * 'false' and combine the results of the parts in merge().
+         **/
+        virtual bool streamsResults() const { return true; }
 
         /**
-         * Flag: results overflow while walking the tree?  The base class
-         * always returns false indicating that there has been no overflow.
+         * Find the results for 'subtree' without walking the tree, for
+         * example from an index, and put them in 'items'.  Returns 'false'
+         * if that isn't possible.  This is called in the main thread.  The
+         * base class always returns 'false'.
+         **/
+        virtual bool findResults( FileInfo * /* subtree */, QVector<FileInfo *> & /* items */ ) { return false; }
+
+        /**
+         * Check the items in 'dir', including dot entries but not attics,
+         * and return those that fit into the category.  If 'recursive' is
+         * set, all the items below them are checked as well.  The walk
+         * stops early if 'cancelled' is set.
          *
-         * Derived classes can use this to indicate that the number of results
-         * was limited.
+         * This is called from worker threads for separate parts of the
+         * tree at the same time.  The base implementation calls check()
+         * for every item.
+         **/
+        virtual QVector<FileInfo *> walk( FileInfo                * dir,
+                                          bool                      recursive,
+                                          const std::atomic<bool> & cancelled ) const;
+
+        /**
+         * Add the results 'partResults' from walking one part of the tree
+         * to 'items'.  This is called in the main thread, and only if
+         * streamsResults() returns 'false'.  The base implementation
+         * appends them.
          **/
-        virtual bool overflow() const { return false; }
+        virtual void merge( QVector<FileInfo *> & items, const QVector<FileInfo *> & partResults ) const;
+
+
+    protected:
+
+        /**
+         * Check the items in 'dir' and, if 'recursive' is set, the items
+         * below them, adding those that fit into the category to 'items'.
+         **/
+        void walk( FileInfo                * dir,
+                   bool                      recursive,
+                   const std::atomic<bool> & cancelled,
+                   QVector<FileInfo *>     & items ) const;
 
     };  // class TreeWalker
 
 
 
     /**
-     * TreeWalker to find the largest files.
+     * Abstract base class to find a fixed number of files and symlinks
+     * with the highest values of some key, eg. the largest files.
+     *
+     * The files are collected in a single pass through the tree into a
+     * bounded min-heap, so the memory used depends only on the number of
+     * results, not on the size of the tree.  The heaps from separate
+     * subtrees can be merged to give the results for the whole tree.
+     *
+     * Once the heap is full, subtrees whose DirTopFiles summary shows
+     * that none of their files would make it into the heap are skipped.
+     * The summaries must be up to date before the walk starts, because
+     * they can only be rebuilt in the main thread.
+     *
+     * Derived classes are required to implement key() and summary().
      **/
-    class LargestFilesTreeWalker final : public TreeWalker
+    class TopFilesTreeWalker : public TreeWalker
     {
     public:
 
         /**
-         * Find the threshold for what is considered a "large file".
-         *
-         * Note that the percentile boundary is rounded down to an
-         * integer and the check is for values greater than, but not
-         * including, that integer value.  This is consistent with the
-         * definition of the percentile boundaries.
+         * Return 'true' if 'item' is a file or symlink, which could be
+         * one of the highest ranked files.
          **/
-        void prepare( FileInfo * subtree ) override;
+        bool check( const FileInfo * item ) const override;
 
-        bool check( const FileInfo * item ) override;
+        /**
+         * The results are only known once the whole subtree is walked.
+         **/
+        bool streamsResults() const override { return false; }
 
+        /**
+         * Return the highest ranked files in 'dir', or in the whole
+         * subtree if 'recursive' is set.
+         **/
+        QVector<FileInfo *> walk( FileInfo                * dir,
+                                  bool                      recursive,
+                                  const std::atomic<bool> & cancelled ) const override;
 
-    private:
+        /**
+         * Keep the highest ranked files from 'items' and 'partResults'.
+         **/
+        void merge( QVector<FileInfo *> & items, const QVector<FileInfo *> & partResults ) const override;
 
-        FileSize _threshold;
 
-    };  // class LargestFilesTreeWalker
+    protected:
 
+        typedef QPair<qint64, FileInfo *> RankedFile;
+        typedef QVector<RankedFile>        RankedFiles;
 
+        /**
+         * Return the rank of 'item', higher values are preferred.  This
+         * is only called for files and symlinks.
+         **/
+        virtual qint64 key( const FileInfo * item ) const = 0;
 
-    /**
-     * TreeWalker to find new files.
-     **/
-    class NewFilesTreeWalker final : public TreeWalker
-    {
-    public:
+        /**
+         * Return the list from 'topFiles' with the highest ranked files
+         * according to key(), highest first.
+         **/
+        virtual const QVector<FileInfo *> & summary( const DirTopFiles * topFiles ) const = 0;
 
         /**
-         * Find the threshold for what is considered a "new file".
-         *
-         * Note that the percentile boundary is rounded down to an
-         * integer and the check is for values greater than, but not
-         * including, that integer value.  This is consistent with the
-         * definition of the percentile boundaries.
+         * Return 'true' if the summary for 'dir' shows that none of its
+         * files would be added to the full 'heap'.
          **/
-        void prepare( FileInfo * subtree ) override;
+        bool canSkip( FileInfo * dir, const RankedFiles & heap ) const;
 
-        bool check( const FileInfo * item ) override;
+        /**
+         * Recursively add the files in 'dir' to 'heap', keeping only the
+         * highest ranked ones.
+         **/
+        void collect( FileInfo * dir, RankedFiles & heap, const std::atomic<bool> & cancelled ) const;
 
+        /**
+         * Add 'items' to 'heap', keeping only the highest ranked ones.
+         **/
+        void addRanked( RankedFiles & heap, const QVector<FileInfo *> & items ) const;
 
-    private:
+    };  // class TopFilesTreeWalker
 
-        time_t _threshold;
 
-    };  // class NewFilesTreeWalker
+
+    /**
+     * TreeWalker to find the largest files.
+     **/
+    class LargestFilesTreeWalker final : public TopFilesTreeWalker
+    {
+    protected:
+
+        qint64 key( const FileInfo * item ) const override;
+
+        const QVector<FileInfo *> & summary( const DirTopFiles * topFiles ) const override;
+
+    };  // class LargestFilesTreeWalker
 
 
 
     /**
-     * TreeWalker to find old files.
+     * TreeWalker to find new files.
      **/
-    class OldFilesTreeWalker final : public TreeWalker
+    class NewFilesTreeWalker final : public TopFilesTreeWalker
     {
-    public:
+    protected:
 
-        /**
-         * Find the threshold for what is considered an "old file".
-         *
-         * Note that the percentile boundary is rounded up to an
-         * integer and the check is for values less than, or equal to,
-         * that integer value.  This is consistent with the definition
-         * of the percentile boundaries.
-         **/
-        void prepare( FileInfo * subtree ) override;
+        qint64 key( const FileInfo * item ) const override;
 
-        bool check( const FileInfo * item ) override;
+        const QVector<FileInfo *> & summary( const DirTopFiles * topFiles ) const override;
 
+    };  // class NewFilesTreeWalker
 
-    private:
 
-        time_t _threshold;
+
+    /**
+     * TreeWalker to find old files.
+     **/
+    class OldFilesTreeWalker final : public TopFilesTreeWalker
+    {
+    protected:
+
+        qint64 key( const FileInfo * item ) const override;
+
+        const QVector<FileInfo *> & summary( const DirTopFiles * topFiles ) const override;
 
     };  // class OldFilesTreeWalker
 
@@ -162,12 +265,18 @@ namespace QDirStat
 
     /**
      * TreeWalker to find files with multiple hard links.
+     *
+     * If the tree counts hard links exactly, the results are taken from
+     * its HardLinkTable instead, with the links of each inode together,
+     * unless some files with multiple links are missing from the table.
      **/
     class HardLinkedFilesTreeWalker final : public TreeWalker
     {
     public:
 
-        bool check( const FileInfo * item ) override;
+        bool check( const FileInfo * item ) const override;
+
+        bool findResults( FileInfo * subtree, QVector<FileInfo *> & items ) override;
 
     }; // class HardLinkedFilesTreeWalker
 
@@ -180,7 +289,7 @@ namespace QDirStat
     {
     public:
 
-        bool check( const FileInfo * item ) override;
+        bool check( const FileInfo * item ) const override;
 
     };  // class BrokenSymlinksTreeWalker
 
@@ -193,7 +302,7 @@ namespace QDirStat
     {
     public:
 
-        bool check( const FileInfo * item ) override;
+        bool check( const FileInfo * item ) const override;
 
     };  // class SparseFilesTreeWalker
 
@@ -211,7 +320,7 @@ namespace QDirStat
             _year{ year }
         {}
 
-        bool check( const FileInfo * item ) override;
+        bool check( const FileInfo * item ) const override;
 
 
     private:
@@ -235,7 +344,7 @@ namespace QDirStat
             _month{ month }
         {}
 
-        bool check( const FileInfo * item ) override;
+        bool check( const FileInfo * item ) const override;
 
 
     private:
@@ -259,18 +368,20 @@ namespace QDirStat
             _filter{ filter }
         {}
 
-        void prepare( FileInfo * subtree ) override;
+        bool check( const FileInfo * item ) const override;
 
-        bool check( const FileInfo * item ) override;
+        int maxResults() const override;
 
-        bool overflow() const override { return _overflow; }
+        /**
+         * Find the matching items in 'subtree' using the name index of
+         * the tree if it has one.
+         **/
+        bool findResults( FileInfo * subtree, QVector<FileInfo *> & items ) override;
 
 
     private:
 
         FileSearchFilter _filter;
-        int              _count;
-        bool             _overflow;
 
     };   // class FindFilesTreeWalker
 
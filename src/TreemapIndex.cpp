@@ -0,0 +1,128 @@
+/*
+ *   File name: TreemapIndex.cpp
+ *   Summary:   Spatial index for treemap tiles for QDirStat
+ *   License:   GPL V2 - See file LICENSE for details.
+ *
+ *   Authors:   Stefan Hundhammer <Stefan.Hundhammer@gmx.de>
+ *              Ian Nartowicz
+ */
+
+#include <cmath> // ceil(), floor(), sqrt()
+
+#include "TreemapIndex.h"
+#include "TreemapTile.h"
+
+
+// Average number of visible tiles in each grid cell
+#define TILES_PER_CELL   4
+
+// Upper limit for the number of grid cells, only reached for enormous scenes
+#define MAX_CELLS        ( 1 << 20 )
+
+
+using namespace QDirStat;
+
+
+TreemapIndex::TreemapIndex( TreemapTile * rootTile ):
+    _sceneRect{ rootTile->rect() }
+{
+    QVector<TreemapTile *> leaves;
+    addTiles( rootTile, leaves );
+
+    if ( _sceneRect.isEmpty() || leaves.isEmpty() )
+	return;
+
+    // Size the cells so that each holds a handful of tiles on average
+    const double area = _sceneRect.width() * _sceneRect.height();
+    const int targetCells = qBound( 1, static_cast<int>( leaves.size() / TILES_PER_CELL ), MAX_CELLS );
+    const double cellSize = qMax( 1.0, std::sqrt( area / targetCells ) );
+
+    _cols = qMax( 1, static_cast<int>( std::ceil( _sceneRect.width()  / cellSize ) ) );
+    _rows = qMax( 1, static_cast<int>( std::ceil( _sceneRect.height() / cellSize ) ) );
+    _cellWidth  = _sceneRect.width()  / _cols;
+    _cellHeight = _sceneRect.height() / _rows;
+
+    // First pass: count the tiles overlapping each cell
+    _cellStart.fill( 0, _cols * _rows + 1 );
+    for ( const TreemapTile * tile : asConst( leaves ) )
+    {
+	int col1, row1, col2, row2;
+	cellRange( tile->rect(), col1, row1, col2, row2 );
+	for ( int row = row1; row <= row2; ++row )
+	{
+	    for ( int col = col1; col <= col2; ++col )
+		++_cellStart[ row * _cols + col + 1 ];
+	}
+    }
+
+    // Convert the counts to offsets into the packed tile array
+    for ( int i = 1; i < _cellStart.size(); ++i )
+	_cellStart[ i ] += _cellStart[ i - 1 ];
+
+    // Second pass: fill the packed array, using a running offset for each cell
+    QVector<int> fill{ _cellStart };
+    _cellTiles.resize( _cellStart.last() );
+    for ( TreemapTile * tile : asConst( leaves ) )
+    {
+	int col1, row1, col2, row2;
+	cellRange( tile->rect(), col1, row1, col2, row2 );
+	for ( int row = row1; row <= row2; ++row )
+	{
+	    for ( int col = col1; col <= col2; ++col )
+		_cellTiles[ fill[ row * _cols + col ]++ ] = tile;
+	}
+    }
+}
+
+
+void TreemapIndex::addTiles( TreemapTile * tile, QVector<TreemapTile *> & leaves )
+{
+    _tiles.insert( tile->orig(), tile );
+
+    // Only tiles with no child tiles are painted, see TreemapTile::paint()
+    const auto items = tile->childItems();
+    if ( items.isEmpty() )
+    {
+	leaves << tile;
+	return;
+    }
+
+    // Nothing other than tiles in the tree at this point
+    for ( QGraphicsItem * graphicsItem : items )
+	addTiles( static_cast<TreemapTile *>( graphicsItem ), leaves );
+}
+
+
+void TreemapIndex::cellRange( const QRectF & rect, int & col1, int & row1, int & col2, int & row2 ) const
+{
+    const double left   = ( rect.left()   - _sceneRect.left() ) / _cellWidth;
+    const double top    = ( rect.top()    - _sceneRect.top()  ) / _cellHeight;
+    const double right  = ( rect.right()  - _sceneRect.left() ) / _cellWidth;
+    const double bottom = ( rect.bottom() - _sceneRect.top()  ) / _cellHeight;
+
+    // Tiles that end exactly on a cell boundary don't reach into the next cell
+    col1 = qBound( 0, static_cast<int>( std::floor( left ) ), _cols - 1 );
+    row1 = qBound( 0, static_cast<int>( std::floor( top  ) ), _rows - 1 );
+    col2 = qBound( col1, static_cast<int>( std::ceil( right  ) ) - 1, _cols - 1 );
+    row2 = qBound( row1, static_cast<int>( std::ceil( bottom ) ) - 1, _rows - 1 );
+}
+
+
+TreemapTile * TreemapIndex::tileAt( const QPointF & pos ) const
+{
+    if ( _cellStart.isEmpty() || !_sceneRect.contains( pos ) )
+	return nullptr;
+
+    const int col = qMin( static_cast<int>( ( pos.x() - _sceneRect.left() ) / _cellWidth  ), _cols - 1 );
+    const int row = qMin( static_cast<int>( ( pos.y() - _sceneRect.top()  ) / _cellHeight ), _rows - 1 );
+    const int cell = row * _cols + col;
+
+    for ( int i = _cellStart.at( cell ); i < _cellStart.at( cell + 1 ); ++i )
+    {
+	TreemapTile * tile = _cellTiles.at( i );
+	if ( tile->rect().contains( pos ) )
+	    return tile;
+    }
+
+    return nullptr;
+}
@@ -0,0 +1,99 @@
+/*
+ *   File name: TreemapIndex.h
+ *   Summary:   Spatial index for treemap tiles for QDirStat
+ *   License:   GPL V2 - See file LICENSE for details.
+ *
+ *   Authors:   Stefan Hundhammer <Stefan.Hundhammer@gmx.de>
+ *              Ian Nartowicz
+ */
+
+#ifndef TreemapIndex_h
+#define TreemapIndex_h
+
+#include <QHash>
+#include <QRectF>
+#include <QVector>
+
+
+namespace QDirStat
+{
+    class FileInfo;
+    class TreemapTile;
+
+    /**
+     * Flat lookup structures for a completed treemap, so that the view
+     * doesn't have to ask the QGraphicsScene or walk the tile tree to
+     * find a tile.
+     *
+     * There are two parts: a hash of FileInfo pointers to the tile
+     * representing each of them, and a uniform grid of buckets covering
+     * the scene rectangle.  Each bucket holds the visible tiles (tiles
+     * without any child tiles) that overlap it.  Visible tiles never
+     * overlap each other, so the tile at any point is the one tile in its
+     * bucket that contains the point.  The buckets are packed into a
+     * single array with a separate array of offsets to the start of each
+     * bucket.
+     *
+     * The index is built in the treemap build thread once the layout is
+     * complete and is read-only after that.  It doesn't own any tiles and
+     * must be discarded along with the tiles.
+     **/
+    class TreemapIndex final
+    {
+    public:
+
+	/**
+	 * Constructor: index all the tiles under (and including) 'rootTile'.
+	 **/
+	TreemapIndex( TreemapTile * rootTile );
+
+	/**
+	 * Return the tile for 'node', or 0 if there is no tile for it in
+	 * this treemap.
+	 **/
+	TreemapTile * tile( const FileInfo * node ) const
+	    { return _tiles.value( node, nullptr ); }
+
+	/**
+	 * Return the visible (ie. painted) tile at scene position 'pos', or
+	 * 0 if there is no tile there.
+	 **/
+	TreemapTile * tileAt( const QPointF & pos ) const;
+
+	/**
+	 * Return the number of tiles in the index.
+	 **/
+	int tileCount() const { return _tiles.size(); }
+
+
+    protected:
+
+	/**
+	 * Recursively add 'tile' and its children to the FileInfo hash and
+	 * collect the visible tiles in 'leaves'.
+	 **/
+	void addTiles( TreemapTile * tile, QVector<TreemapTile *> & leaves );
+
+	/**
+	 * Return the range of grid columns and rows covered by 'rect'.
+	 **/
+	void cellRange( const QRectF & rect, int & col1, int & row1, int & col2, int & row2 ) const;
+
+
+    private:
+
+	QHash<const FileInfo *, TreemapTile *> _tiles;
+
+	QRectF                 _sceneRect;
+	int                    _cols{ 0 };
+	int                    _rows{ 0 };
+	double                 _cellWidth{ 1.0 };
+	double                 _cellHeight{ 1.0 };
+	QVector<int>           _cellStart;
+	QVector<TreemapTile *> _cellTiles;
+
+    };	// class TreemapIndex
+
+}	// namespace QDirStat
+
+#endif	// ifndef TreemapIndex_h
@@ -13,7 +13,6 @@
 #include <QImage>
 #include <QMenu>
 #include <QPainter>
-#include <QtConcurrent/QtConcurrent>
 
 #include "TreemapTile.h"
 #include "ActionManager.h"
@@ -33,6 +32,10 @@ namespace
      * Returns a suitable color for 'file' based on a set of internal rules
      * (according to filename extension, MIME type or permissions).
      *
+     * The category is normally looked up once when the file's directory is
+     * finalized, leaving just a palette lookup here.  Files that haven't
+     * been categorised go through the full (locked) lookup.
+     *
      * This function is defined here primarily to let the compiler inline
      * it as a performance-critical call.
      **/
@@ -41,6 +44,10 @@ namespace
         if ( parentView->fixedColor().isValid() )
             return parentView->fixedColor();
 
+        const quint8 categoryIndex = file->categoryIndex();
+        if ( categoryIndex != UncategorisedIndex )
+            return MimeCategorizer::instance()->paletteColor( categoryIndex );
+
         return MimeCategorizer::instance()->color( file );
     }
 
@@ -212,6 +219,9 @@ TreemapTile::TreemapTile( TreemapView  * parentView,
     // constructor with no parent tile, only used for the root tile
     init();
 
+    if ( !_parentView->canCreateChildTiles() )
+        return;
+
     if ( _parentView->squarify() )
         createSquarifiedChildren(rect);
     else if ( rect.width() > rect.height() )
@@ -219,11 +229,6 @@ TreemapTile::TreemapTile( TreemapView  * parentView,
     else
         createChildrenVertical( rect );
 
-//    _stopwatch.start();
-
-//    _parentView->threadPool()->waitForDone(); // destructor already waits
-
-//    logDebug() << _stopwatch.restart() << "ms for " << threads << " threads to finish" << (_parentView->treemapCancelled() ? " (cancelled)" : QString{}) << Qt::endl;
 }
 
 
@@ -251,7 +256,7 @@ HorizontalTreemapTile::HorizontalTreemapTile( TreemapTile  * parentTile,
                                               const QRectF & rect ) :
     TreemapTile{ parentTile, orig, rect }
 {
-    if ( orig->isDirInfo() )
+    if ( orig->isDirInfo() && _parentView->canCreateChildTiles() )
         createChildrenHorizontal( rect );
 }
 
@@ -261,7 +266,7 @@ VerticalTreemapTile::VerticalTreemapTile( TreemapTile  * parentTile,
                                           const QRectF & rect ) :
     TreemapTile{ parentTile, orig, rect }
 {
-    if ( orig->isDirInfo() )
+    if ( orig->isDirInfo() && _parentView->canCreateChildTiles() )
         createChildrenVertical( rect );
 }
 
@@ -284,7 +289,7 @@ TreemapTile::TreemapTile( TreemapTile          * parentTile,
     // constructor for squarified layout, with the cushion specified explicitly to allow for a row cushion
     init();
 
-    if ( orig->isDirInfo() )
+    if ( orig->isDirInfo() && _parentView->canCreateChildTiles() )
         createSquarifiedChildren( rect );
 }
 
@@ -299,8 +304,13 @@ void TreemapTile::init()
 
     setFlags( ItemIsSelectable );
 
-    if ( ( _orig->isDir() && _orig->totalSubDirsConst() == 0 ) || _orig->isDotEntry() )
-        setAcceptHoverEvents( true );
+    _parentView->tileCreated();
+}
+
+
+bool TreemapTile::isHoverTarget() const
+{
+    return ( _orig->isDir() && _orig->totalSubDirsConst() == 0 ) || _orig->isDotEntry();
 }
 
 
@@ -333,9 +343,9 @@ void TreemapTile::createChildrenHorizontal( const QRectF & rect )
             TreemapTile * tile = new VerticalTreemapTile{ this, *it, childRect };
             tile->cushionSurface().addHorizontalRidge( childRect.left(), childRect.right() );
 
-            if ( it->isDirInfo() )
-                addRenderThread( tile, 4 );
-//                tile->_cushion = tile->renderCushion( childRect );
+            // The cushion is complete once the ridge has been added
+            if ( !it->isDirInfo() )
+                _parentView->queueRender( tile );
 
             offset = newOffset;
             nextOffset = qMin( static_cast<double>( rect.width() ), newOffset + _parentView->minTileSize() );
@@ -375,9 +385,9 @@ void TreemapTile::createChildrenVertical( const QRectF & rect )
             TreemapTile * tile = new HorizontalTreemapTile{ this, *it, childRect };
             tile->cushionSurface().addVerticalRidge( childRect.top(), childRect.bottom() );
 
-            if ( it->isDirInfo() )
-                addRenderThread( tile, 4 );
-//                tile->_cushion = tile->renderCushion( childRect );
+            // The cushion is complete once the ridge has been added
+            if ( !it->isDirInfo() )
+                _parentView->queueRender( tile );
 
             offset = newOffset;
             nextOffset = qMin( static_cast<double>( rect.height() ), newOffset + _parentView->minTileSize() );
@@ -491,14 +501,16 @@ void TreemapTile::layoutRow( Orientation      dir,
 
             TreemapTile * tile = new TreemapTile{ this, *it, childRect, rowCushionSurface };
 
-            // Don't need to finish calculating cushions once all the leaf-level children have been created
-            if ( it->isDirInfo() )
-//                tile->_cushion = tile->renderCushion( childRect );
-                addRenderThread( tile, 6 );
-            else if ( dir == TreemapHorizontal )
-                tile->_cushionSurface.addHorizontalRidge( childRect.left(), childRect.right() );
-            else
-                tile->_cushionSurface.addVerticalRidge( childRect.top(), childRect.bottom() );
+            // Directory tiles don't need a finished cushion, their children have already been created
+            if ( !it->isDirInfo() )
+            {
+                if ( dir == TreemapHorizontal )
+                    tile->_cushionSurface.addHorizontalRidge( childRect.left(), childRect.right() );
+                else
+                    tile->_cushionSurface.addVerticalRidge( childRect.top(), childRect.bottom() );
+
+                _parentView->queueRender( tile );
+            }
 
             offset = newOffset;
             nextOffset = qMin( primary, newOffset + _parentView->minTileSize() );
@@ -509,56 +521,22 @@ void TreemapTile::layoutRow( Orientation      dir,
 }
 
 
-void TreemapTile::addRenderThread( TreemapTile * tile, int minThreadTileSize )
+void TreemapTile::render()
 {
-    // If the tile's parent is smaller than the threshold and not the root tile, then no thread
-    if ( parentItem() && rect().width() < _parentView->maxTileThreshold() &&
-         rect().height() < _parentView->maxTileThreshold() )
-        return;
-
-    // Not worth a thread for a tiny directory
-    if ( tile->rect().width() < minThreadTileSize || tile->rect().height() < minThreadTileSize )
-        return;
-
-    // If the tile itself is larger than the threshold and its children are sub-directories, no thread
-    if ( ( tile->rect().width() >= _parentView->maxTileThreshold() ||
-           tile->rect().height() >= _parentView->maxTileThreshold() ) &&
-         ( !tile->_orig->firstChild() || tile->_orig->firstChild()->isDirInfo() ) )
-         return;
-
-    //logDebug() << QThreadPool::globalInstance()->activeThreadCount() << " threads active" << Qt::endl;
-    // The API changed in Qt6!
-#if QT_VERSION < QT_VERSION_CHECK( 6, 0, 0 )
-    QtConcurrent::run( _parentView->threadPool(), tile, &TreemapTile::renderChildCushions );
-#else
-    std::ignore = QtConcurrent::run( _parentView->threadPool(), &TreemapTile::renderChildCushions, tile );
-#endif
+    if ( !_parentView->doCushionShading() )
+        setBrush( tileColor( _parentView, _orig ) );
+    else if ( _parentView->reserveCushion( rect() ) )
+        _parentView->addRenderedCushion( this, renderCushion( rect() ) );
 }
 
 
-void TreemapTile::renderChildCushions()
+QPixmap TreemapTile::renderCushion( const QRectF & rect ) const
 {
-    if ( _parentView->treemapCancelled() )
-        return;
-
-    const auto items = childItems();
-    for ( QGraphicsItem * graphicsItem : items )
-    {
-        // nothing other than tiles in the tree at this point
-        TreemapTile * tile = static_cast<TreemapTile * >( graphicsItem );
-
-        if ( tile->_orig->isDirInfo() )
-            tile->renderChildCushions();
-        else if ( _parentView->doCushionShading() )
-            tile->_cushion = tile->renderCushion( tile->rect() );
-        else
-            //tile->_pixmap = tile->renderPlainTile( tile->rect() );
-            tile->setBrush( tileColor( _parentView, tile->_orig ) );
-    }
+    return QPixmap::fromImage( renderCushionImage( rect ) );
 }
 
 
-QPixmap TreemapTile::renderCushion( const QRectF & rect )
+QImage TreemapTile::renderCushionImage( const QRectF & rect ) const
 {
     //logDebug() << rect << Qt::endl;
 
@@ -595,13 +573,42 @@ QPixmap TreemapTile::renderCushion( const QRectF & rect )
 //    if ( _parentView->enforceContrast() )
 //        enforceContrast( image );
 
-    return QPixmap::fromImage( image );
+    return image;
+}
+
+
+void TreemapTile::exportPaint( QPainter * painter, const QRectF & band ) const
+{
+    const QRectF rect = QGraphicsRectItem::rect();
+
+    if ( _orig->isDirInfo() )
+    {
+        const QBrush dirBrush = _parentView->dirBrush();
+        painter->fillRect( rect, dirBrush );
+        if ( dirBrush.style() == Qt::SolidPattern && _parentView->outlineColor().isValid() )
+            drawOutline( painter, rect, _parentView->outlineColor(), 5 );
+    }
+    else if ( _parentView->doCushionShading() )
+    {
+        // The cushion formula uses scene co-ordinates, so just the part inside the band can be rendered
+        const QRectF visibleRect = rect & band;
+        if ( !visibleRect.isEmpty() )
+            painter->drawImage( visibleRect.topLeft(), renderCushionImage( visibleRect ) );
+
+        if ( _parentView->forceCushionGrid() )
+            drawOutline( painter, rect, _parentView->cushionGridColor(), 10 );
+    }
+    else
+    {
+        painter->fillRect( rect, tileColor( _parentView, _orig ) );
+        if ( _parentView->outlineColor().isValid() )
+            drawOutline( painter, rect, _parentView->outlineColor(), 5 );
+    }
 }
 
 
 void TreemapTile::invalidateCushions()
 {
-    _cushion = QPixmap{};
     setBrush( QBrush{} );
 
     const auto items = childItems();
@@ -652,12 +659,19 @@ void TreemapTile::paint( QPainter                       * painter,
     {
         //logDebug() << rect << ", " << opaqueArea().boundingRect() << Qt::endl;
 
-        // The cushion pixmap is rendered when the treemap is built, but may be deleted to re-colour the map
-        if ( _cushion.isNull() )
-            _cushion = renderCushion( rect );
-
-        if ( !_cushion.isNull() )
-            painter->drawPixmap( rect.topLeft(), _cushion );
+        // Large cushions are usually rendered when the treemap is built, but may have been
+        // evicted from the cache or deleted to re-colour the map; small ones are never kept
+        const QPixmap * cachedCushion = _parentView->cachedCushion( this );
+        if ( cachedCushion )
+        {
+            painter->drawPixmap( rect.topLeft(), *cachedCushion );
+        }
+        else
+        {
+            const QPixmap cushion = renderCushion( rect );
+            painter->drawPixmap( rect.topLeft(), cushion );
+            _parentView->cacheCushion( this, cushion );
+        }
 
         // Draw a clearly visible tile boundary if configured
         if ( _parentView->forceCushionGrid() )
@@ -889,17 +903,3 @@ void TreemapTile::contextMenuEvent( QGraphicsSceneContextMenuEvent * event )
     QMenu * menu = ActionManager::createMenu( actions, enabledActions );
     menu->exec( event->screenPos() );
 }
-
-
-void TreemapTile::hoverEnterEvent( QGraphicsSceneHoverEvent * )
-{
-    // logDebug() << "Hovering over " << this << Qt::endl;
-    _parentView->sendHoverEnter( _orig );
-}
-
-
-void TreemapTile::hoverLeaveEvent( QGraphicsSceneHoverEvent * )
-{
-    // logDebug() << "  Leaving " << this << Qt::endl;
-    _parentView->sendHoverLeave( _orig );
-}
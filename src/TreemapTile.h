@@ -260,11 +260,35 @@ namespace QDirStat
 	TreemapTile * parentTile() const { return static_cast<TreemapTile *>( parentItem() ); }
 
 	/**
-	 * Removes all the cushion surface pixmaps and plain tile brushes to force
-	 * them to be re-rendered.
+	 * Returns whether this tile is reported for hovering: leaf-level
+	 * directories and dot entries are; files report their parent
+	 * directory instead.
+	 **/
+	bool isHoverTarget() const;
+
+	/**
+	 * Removes all the plain tile brushes to force them to be re-rendered.
+	 * The cushion pixmaps are held in the view's cushion cache.
 	 **/
 	void invalidateCushions();
 
+	/**
+	 * Render the cushion (or plain brush) of this leaf-level tile so that
+	 * paint() doesn't have to.  This is called from the render threads
+	 * and the tile must not be modified by the build thread any more.
+	 * Cushions are only rendered here if the view has room for them in
+	 * its cushion cache.
+	 **/
+	void render();
+
+	/**
+	 * Paint this leaf-level tile for an exported image, where 'band' is
+	 * the part of the treemap currently being drawn.  Unlike paint(),
+	 * this doesn't use the cushion cache or draw any highlights, and only
+	 * the part of a cushion inside 'band' is rendered.
+	 **/
+	void exportPaint( QPainter * painter, const QRectF & band ) const;
+
 	/**
 	 * Returns this tile's cushion surface parameters.
 	 **/
@@ -295,28 +319,6 @@ namespace QDirStat
 	void createChildrenHorizontal( const QRectF & rect );
 	void createChildrenVertical( const QRectF & rect );
 
-	/**
-	 * Create a thread for rendering the cushions of the children of this tile.
-	 *
-	 * The algorithm adds threads for the largest possible tiles up to a certain
-	 * threshold.  This attempts to balance having threads large enough to justify
-	 * the overhead of creating them while ensuring that rendering begins early
-	 * enough and in enough threads to speed up the whole process.  With more
-	 * processors, it is more effective to spawn larger threads later in the build
-	 * and have more of them running in parallel.  Very small tiles are also ignored
-	 * to avoid multiple threads with almost no work.  Such tiles will be very
-	 * quickly rendered in paint().
-	 *
-	 * The worst extremes are: small trees with only one child of the root, which
-	 * are rendered in a single thread spawned when the build is essentially complete;
-	 * they will be very fast with or without threading; and very "flat" trees such as
-	 * the packages view, where essentially every packages gets a thread. Even in
-	 * this last case, performance is good and despite the large number of threads
-	 * created, they complete quickly enough that there are only generally a small
-	 * number running in parallel.
-	 **/
-	void addRenderThread( TreemapTile * tile, int minThreadTileSize );
-
 	/**
 	 * Returns a pointer to the parent TreemapView.
 	 **/
@@ -366,13 +368,13 @@ namespace QDirStat
 	 * Render a cushion as described in "cushioned treemaps" by Jarke
 	 * J. van Wijk and Huub van de Wetering	 of the TU Eindhoven, NL.
 	 **/
-	QPixmap renderCushion( const QRectF & rect );
+	QPixmap renderCushion( const QRectF & rect ) const;
 
 	/**
-	 * Recursively iterate through all the children of this tile, rendering the cushions
-	 * of any leaf-level tiles.
+	 * Render the cushion for 'rect', which may be just part of this
+	 * tile, into an image.  This doesn't need a GUI thread.
 	 **/
-	void renderChildCushions();
+	QImage renderCushionImage( const QRectF & rect ) const;
 
 	/**
 	 * Paint this tile.
@@ -435,20 +437,6 @@ namespace QDirStat
 	 **/
 	void contextMenuEvent( QGraphicsSceneContextMenuEvent * event ) override;
 
-	/**
-	 * Hover enter event.
-	 *
-	 * Reimplemented from QGraphicsItem.
-	 **/
-	void hoverEnterEvent( QGraphicsSceneHoverEvent * ) override;
-
-	/**
-	 * Hover leave event.
-	 *
-	 * Reimplemented from QGraphicsItem.
-	 **/
-	void hoverLeaveEvent( QGraphicsSceneHoverEvent * ) override;
-
 
     private:
 
@@ -462,7 +450,6 @@ namespace QDirStat
 #endif
 
 	CushionSurface _cushionSurface;
-	QPixmap        _cushion;
 
 	SelectedTileHighlighter * _highlighter{ nullptr };
 
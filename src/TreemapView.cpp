@@ -7,20 +7,39 @@
  *              Ian Nartowicz
  */
 
+#include <algorithm> // remove_if(), sort()
+
+#include <QMouseEvent>
+#include <QPainter>
 #include <QResizeEvent>
 #include <QtConcurrent/QtConcurrent>
 
 #include "TreemapView.h"
+#include "TreemapIndex.h"
 #include "TreemapTile.h"
 #include "DirInfo.h"
 #include "DirTree.h"
 #include "Exception.h"
-#include "MimeCategorizer.h"
+#include "FormatUtil.h"
+#include "PngWriter.h"
 #include "SelectionModel.h"
 #include "Settings.h"
 #include "SignalBlocker.h"
 
 
+// Number of render tasks to aim for per render thread
+#define RENDER_TASKS_PER_THREAD  8
+
+// Smallest area in pixels worth submitting as a separate render task
+#define MIN_RENDER_TASK_AREA     ( 64 * 64 )
+
+// Milliseconds before an idle render thread exits and releases its memory
+#define RENDER_THREAD_EXPIRY     5000
+
+// Number of image rows painted at a time when exporting a treemap
+#define EXPORT_BAND_HEIGHT       256
+
+
 using namespace QDirStat;
 
 
@@ -40,35 +59,31 @@ namespace
 
 
     /**
-     * Search the treemap for a tile that corresponds to the specified
-     * FileInfo node. Returns 0 if there is none.
-     *
-     * Note that this is an expensive operation since all treemap tiles need
-     * to be searched.
+     * Returns the cost in the cushion cache of a cushion pixmap covering
+     * 'rect', in KB.
      **/
-    TreemapTile * findTile( TreemapTile * rootTile, const FileInfo * node )
+    int cushionCost( const QRectF & rect )
     {
-        if ( !node || !rootTile )
-            return nullptr;
+        const qint64 bytes = qRound64( rect.width() ) * qRound64( rect.height() ) * 4; // RGB32
+        return static_cast<int>( bytes / 1024 ) + 1;
+    }
 
-        // common case that is easy
-        if ( rootTile->orig() == node )
-            return rootTile;
 
-        // loop recursively through the children of each tile
-        const auto childItems = rootTile->childItems();
-        for ( QGraphicsItem * graphicsItem : childItems )
+    /**
+     * Recursively collect the tiles under 'tile' which have no child
+     * tiles, ie. the ones that are actually painted.
+     **/
+    void collectLeaves( const TreemapTile * tile, QVector<const TreemapTile *> & leaves )
+    {
+        const auto items = tile->childItems();
+        if ( items.isEmpty() )
         {
-            TreemapTile * tile = dynamic_cast<TreemapTile *>( graphicsItem );
-            if ( tile )
-            {
-                tile = findTile( tile, node );
-                if ( tile )
-                    return tile;
-            }
+            leaves << tile;
+            return;
         }
 
-        return nullptr;
+        for ( const QGraphicsItem * graphicsItem : items )
+            collectLeaves( static_cast<const TreemapTile *>( graphicsItem ), leaves );
     }
 
 } // namespace
@@ -80,11 +95,17 @@ TreemapView::TreemapView( QWidget * parent ):
     // Only one scene, never destroyed, create it now for simplicity
     setScene( new QGraphicsScene{ this } );
 
+    // The tiles don't accept hover events, so track the mouse here for the hover item
+    viewport()->setMouseTracking( true );
+
     readSettings();
 
     // We only ever need one thread at a time, and having more just chews up memory
     QThreadPool::globalInstance()->setMaxThreadCount( 1 );
 
+    // Render threads can hog many MB each, so let them go quickly when idle
+    _renderPool.setExpiryTimeout( RENDER_THREAD_EXPIRY );
+
     connect( &_watcher,  &QFutureWatcher<TreemapTile *>::finished,
              this,       &TreemapView::treemapFinished );
 }
@@ -92,6 +113,9 @@ TreemapView::TreemapView( QWidget * parent ):
 
 TreemapView::~TreemapView()
 {
+    // Make sure no build or render threads are still using this view
+    cancelTreemap();
+
     // Write settings back to file, but only if we are the real treemapView
     if ( _selectionModel )
         writeSettings();
@@ -123,6 +147,10 @@ void TreemapView::clear()
         _rootTile = nullptr;
     }
 
+    _tileIndex.reset();
+    _cushionCache.clear();
+    _hoverItem = nullptr;
+
     _currentTileHighlighter = nullptr;
     _sceneMask              = nullptr;
 
@@ -154,6 +182,9 @@ void TreemapView::setDirTree( const DirTree * newTree )
 
     connect( _tree, &DirTree::clearingSubtree,
              this,  &TreemapView::disable );
+
+    connect( _tree, &DirTree::recategorizing,
+             this,  &TreemapView::recategorizing );
 }
 
 
@@ -178,8 +209,8 @@ void TreemapView::setSelectionModel( SelectionModel * selectionModel )
              this,                 &TreemapView::updateSelection);
 
     // Connect this one here because it is only relevant in the real treemap
-    connect( MimeCategorizer::instance(), &MimeCategorizer::categoriesChanged,
-             this,                        &TreemapView::changeTreemapColors );
+    connect( _tree, &DirTree::recategorized,
+             this,  &TreemapView::changeTreemapColors );
 }
 
 
@@ -200,6 +231,9 @@ void TreemapView::readSettings()
     _heightScaleFactor  = settings.value( "HeightScaleFactor", DefaultHeightScaleFactor ).toDouble();
     _cushionHeight      = settings.value( "CushionHeight",     DefaultCushionHeight     ).toDouble();
     _minTileSize        = settings.value( "MinTileSize",       DefaultMinTileSize       ).toInt();
+    _renderThreads      = settings.value( "RenderThreads",     0                        ).toInt();
+    _cushionCacheSize   = settings.value( "CushionCacheSize",  DefaultCushionCacheSize  ).toInt();
+    _cushionCacheArea   = settings.value( "CushionCacheArea",  DefaultCushionCacheArea  ).toInt();
 
     _tileFixedColor     = settings.colorValue( "TileFixedColor",     QColor{}                   );
     _currentItemColor   = settings.colorValue( "CurrentItemColor",   Qt::red                    );
@@ -233,6 +267,9 @@ void TreemapView::writeSettings()
     settings.setValue( "HeightScaleFactor", _heightScaleFactor );
     settings.setValue( "CushionHeight",     _cushionHeight     );
     settings.setValue( "MinTileSize",       _minTileSize       );
+    settings.setValue( "RenderThreads",     _renderThreads     );
+    settings.setValue( "CushionCacheSize",  _cushionCacheSize  );
+    settings.setValue( "CushionCacheArea",  _cushionCacheArea  );
 
     writeOptionalColorEntry( settings, "TileFixedColor", _tileFixedColor );
 
@@ -389,18 +426,30 @@ void TreemapView::rebuildTreemap( FileInfo * newRoot )
 
     _treemapCancel = TreemapCancelNone;
     _treemapRunning = true;
+    _newRoot = newRoot; // in case the build has to be restarted
 
     _stopwatch.start();
 
+    // Split the rendering into batches of similar pixel area, enough to keep all the threads busy
+    const double taskArea = rect.width() * rect.height() / ( _renderPool.maxThreadCount() * RENDER_TASKS_PER_THREAD );
+    _renderChunkArea = qMax( taskArea, 1.0 * MIN_RENDER_TASK_AREA );
+    _renderBatchArea = 0.0;
+    _renderTasks     = 0;
+    _renderedTiles   = 0;
+    _renderBusyNs    = 0;
+    _reservedCushionCost = 0;
+
     _watcher.setFuture( QtConcurrent::run( [ this, newRoot, rect ]()
     {
-        // By default the number of CPUs, which will sometimes block creation of render threads
-        _threadPool = new QThreadPool{};
-        _threadPool->setMaxThreadCount( _threadPool->maxThreadCount() * 2 );
-
         TreemapTile * tile = new TreemapTile{ this, newRoot, rect };
 
-        delete _threadPool; // will wait for all the render threads to complete
+        // Render whatever is left over and wait for all the render threads to finish
+        flushRenderBatch();
+        _renderPool.waitForDone();
+
+        // Index the finished layout here rather than in the GUI thread
+        if ( !treemapCancelled() )
+            _newTileIndex = new TreemapIndex{ tile };
 
         if ( treemapCancelled() )
         {
@@ -417,11 +466,142 @@ void TreemapView::rebuildTreemap( FileInfo * newRoot )
 }
 
 
+void TreemapView::queueRender( TreemapTile * tile )
+{
+    // Exported tiles are painted band by band, there is no point rendering whole cushions
+    if ( _exporting )
+        return;
+
+    _renderBatch << tile;
+    _renderBatchArea += tile->rect().width() * tile->rect().height();
+
+    if ( _renderBatchArea >= _renderChunkArea )
+        flushRenderBatch();
+}
+
+
+void TreemapView::flushRenderBatch()
+{
+    if ( _renderBatch.isEmpty() )
+        return;
+
+    const auto renderBatch = [ this ]( const QVector<TreemapTile *> & batch )
+    {
+        QElapsedTimer busyTimer;
+        busyTimer.start();
+
+        // Check for cancellation at every tile so a new build doesn't have to wait
+        int rendered = 0;
+        for ( TreemapTile * tile : batch )
+        {
+            if ( treemapCancelled() )
+                break;
+
+            tile->render();
+            ++rendered;
+        }
+
+        _renderedTiles += rendered;
+        _renderBusyNs  += busyTimer.nsecsElapsed();
+    };
+
+#if QT_VERSION < QT_VERSION_CHECK( 6, 0, 0 )
+    QtConcurrent::run( &_renderPool, renderBatch, _renderBatch );
+#else
+    std::ignore = QtConcurrent::run( &_renderPool, renderBatch, _renderBatch );
+#endif
+
+    ++_renderTasks;
+    _renderBatch.clear();
+    _renderBatchArea = 0.0;
+}
+
+
+bool TreemapView::reserveCushion( const QRectF & rect )
+{
+    if ( rect.width() * rect.height() < _cushionCacheArea )
+        return false;
+
+    const int cost = cushionCost( rect );
+    if ( _reservedCushionCost.fetch_add( cost ) + cost > _cushionCacheMaxCost )
+    {
+        _reservedCushionCost -= cost;
+        return false;
+    }
+
+    return true;
+}
+
+
+void TreemapView::addRenderedCushion( const TreemapTile * tile, const QPixmap & cushion )
+{
+    QMutexLocker locker{ &_renderedCushionsMutex };
+    _renderedCushions.append( qMakePair( tile, cushion ) );
+}
+
+
+void TreemapView::cacheCushion( const TreemapTile * tile, const QPixmap & cushion )
+{
+    const QRectF rect = tile->rect();
+    if ( rect.width() * rect.height() >= _cushionCacheArea )
+        _cushionCache.insert( tile, new QPixmap{ cushion }, cushionCost( rect ) );
+}
+
+
+int TreemapView::tileCount() const
+{
+    return _tileIndex ? _tileIndex->tileCount() : 0;
+}
+
+
+qint64 TreemapView::tileMemory() const
+{
+    return tileCount() * static_cast<qint64>( sizeof( TreemapTile ) );
+}
+
+
+qint64 TreemapView::cushionMemory() const
+{
+    return _cushionCache.totalCost() * 1024LL;
+}
+
+
+void TreemapView::logRenderStats( qint64 buildMs ) const
+{
+    // Utilisation is the fraction of the available thread time spent rendering
+    const int    threads     = _renderPool.maxThreadCount();
+    const double busyMs      = _renderBusyNs.load() / 1000000.0;
+    const double utilisation = buildMs > 0 ? 100.0 * busyMs / ( buildMs * threads ) : 0.0;
+
+    logDebug() << buildMs << "ms, "
+               << _renderedTiles.load() << " tiles in "
+               << _renderTasks << " render tasks on "
+               << threads << " threads, "
+               << qRound( busyMs ) << "ms rendering ("
+               << qRound( utilisation ) << "% utilisation)"
+               << Qt::endl;
+
+    logDebug() << tileCount() << " tiles using "
+               << formatSize( tileMemory() ) << ", "
+               << _cushionCache.count() << " cached cushions using "
+               << formatSize( cushionMemory() ) << " of "
+               << formatSize( cushionMemoryLimit() )
+               << Qt::endl;
+}
+
+
 void TreemapView::treemapFinished()
 {
     TreemapTile * futureResult = _watcher.result();
 
-    logDebug() << _stopwatch.restart() << "ms " << Qt::endl;
+    // Take ownership of any index and cushions from the build thread so they are always freed
+    std::unique_ptr<const TreemapIndex> newTileIndex{ _newTileIndex };
+    _newTileIndex = nullptr;
+
+    QVector<QPair<const TreemapTile *, QPixmap> > renderedCushions;
+    renderedCushions.swap( _renderedCushions );
+
+    logRenderStats( _stopwatch.restart() );
 
     _treemapRunning = false;
 
@@ -453,6 +633,10 @@ void TreemapView::treemapFinished()
 
     // Add the new treemap to the scene
     _rootTile = futureResult;
+    _tileIndex = std::move( newTileIndex );
+    for ( const auto & cushion : asConst( renderedCushions ) )
+        _cushionCache.insert( cushion.first, new QPixmap{ cushion.second }, cushionCost( cushion.first->rect() ) );
+
     scene()->setSceneRect( _rootTile->rect() );
     scene()->addItem( _rootTile );
 
@@ -468,6 +652,87 @@ void TreemapView::treemapFinished()
 }
 
 
+bool TreemapView::exportImage( FileInfo * root, const QSize & size, const QString & fileName )
+{
+    if ( !root || root->totalAllocatedSize() == 0 || size.isEmpty() )
+    {
+        logError() << "Nothing to export" << Qt::endl;
+        return false;
+    }
+
+    if ( _treemapRunning )
+    {
+        logError() << "Can't export while a treemap is being built" << Qt::endl;
+        return false;
+    }
+
+    // Build a separate tile tree for the requested size, in this thread
+    QElapsedTimer timer;
+    timer.start();
+
+    _treemapCancel = TreemapCancelNone;
+    _exporting = true;
+    _exportTiles = 0;
+    const std::unique_ptr<const TreemapTile> rootTile{ new TreemapTile{ this, root, QRectF{ QPointF{}, size } } };
+    _exporting = false;
+
+    if ( _exportTiles >= MaxExportTiles )
+        logWarning() << "Stopped laying out directories after " << _exportTiles << " tiles" << Qt::endl;
+
+    // Paint the tiles from the top down so that each one is only considered for the bands it covers
+    QVector<const TreemapTile *> leaves;
+    collectLeaves( rootTile.get(), leaves );
+    std::sort( leaves.begin(), leaves.end(), []( const TreemapTile * tile1, const TreemapTile * tile2 )
+    {
+        return tile1->rect().top() < tile2->rect().top();
+    } );
+
+    PngWriter writer{ fileName, size.width(), size.height() };
+    if ( !writer.isOk() )
+        return false;
+
+    // Only one band of the image is ever in memory
+    QImage band{ size.width(), qMin( EXPORT_BAND_HEIGHT, size.height() ), QImage::Format_RGB32 };
+    QVector<const TreemapTile *> bandTiles;
+    auto nextTile = leaves.cbegin();
+
+    for ( int top = 0; top < size.height(); top += band.height() )
+    {
+        const int rows = qMin( band.height(), size.height() - top );
+        const QRectF bandRect{ 0.0, 1.0 * top, 1.0 * size.width(), 1.0 * rows };
+
+        // Drop the tiles that ended above this band and add the ones that start in it
+        const auto tileAbove = [ &bandRect ]( const TreemapTile * tile )
+            { return tile->rect().bottom() <= bandRect.top(); };
+        bandTiles.erase( std::remove_if( bandTiles.begin(), bandTiles.end(), tileAbove ), bandTiles.end() );
+        while ( nextTile != leaves.cend() && ( *nextTile )->rect().top() < bandRect.bottom() )
+            bandTiles << *nextTile++;
+
+        // Any gaps between the tiles show the background, the same as in the view
+        band.fill( palette().color( QPalette::Base ) );
+
+        QPainter painter{ &band };
+        painter.translate( 0.0, -bandRect.top() );
+        painter.setClipRect( bandRect );
+        for ( const TreemapTile * tile : asConst( bandTiles ) )
+            tile->exportPaint( &painter, bandRect );
+        painter.end();
+
+        for ( int y = 0; y < rows; ++y )
+            writer.writeRow( reinterpret_cast<const QRgb *>( band.constScanLine( y ) ) );
+    }
+
+    if ( !writer.finish() )
+        return false;
+
+    logInfo() << "Exported " << leaves.size() << " tiles to " << fileName
+              << " (" << size.width() << "x" << size.height() << ") in "
+              << timer.elapsed() << "ms" << Qt::endl;
+
+    return true;
+}
+
+
 void TreemapView::configChanged( const QColor & fixedColor,
                                  bool           squarified,
                                  bool           cushionShading,
@@ -509,8 +774,12 @@ void TreemapView::calculateSettings()
     // Pre-calculate cushion heights from the configured starting height and scale factor.
     _cushionHeights.reset( new CushionHeightSequence{ _cushionHeight, _heightScaleFactor } );
 
-    // Calculate thresholds for tile sizes that will be submitted to a render thread
-    _maxTileThreshold = ( _squarify ? 150 : 75 ) + 10 * QThread::idealThreadCount();
+    // Limit the memory used by cached cushions, evicting the oldest now if necessary
+    _cushionCacheMaxCost = qMax( 0, _cushionCacheSize ) * 1024;
+    _cushionCache.setMaxCost( _cushionCacheMaxCost );
+
+    // Use all the processors for rendering unless configured otherwise
+    _renderPool.setMaxThreadCount( _renderThreads > 0 ? _renderThreads : QThread::idealThreadCount() );
 
     // Calculate the minimum height for generating a row of squarified tiles
     _minSquarifiedTileHeight = _minTileSize == 0 ? 0 : _minTileSize - 0.5;
@@ -534,6 +803,8 @@ void TreemapView::calculateSettings()
 
 void TreemapView::changeTreemapColors()
 {
+    _cushionCache.clear();
+
     if ( _rootTile )
     {
         _rootTile->invalidateCushions();
@@ -541,6 +812,18 @@ void TreemapView::changeTreemapColors()
     }
 }
 
+
+void TreemapView::recategorizing()
+{
+    // The finished() slot will start the build again once the categories are done
+    if ( _treemapRunning )
+    {
+        _treemapCancel = TreemapCancelRestart;
+        _watcher.waitForFinished();
+    }
+}
+
+
 void TreemapView::deleteNotify( FileInfo * )
 {
     if ( _rootTile )
@@ -699,7 +982,7 @@ void TreemapView::setCurrentItem( FileInfo * node )
         rebuildTreemap( treemapRoot );
     }
 
-    setCurrentTile( findTile( _rootTile, node ) );
+    setCurrentTile( findTile( node ) );
 }
 
 
@@ -714,30 +997,14 @@ void TreemapView::updateSelection( const FileInfoSet & newSelection )
     SignalBlocker sigBlocker{ this };
     scene()->clearSelection();
 
-    QHash<const FileInfo *, TreemapTile *> map;
-    if ( newSelection.size() > 10 )
-    {
-        // Build a mapping of all fileInfo objects to tiles for scaling to very large selections
-        const auto items = scene()->items();
-        for ( QGraphicsItem * graphicsItem : items )
-        {
-            TreemapTile * tile = dynamic_cast<TreemapTile *>( graphicsItem );
-            if ( tile )
-                map.insert( tile->orig(), tile );
-        }
-    }
-
-    //logDebug() << " map built in " << _stopwatch.restart() << "ms" << (map.isEmpty() ? " (empty) " : QString{}) << Qt::endl;
-
     for ( const FileInfo * item : newSelection )
     {
-        TreemapTile * tile = map.isEmpty() ? findTile( _rootTile, item ) : map.value( item, nullptr );
+        TreemapTile * tile = findTile( item );
         if ( tile )
             tile->setSelected( true );
     }
 
-    const FileInfo * currentItem = _selectionModel->currentItem();
-    const TreemapTile * tile = map.isEmpty() ? findTile( _rootTile, currentItem ) : map.value( currentItem, nullptr );
+    const TreemapTile * tile = findTile( _selectionModel->currentItem() );
     if ( tile )
         setCurrentTile( tile );
 
@@ -798,6 +1065,59 @@ void TreemapView::setFixedColor( const QColor & color )
 }
 
 
+TreemapTile * TreemapView::findTile( const FileInfo * node ) const
+{
+    return _tileIndex && node ? _tileIndex->tile( node ) : nullptr;
+}
+
+
+void TreemapView::mouseMoveEvent( QMouseEvent * event )
+{
+    QGraphicsView::mouseMoveEvent( event );
+
+    if ( !_useTreemapHover || !_tileIndex )
+        return;
+
+#if QT_VERSION < QT_VERSION_CHECK( 6, 0, 0 )
+    const QPoint viewportPos = event->pos();
+#else
+    const QPoint viewportPos = event->position().toPoint();
+#endif
+
+    // Report the nearest tile that is a hover target: the leaf directory or dot entry, not a file
+    const TreemapTile * tile = _tileIndex->tileAt( mapToScene( viewportPos ) );
+    while ( tile && !tile->isHoverTarget() )
+        tile = tile->parentTile();
+
+    setHoverItem( tile ? tile->orig() : nullptr );
+}
+
+
+void TreemapView::leaveEvent( QEvent * event )
+{
+    QGraphicsView::leaveEvent( event );
+
+    setHoverItem( nullptr );
+}
+
+
+void TreemapView::setHoverItem( FileInfo * item )
+{
+    if ( item == _hoverItem )
+        return;
+
+    //logDebug() << "Hovering over " << item << Qt::endl;
+
+    if ( _hoverItem )
+        sendHoverLeave( _hoverItem );
+
+    _hoverItem = item;
+
+    if ( _hoverItem )
+        sendHoverEnter( _hoverItem );
+}
+
+
 void TreemapView::highlightParents( const TreemapTile * tile )
 {
     if ( !tile )
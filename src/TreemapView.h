@@ -12,17 +12,23 @@
 
 #include <memory>
 
+#include <QCache>
 #include <QElapsedTimer>
 #include <QFutureWatcher>
 #include <QGraphicsPathItem>
 #include <QGraphicsRectItem>
 #include <QGraphicsView>
+#include <QMutex>
+#include <QThreadPool>
 
 
 #define DefaultAmbientLight       40
 #define DefaultHeightScaleFactor   0.8
 #define DefaultCushionHeight       0.5
 #define DefaultMinTileSize         3
+#define DefaultCushionCacheSize  256 // MB
+#define DefaultCushionCacheArea 1024 // pixels
+#define MaxExportTiles       1000000 // tiles in an exported image
 
 
 namespace QDirStat
@@ -31,6 +37,7 @@ namespace QDirStat
     class ParentTileHighlighter;
     class SceneMask;
     class CushionHeightSequence;
+    class TreemapIndex;
     class TreemapTile;
     class CleanupCollection;
     class DirTree;
@@ -173,15 +180,26 @@ namespace QDirStat
 	void enable();
 
 	/**
-	 * Returns a value used by the treemap to create render threads.  Directories
-	 * smaller than this value that have parents larger than this value are
-	 * submitted to be rendered in a thread.  The value is adjusted based on the
-	 * number of available processors.  Larger values mean that larger directories
-	 * will be processed in each thread, but threads will not be submitted until
-	 * later in the treemap build, useful for reducing the number of threads created
-	 * when they can be rendered in parallel on multiple processors.
+	 * Write a treemap of 'root' as a PNG image of 'size' pixels to
+	 * 'fileName'.  This works without a visible view and doesn't affect
+	 * the current treemap.  The tiles are laid out as usual, but painted
+	 * into the image a band of rows at a time, so the image can be much
+	 * larger than the screen or than would fit in memory.
+	 *
+	 * The tiles are all in memory at once, so the layout stops going
+	 * into directories once about MaxExportTiles tiles have been
+	 * created, and the rest of the directories are drawn as plain
+	 * directory tiles without their contents.
+	 *
+	 * Returns 'true' if the image was written successfully.
+	 **/
+	bool exportImage( FileInfo * root, const QSize & size, const QString & fileName );
+
+	/**
+	 * Return the tile for 'node' or 0 if there is no tile for that item
+	 * in the current treemap.  This is a hash lookup in the tile index.
 	 **/
-	int maxTileThreshold() const { return _maxTileThreshold; }
+	TreemapTile * findTile( const FileInfo * node ) const;
 
 	/**
 	 * Returns whether the treemap has been asked to stop building.
@@ -189,11 +207,67 @@ namespace QDirStat
 	bool treemapCancelled() const { return _treemapCancel != TreemapCancelNone; }
 
 	/**
-	 * Return the thread pool for rendering threads.  A dedicated pool is used for
-	 * this so that the memory used in threads can be reclaimed; otherwise a
-	 * moderately large number of threads will permanently hog many MB each.
+	 * Queue a finished leaf tile to have its cushion rendered.  Tiles are
+	 * collected into batches of roughly equal pixel area, regardless of
+	 * where they are in the tree, and each batch is submitted to the
+	 * render thread pool as one task.  Idle threads pick up the next
+	 * batch, so large and small subtrees are spread evenly across all the
+	 * threads.
+	 *
+	 * This must only be called from the treemap build thread.
+	 **/
+	void queueRender( TreemapTile * tile );
+
+	/**
+	 * Reserve space in the cushion cache for a cushion the size of
+	 * 'rect'.  Returns 'false' if the cushion is too small to be worth
+	 * caching or the cache budget has already been used up by the render
+	 * threads, in which case the cushion will be rendered in paint()
+	 * instead.
+	 *
+	 * This is thread-safe and is called from the render threads.
+	 **/
+	bool reserveCushion( const QRectF & rect );
+
+	/**
+	 * Store a cushion rendered by a render thread.  The cushions are
+	 * added to the cache when the build is complete.
+	 *
+	 * This is thread-safe and is called from the render threads.
+	 **/
+	void addRenderedCushion( const TreemapTile * tile, const QPixmap & cushion );
+
+	/**
+	 * Return the cached cushion pixmap for 'tile' or 0 if there is none.
+	 * The cushion becomes the most recently used one in the cache.
+	 **/
+	const QPixmap * cachedCushion( const TreemapTile * tile ) const
+	    { return _cushionCache.object( tile ); }
+
+	/**
+	 * Add a cushion rendered in paint() to the cache if it is large
+	 * enough to be worth keeping.  The least recently used cushions are
+	 * dropped if the cache is over its memory budget.
+	 **/
+	void cacheCushion( const TreemapTile * tile, const QPixmap & cushion );
+
+	/**
+	 * Return the number of tiles in the current treemap.
+	 **/
+	int tileCount() const;
+
+	/**
+	 * Return the approximate memory in bytes used by the tiles of the
+	 * current treemap and by the cached cushion pixmaps.
+	 **/
+	qint64 tileMemory() const;
+	qint64 cushionMemory() const;
+
+	/**
+	 * Return the most memory in bytes that the cached cushion pixmaps
+	 * may use.
 	 **/
-	QThreadPool * threadPool() { return _threadPool; }
+	qint64 cushionMemoryLimit() const { return _cushionCacheMaxCost * 1024LL; }
 
 	/**
 	 * Returns true if it is possible to zoom in with the currently
@@ -306,6 +380,18 @@ namespace QDirStat
 	 **/
 	double minSquarifiedTileHeight() const { return _minSquarifiedTileHeight; }
 
+	/**
+	 * Returns 'true' if the children of a directory tile should be
+	 * created.  This is always true except when building the tiles for
+	 * exportImage() once MaxExportTiles tiles have been created.
+	 **/
+	bool canCreateChildTiles() const { return !_exporting || _exportTiles < MaxExportTiles; }
+
+	/**
+	 * Count a new tile for the limit on exported tiles.
+	 **/
+	void tileCreated() { if ( _exporting ) ++_exportTiles; }
+
 	/**
 	 * Returns the cushion grid color.
 	 **/
@@ -491,10 +577,19 @@ namespace QDirStat
     protected slots:
 
 	/**
-	 * The Mime categories have changed and the map needs to be re-coloured.
+	 * The categories of the files have changed and the map needs to be
+	 * re-coloured.
 	 **/
 	void changeTreemapColors();
 
+	/**
+	 * The category of every file in the tree is about to be looked up
+	 * again.  Any treemap build is cancelled while the categories
+	 * change, because its render threads read them, and started again
+	 * afterwards.
+	 **/
+	void recategorizing();
+
 	/**
 	 * Update the selected items that have been selected in another view.
 	 **/
@@ -575,6 +670,28 @@ namespace QDirStat
 	 **/
 	void resizeEvent( QResizeEvent * event ) override;
 
+	/**
+	 * Mouse move event: track the tile being hovered over.  The tile is
+	 * found from the tile index rather than by having the scene deliver
+	 * hover events to the tiles.
+	 *
+	 * Reimplemented from QGraphicsView.
+	 **/
+	void mouseMoveEvent( QMouseEvent * event ) override;
+
+	/**
+	 * Leave event: the mouse is no longer hovering over any tile.
+	 *
+	 * Reimplemented from QWidget.
+	 **/
+	void leaveEvent( QEvent * event ) override;
+
+	/**
+	 * Set the item that the mouse is hovering over and send hoverLeave()
+	 * and hoverEnter() signals if it has changed.  'item' may be 0.
+	 **/
+	void setHoverItem( FileInfo * item );
+
 	/**
 	 * Highlight the parent tiles of item 'tile'.
 	 **/
@@ -590,6 +707,18 @@ namespace QDirStat
 	 **/
 	void cancelTreemap();
 
+	/**
+	 * Submit the current batch of tiles to the render thread pool.  This
+	 * is only called from the treemap build thread.
+	 **/
+	void flushRenderBatch();
+
+	/**
+	 * Log the render thread statistics and the memory used by the tiles
+	 * and cushions for the last build.
+	 **/
+	void logRenderStats( qint64 buildMs ) const;
+
 
     private:
 
@@ -598,6 +727,7 @@ namespace QDirStat
 	SelectionModelProxy * _selectionModelProxy{ nullptr };
 
 	TreemapTile         * _rootTile{ nullptr };
+	FileInfo            * _hoverItem{ nullptr };
 	HighlightRect       * _currentTileHighlighter{ nullptr };
 	const SceneMask     * _sceneMask{ nullptr };
 	FileInfo            * _newRoot{ nullptr };
@@ -628,7 +758,9 @@ namespace QDirStat
 	double _cushionHeight;
 	double _minTileSize;
 	double _minSquarifiedTileHeight;
-	int    _maxTileThreshold; // largest sub-tree size at which to spawn a rendering thread
+	int    _renderThreads;
+	int    _cushionCacheSize;    // MB
+	int    _cushionCacheArea;    // pixels
 	double _ambientIntensity;
 	double _lightX;
 	double _lightY;
@@ -638,10 +770,30 @@ namespace QDirStat
 
 	bool _disabled{ false };       // flag to disable all treemap builds
 	bool _treemapRunning{ false }; // internal flag to avoid race conditions when cancelling builds
+	bool _exporting{ false };      // building tiles for exportImage()
+	int  _exportTiles{ 0 };        // tiles created so far for exportImage()
+
+	std::unique_ptr<const TreemapIndex> _tileIndex;
+	const TreemapIndex * _newTileIndex{ nullptr }; // handed over from the build thread
 
 	QFutureWatcher<TreemapTile *>   _watcher;
 	std::atomic<TreemapCancel>      _treemapCancel{ TreemapCancelNone }; // flag to the treemap build thread
-	QThreadPool                   * _threadPool{ nullptr }; // dedicated thread pool for rendering
+
+	// Render threads, only used by the build thread apart from the statistics
+	QThreadPool                     _renderPool; // persistent pool dedicated to rendering
+	QVector<TreemapTile *>          _renderBatch;
+	double                          _renderBatchArea{ 0.0 };
+	double                          _renderChunkArea{ 0.0 };
+	int                             _renderTasks{ 0 };
+	std::atomic<int>                _renderedTiles{ 0 };
+	std::atomic<qint64>             _renderBusyNs{ 0 };
+
+	// Cushion pixmaps, costs in KB
+	QCache<const TreemapTile *, QPixmap>          _cushionCache;
+	int                                           _cushionCacheMaxCost{ 0 };
+	std::atomic<int>                              _reservedCushionCost{ 0 };
+	QMutex                                        _renderedCushionsMutex;
+	QVector<QPair<const TreemapTile *, QPixmap> > _renderedCushions;
 
 	// just for logging
 	QElapsedTimer   _stopwatch;
@@ -7,16 +7,23 @@
  *              Ian Nartowicz
  */
 
+#include <cstring>  // strcmp()
 #include <iostream> // cerr, endl
 
+#include "DirTree.h"
+#include "Exception.h"
 #include "Logger.h"
 #include "MainWindow.h"
 #include "PkgQuery.h"
 #include "QDirStatApp.h"
 #include "Settings.h"
+#include "TreemapView.h"
 #include "Version.h"
 
 
+#define DEFAULT_EXPORT_SIZE	"4096x4096"
+
+
 namespace
 {
     void usage()
@@ -31,6 +38,7 @@ namespace
 	          << "  " << progName << " unpkg:/dir\n"
 	          << "  " << progName << " --dont-ask|-d\n"
 	          << "  " << progName << " --cache|-c <cache-file-name>\n"
+	          << "  " << progName << " --export-treemap <png-file-name> [--size <width>x<height>] [--cache|-c] <directory-or-cache-file-name>\n"
 	          << "  " << progName << " --help|-h\n"
 	          << "\n"
 	          << "Supported pkg patterns:\n"
@@ -41,6 +49,11 @@ namespace
 	          << "- Exact match: \"pkg:/=mypkg\"\n"
 	          << "- All packages: \"pkg:/\"\n"
 	          << "\n"
+	          << "--export-treemap reads the directory or cache file and writes a treemap\n"
+	          << "image without opening a window.  The default size is " DEFAULT_EXPORT_SIZE ".\n"
+	          << "At most about " << MaxExportTiles << " tiles are drawn; any directories beyond\n"
+	          << "that are drawn without their contents.\n"
+	          << "\n"
 	          << "See also   man qdirstat"
 	          << "\n"
 	          << std::endl;
@@ -83,6 +96,72 @@ namespace
     }
 
 
+    /**
+     * Extract a command line option with a value from the command line and
+     * remove both from 'argList'.  Returns an empty string if the option
+     * is not present.  'ok' is set to 'false' if the option is present but
+     * has no value.
+     **/
+    QString commandLineOption( const QString & longName,
+			       QStringList   & argList,
+			       bool          & ok )
+    {
+	const int index = argList.indexOf( longName );
+	if ( index < 0 )
+	    return QString{};
+
+	if ( index + 1 >= argList.size() || argList.at( index + 1 ).startsWith( u'-' ) )
+	{
+	    ok = false;
+	    argList.removeAt( index );
+	    return QString{};
+	}
+
+	const QString value = argList.at( index + 1 );
+	argList.removeAt( index + 1 );
+	argList.removeAt( index );
+
+	return value;
+    }
+
+
+    /**
+     * Return 'true' if the raw command line contains 'arg'.  This can be
+     * used before the application object exists.
+     **/
+    bool hasRawArg( int argc, char * argv[], const char * arg )
+    {
+	for ( int i = 1; i < argc; ++i )
+	{
+	    if ( strcmp( argv[ i ], arg ) == 0 )
+		return true;
+	}
+
+	return false;
+    }
+
+
+    /**
+     * Parse an image size in the form "<width>x<height>".  Returns an
+     * invalid size if the string can't be parsed.
+     **/
+    QSize parseSize( const QString & sizeString )
+    {
+	const QStringList parts = sizeString.split( u'x' );
+	if ( parts.size() != 2 )
+	    return QSize{};
+
+	bool widthOk;
+	bool heightOk;
+	const int width  = parts.first().toInt( &widthOk );
+	const int height = parts.last().toInt( &heightOk );
+	if ( !widthOk || !heightOk || width <= 0 || height <= 0 )
+	    return QSize{};
+
+	return QSize{ width, height };
+    }
+
+
     /**
      * Output a message about an invalid set of command line arguments.
      * Will appear on stderr since logging is not yet started.
@@ -124,11 +203,63 @@ namespace
 	qApp->exec();
     }
 
+
+    /**
+     * Read 'source', either a directory or a cache file, and write a
+     * treemap of it to 'fileName' without showing any window.  Returns
+     * the exit code for the program.
+     **/
+    int exportTreemap( const QString & source,
+		       bool            openCache,
+		       const QSize   & size,
+		       const QString & fileName )
+    {
+	QDirStat::DirTree tree{ nullptr };
+	QDirStat::TreemapView treemapView;
+	bool ok = false;
+
+	// Queued so that the tree has finished all its own processing first
+	QObject::connect( &tree, &QDirStat::DirTree::finished, &tree, [ & ]()
+	{
+	    ok = treemapView.exportImage( tree.firstToplevel(), size, fileName );
+	    qApp->quit();
+	}, Qt::QueuedConnection );
+
+	try
+	{
+	    if ( openCache )
+	    {
+		if ( !tree.readCache( source ) )
+		{
+		    logError() << "Can't read cache file " << source << Qt::endl;
+		    return 1;
+		}
+	    }
+	    else
+	    {
+		tree.startReading( source );
+	    }
+	}
+	catch ( const Exception & ex )
+	{
+	    logError() << "Can't read " << source << ": " << ex.what() << Qt::endl;
+	    return 1;
+	}
+
+	qApp->exec();
+
+	return ok ? 0 : 1;
+    }
+
 } // namespace
 
 
 int main( int argc, char * argv[] )
 {
+    // Exporting a treemap doesn't need a display, so don't fail without one
+    if ( hasRawArg( argc, argv, "--export-treemap" ) && qEnvironmentVariableIsEmpty( "QT_QPA_PLATFORM" ) )
+	qputenv( "QT_QPA_PLATFORM", "offscreen" );
+
     QDirStat::QDirStatApp qDirStatApp{ argc, argv };
     QStringList argList = QCoreApplication::arguments();
     argList.removeFirst(); // Remove program name
@@ -138,12 +269,33 @@ int main( int argc, char * argv[] )
     const bool slowUpdate = commandLineSwitch( "--slow-update", "-s", argList );
     const bool openCache  = commandLineSwitch( "--cache",       "-c", argList );
 
+    // Take out the options with values
+    bool optionsOk = true;
+    const QString exportFile = commandLineOption( "--export-treemap", argList, optionsOk );
+    const QString exportSize = commandLineOption( "--size",           argList, optionsOk );
+    const QSize size = parseSize( exportSize.isEmpty() ? DEFAULT_EXPORT_SIZE : exportSize );
+
     if ( commandLineSwitch( "--help", "-h", argList ) )
     {
 	// treat --help anywhere as valid, even combined with other arguments
 	usage();
 	return 0;
     }
+    else if ( !optionsOk || ( !exportSize.isEmpty() && exportFile.isEmpty() ) || !size.isValid() )
+    {
+	// --size is only valid with --export-treemap
+	reportFatalError();
+	return 1;
+    }
+    else if ( !exportFile.isEmpty() )
+    {
+	// --export-treemap needs exactly one directory or cache file and can't be combined with -d or -s
+	if ( dontAsk || slowUpdate || argList.size() != 1 || argList.first().startsWith( u'-' ) )
+	{
+	    reportFatalError();
+	    return 1;
+	}
+    }
     else if ( openCache )
     {
 	// --cache must be the only (remaining) argument and must have one value
@@ -174,6 +326,9 @@ int main( int argc, char * argv[] )
     QCoreApplication::setApplicationName ( QDIRSTAT_APP );
 //    QCoreApplication::setApplicationVersion( QDIRSTAT_VERSION );
 
+    if ( !exportFile.isEmpty() )
+	return exportTreemap( argList.first(), openCache, size, exportFile );
+
     mainLoop( slowUpdate, openCache, dontAsk, argList );
 
     // Give config files back to the original owner if running with sudo
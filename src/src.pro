@@ -41,6 +41,7 @@ SOURCES =   main.cpp			\
 	    AdaptiveTimer.cpp		\
 	    Attic.cpp			\
 	    BreadcrumbNavigator.cpp	\
+	    BulkStat.cpp		\
 	    BusyPopup.cpp		\
 	    Cleanup.cpp			\
 	    CleanupCollection.cpp	\
@@ -68,7 +69,7 @@ SOURCES =   main.cpp			\
 	    FileInfoIterator.cpp	\
 	    FileInfoSet.cpp		\
 	    FileInfoSorter.cpp		\
-	    FileMTimeStats.cpp		\
+	    FileNameIndex.cpp		\
 	    FileSizeStats.cpp		\
 	    FileSizeStatsModels.cpp	\
 	    FileSizeStatsWindow.cpp	\
@@ -78,6 +79,7 @@ SOURCES =   main.cpp			\
 	    FindFilesDialog.cpp		\
 	    FormatUtil.cpp		\
 	    GeneralConfigPage.cpp	\
+	    HardLinkTable.cpp		\
 	    HeaderTweaker.cpp		\
 	    HistogramItems.cpp		\
 	    HistogramView.cpp		\
@@ -86,6 +88,7 @@ SOURCES =   main.cpp			\
 	    ListEditor.cpp		\
 	    LocateFileTypeWindow.cpp	\
 	    LocateFilesWindow.cpp	\
+	    LocateListModel.cpp		\
 	    Logger.cpp			\
 	    MainWindow.cpp		\
 	    MainWindowActions.cpp	\
@@ -102,6 +105,7 @@ SOURCES =   main.cpp			\
 	    OutputWindow.cpp		\
 	    PacManPkgManager.cpp	\
 	    PanelMessage.cpp		\
+	    ParallelUtil.cpp		\
 	    PathSelector.cpp		\
 	    PercentBar.cpp		\
 	    PercentileStats.cpp		\
@@ -109,20 +113,25 @@ SOURCES =   main.cpp			\
 	    PkgManager.cpp		\
 	    PkgQuery.cpp		\
 	    PkgReader.cpp		\
+	    PngWriter.cpp		\
 	    ProcessStarter.cpp		\
+	    QuantileSketch.cpp		\
 	    Refresher.cpp		\
 	    RpmPkgManager.cpp		\
 	    SearchFilter.cpp		\
 	    SelectionModel.cpp		\
 	    Settings.cpp		\
 	    SizeColDelegate.cpp		\
+	    StatsRunner.cpp		\
 	    StdCleanup.cpp		\
 	    Subtree.cpp			\
 	    SysUtil.cpp			\
 	    SystemFileChecker.cpp	\
 	    Trash.cpp			\
 	    TrashWindow.cpp		\
+	    TreeWalkRunner.cpp		\
 	    TreeWalker.cpp		\
+	    TreemapIndex.cpp		\
 	    TreemapTile.cpp		\
 	    TreemapView.cpp		\
 	    UnpkgSettings.cpp		\
@@ -135,6 +144,7 @@ HEADERS =   QDirStatApp.h		\
 	    AdaptiveTimer.h		\
 	    Attic.h			\
 	    BreadcrumbNavigator.h	\
+	    BulkStat.h			\
 	    BusyPopup.h			\
 	    Cleanup.h			\
 	    CleanupCollection.h		\
@@ -162,7 +172,7 @@ HEADERS =   QDirStatApp.h		\
 	    FileInfoIterator.h		\
 	    FileInfoSet.h		\
 	    FileInfoSorter.h		\
-	    FileMTimeStats.h		\
+	    FileNameIndex.h		\
 	    FileSearchFilter.h		\
 	    FileSizeStats.h		\
 	    FileSizeStatsModels.h	\
@@ -173,6 +183,7 @@ HEADERS =   QDirStatApp.h		\
 	    FindFilesDialog.h		\
 	    FormatUtil.h		\
 	    GeneralConfigPage.h		\
+	    HardLinkTable.h		\
 	    HeaderTweaker.h		\
 	    HistogramItems.h		\
 	    HistogramView.h		\
@@ -181,6 +192,7 @@ HEADERS =   QDirStatApp.h		\
 	    ListEditor.h		\
 	    LocateFileTypeWindow.h	\
 	    LocateFilesWindow.h		\
+	    LocateListModel.h		\
 	    Logger.h			\
 	    MainWindow.h		\
 	    MimeCategorizer.h		\
@@ -193,6 +205,7 @@ HEADERS =   QDirStatApp.h		\
 	    OutputWindow.h		\
 	    PacManPkgManager.h		\
 	    PanelMessage.h		\
+	    ParallelUtil.h		\
 	    PathSelector.h		\
 	    PercentBar.h		\
 	    PercentileStats.h		\
@@ -202,7 +215,9 @@ HEADERS =   QDirStatApp.h		\
 	    PkgManager.h		\
 	    PkgQuery.h			\
 	    PkgReader.h			\
+	    PngWriter.h			\
 	    ProcessStarter.h		\
+	    QuantileSketch.h		\
 	    Refresher.h			\
 	    RpmPkgManager.h		\
 	    SearchFilter.h		\
@@ -210,14 +225,17 @@ HEADERS =   QDirStatApp.h		\
 	    Settings.h			\
 	    SignalBlocker.h		\
 	    SizeColDelegate.h		\
+	    StatsRunner.h		\
 	    StdCleanup.h		\
 	    Subtree.h			\
 	    SysUtil.h			\
 	    SystemFileChecker.h		\
 	    Trash.h			\
 	    TrashWindow.h		\
+	    TreemapIndex.h		\
 	    TreemapTile.h		\
 	    TreemapView.h		\
+	    TreeWalkRunner.h		\
 	    TreeWalker.h		\
 	    Typedefs.h			\
 	    UnpkgSettings.cpp		\